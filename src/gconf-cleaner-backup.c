@@ -0,0 +1,877 @@
+/* 
+ * gconf-cleaner-backup.c
+ * Copyright (C) 2007 Akira TAGOH
+ * 
+ * Authors:
+ *   Akira TAGOH  <akira@tagoh.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include <glib/gi18n.h>
+#include <gconf/gconf.h>
+#include "gconf-cleaner-backup.h"
+
+#define GCLEANER_BACKUP_BUFFER_SIZE	65536
+#define GCLEANER_BACKUP_FOOTER		"  </entrylist>\n</gconfentryfile>\n"
+
+
+struct _GConfCleanerBackupWriter {
+	gchar  *filename;
+	gint    fd;
+#ifdef HAVE_ZLIB
+	gzFile  gz;	/* only when compressing */
+#endif
+	gint    errno_;	/* the first error on writing */
+	gsize   len;
+	gchar   buffer[GCLEANER_BACKUP_BUFFER_SIZE];
+};
+struct _GConfCleanerBackupReader {
+	gchar  *filename;
+#ifdef HAVE_ZLIB
+	gzFile  gz;
+#else
+	gint    fd;
+#endif
+};
+
+typedef struct _GConfCleanerBackupFrame {
+	GConfValue *value;
+	GSList     *items;
+	gboolean    broken;
+	gboolean    is_cdr;
+} GConfCleanerBackupFrame;
+typedef struct _GConfCleanerBackupParser {
+	GConfCleanerBackupFunc  func;
+	gpointer                user_data;
+	gchar                  *base;
+	gchar                  *key;
+	GConfValue             *value;
+	gboolean                in_entry;
+	gboolean                stopped;
+	GSList                 *frames;
+	GString                *text;
+	GConfValueType          text_type;	/* GCONF_VALUE_INVALID if it isn't needed */
+	gboolean                in_key;
+	gint                    skip;
+} GConfCleanerBackupParser;
+
+/* enough for the usual depth. the deeper ones are written in pieces */
+static const gchar whitespaces[] =
+	"                                                                "
+	"                                                                ";
+
+/*
+ * Private Functions
+ */
+static void
+_gconf_cleaner_backup_flush(GConfCleanerBackupWriter *writer)
+{
+	gsize written = 0;
+	gssize ret;
+
+#ifdef HAVE_ZLIB
+	if (writer->gz) {
+		/* compressed as it goes */
+		if (writer->errno_ == 0 && writer->len > 0 &&
+		    gzwrite(writer->gz, writer->buffer, writer->len) == 0) {
+			gint errnum;
+
+			gzerror(writer->gz, &errnum);
+			writer->errno_ = errnum == Z_ERRNO ? errno : EIO;
+		}
+		writer->len = 0;
+		return;
+	}
+#endif
+	while (writer->errno_ == 0 && written < writer->len) {
+		ret = write(writer->fd, writer->buffer + written, writer->len - written);
+		if (ret < 0) {
+			if (errno != EINTR)
+				writer->errno_ = errno;
+		} else {
+			written += ret;
+		}
+	}
+	writer->len = 0;
+}
+
+static void
+_gconf_cleaner_backup_append_len(GConfCleanerBackupWriter *writer,
+				 const gchar              *str,
+				 gsize                     len)
+{
+	gsize n;
+
+	while (len > 0) {
+		if (writer->len == GCLEANER_BACKUP_BUFFER_SIZE)
+			_gconf_cleaner_backup_flush(writer);
+		n = MIN (len, GCLEANER_BACKUP_BUFFER_SIZE - writer->len);
+		memcpy(writer->buffer + writer->len, str, n);
+		writer->len += n;
+		str += n;
+		len -= n;
+	}
+}
+
+static void
+_gconf_cleaner_backup_append(GConfCleanerBackupWriter *writer,
+			     const gchar              *str)
+{
+	_gconf_cleaner_backup_append_len(writer, str, strlen(str));
+}
+
+static void
+_gconf_cleaner_backup_indent(GConfCleanerBackupWriter *writer,
+			     gint                      indent)
+{
+	gint n;
+
+	while (indent > 0) {
+		n = MIN (indent, (gint)sizeof (whitespaces) - 1);
+		_gconf_cleaner_backup_append_len(writer, whitespaces, n);
+		indent -= n;
+	}
+}
+
+/* append "<indent><@tag>" */
+static void
+_gconf_cleaner_backup_open_line(GConfCleanerBackupWriter *writer,
+				gint                      indent,
+				const gchar              *tag)
+{
+	_gconf_cleaner_backup_indent(writer, indent);
+	_gconf_cleaner_backup_append(writer, tag);
+}
+
+static gboolean
+_gconf_cleaner_backup_need_escape(const gchar *str)
+{
+	const guchar *p;
+
+	for (p = (const guchar *)str; *p; p++) {
+		if (*p == '&' || *p == '<' || *p == '>' || *p == '\'' || *p == '"' ||
+		    (*p < 0x20 && *p != '\t' && *p != '\n' && *p != '\r') ||
+		    *p == 0x7f ||
+		    /* U+0080 - U+009F */
+		    (*p == 0xc2 && p[1] >= 0x80 && p[1] <= 0x9f))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void
+_gconf_cleaner_backup_append_string(GConfCleanerBackupWriter *writer,
+				    const gchar              *str)
+{
+	/* g_markup_escape_text() is only for the strings it would change */
+	if (_gconf_cleaner_backup_need_escape(str)) {
+		gchar *tmp = g_markup_escape_text(str, -1);
+
+		_gconf_cleaner_backup_append(writer, tmp);
+		g_free(tmp);
+	} else if (str[0] != ' ' || str[1] != 0) {
+		_gconf_cleaner_backup_append(writer, str);
+	}
+}
+
+static const gchar *
+_gconf_cleaner_backup_type_to_string(GConfValueType type)
+{
+	switch (type) {
+	    case GCONF_VALUE_INT:
+		    return "int";
+	    case GCONF_VALUE_STRING:
+		    return "string";
+	    case GCONF_VALUE_FLOAT:
+		    return "float";
+	    case GCONF_VALUE_BOOL:
+		    return "bool";
+	    case GCONF_VALUE_LIST:
+		    return "list";
+	    case GCONF_VALUE_PAIR:
+		    return "pair";
+	    default:
+		    g_assert_not_reached();
+		    return NULL;
+	}
+}
+
+static void
+_gconf_cleaner_backup_append_value(GConfCleanerBackupWriter *writer,
+				   GConfValue               *value,
+				   gint                      indent)
+{
+	gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+	GSList *l;
+
+	_gconf_cleaner_backup_open_line(writer, indent, "<value>\n");
+	switch (value->type) {
+	    case GCONF_VALUE_INT:
+		    g_snprintf(buf, sizeof (buf), "%d", gconf_value_get_int(value));
+		    _gconf_cleaner_backup_open_line(writer, indent + 2, "<int>");
+		    _gconf_cleaner_backup_append(writer, buf);
+		    _gconf_cleaner_backup_append(writer, "</int>\n");
+		    break;
+	    case GCONF_VALUE_FLOAT:
+		    g_snprintf(buf, sizeof (buf), "%.17g", gconf_value_get_float(value));
+		    _gconf_cleaner_backup_open_line(writer, indent + 2, "<float>");
+		    _gconf_cleaner_backup_append(writer, buf);
+		    _gconf_cleaner_backup_append(writer, "</float>\n");
+		    break;
+	    case GCONF_VALUE_STRING:
+		    _gconf_cleaner_backup_open_line(writer, indent + 2, "<string>");
+		    _gconf_cleaner_backup_append_string(writer, gconf_value_get_string(value));
+		    _gconf_cleaner_backup_append(writer, "</string>\n");
+		    break;
+	    case GCONF_VALUE_BOOL:
+		    _gconf_cleaner_backup_open_line(writer, indent + 2,
+						    gconf_value_get_bool(value) ? "<bool>true</bool>\n" : "<bool>false</bool>\n");
+		    break;
+	    case GCONF_VALUE_LIST:
+		    _gconf_cleaner_backup_open_line(writer, indent + 2, "<list type=\"");
+		    _gconf_cleaner_backup_append(writer,
+						 _gconf_cleaner_backup_type_to_string(gconf_value_get_list_type(value)));
+		    _gconf_cleaner_backup_append(writer, "\">\n");
+		    for (l = gconf_value_get_list(value); l != NULL; l = g_slist_next(l))
+			    _gconf_cleaner_backup_append_value(writer, l->data, indent + 6);
+		    _gconf_cleaner_backup_open_line(writer, indent + 2, "</list>\n");
+		    break;
+	    case GCONF_VALUE_PAIR:
+		    _gconf_cleaner_backup_open_line(writer, indent + 2, "<pair>\n");
+		    _gconf_cleaner_backup_open_line(writer, indent + 4, "<car>\n");
+		    _gconf_cleaner_backup_append_value(writer, gconf_value_get_car(value), indent + 6);
+		    _gconf_cleaner_backup_open_line(writer, indent + 4, "</car>\n");
+		    _gconf_cleaner_backup_open_line(writer, indent + 4, "<cdr>\n");
+		    _gconf_cleaner_backup_append_value(writer, gconf_value_get_cdr(value), indent + 6);
+		    _gconf_cleaner_backup_open_line(writer, indent + 4, "</cdr>\n");
+		    _gconf_cleaner_backup_open_line(writer, indent + 2, "</pair>\n");
+		    break;
+	    default:
+		    g_assert_not_reached();
+		    break;
+	}
+	_gconf_cleaner_backup_open_line(writer, indent, "</value>\n");
+}
+
+static gboolean
+_gconf_cleaner_backup_check(GConfCleanerBackupWriter  *writer,
+			    GError                   **error)
+{
+	if (G_UNLIKELY (writer->errno_ != 0)) {
+		g_set_error(error, 0, 0,
+			    _("Failed during writing %s: %s"),
+			    writer->filename, g_strerror(writer->errno_));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static GConfValueType
+_gconf_cleaner_backup_type_from_string(const gchar *type)
+{
+	if (type == NULL)
+		return GCONF_VALUE_INVALID;
+	if (strcmp(type, "int") == 0)
+		return GCONF_VALUE_INT;
+	if (strcmp(type, "string") == 0)
+		return GCONF_VALUE_STRING;
+	if (strcmp(type, "float") == 0)
+		return GCONF_VALUE_FLOAT;
+	if (strcmp(type, "bool") == 0)
+		return GCONF_VALUE_BOOL;
+	if (strcmp(type, "list") == 0)
+		return GCONF_VALUE_LIST;
+	if (strcmp(type, "pair") == 0)
+		return GCONF_VALUE_PAIR;
+
+	return GCONF_VALUE_INVALID;
+}
+
+static GConfValue *
+_gconf_cleaner_backup_value_from_text(GConfValueType  type,
+				      const gchar    *text)
+{
+	GConfValue *retval = NULL;
+	gchar *end;
+	glong l;
+	gdouble d;
+
+	switch (type) {
+	    case GCONF_VALUE_INT:
+		    l = strtol(text, &end, 10);
+		    if (*text != 0 && *end == 0) {
+			    retval = gconf_value_new(type);
+			    gconf_value_set_int(retval, l);
+		    }
+		    break;
+	    case GCONF_VALUE_FLOAT:
+		    d = g_ascii_strtod(text, &end);
+		    if (*end != 0) {
+			    /* written in the locale with the decimal comma */
+			    d = strtod(text, &end);
+		    }
+		    if (*text != 0 && *end == 0) {
+			    retval = gconf_value_new(type);
+			    gconf_value_set_float(retval, d);
+		    }
+		    break;
+	    case GCONF_VALUE_STRING:
+		    retval = gconf_value_new(type);
+		    gconf_value_set_string(retval, text);
+		    break;
+	    case GCONF_VALUE_BOOL:
+		    if (strcmp(text, "true") == 0 || strcmp(text, "false") == 0) {
+			    retval = gconf_value_new(type);
+			    gconf_value_set_bool(retval, text[0] == 't');
+		    }
+		    break;
+	    default:
+		    break;
+	}
+
+	return retval;
+}
+
+static GConfCleanerBackupFrame *
+_gconf_cleaner_backup_current_frame(GConfCleanerBackupParser *parser)
+{
+	return parser->frames ? parser->frames->data : NULL;
+}
+
+/* give @value to the outer value or to the entry */
+static void
+_gconf_cleaner_backup_give_value(GConfCleanerBackupParser *parser,
+				 GConfValue               *value)
+{
+	GConfCleanerBackupFrame *parent = _gconf_cleaner_backup_current_frame(parser);
+
+	if (parent == NULL) {
+		if (parser->value)
+			gconf_value_free(parser->value);
+		parser->value = value;
+	} else if (value == NULL || parent->broken || parent->value == NULL) {
+		if (value)
+			gconf_value_free(value);
+		parent->broken = TRUE;
+	} else if (parent->value->type == GCONF_VALUE_LIST &&
+		   value->type == gconf_value_get_list_type(parent->value)) {
+		parent->items = g_slist_prepend(parent->items, value);
+	} else if (parent->value->type == GCONF_VALUE_PAIR &&
+		   value->type != GCONF_VALUE_LIST && value->type != GCONF_VALUE_PAIR) {
+		if (parent->is_cdr)
+			gconf_value_set_cdr_nocopy(parent->value, value);
+		else
+			gconf_value_set_car_nocopy(parent->value, value);
+	} else {
+		gconf_value_free(value);
+		parent->broken = TRUE;
+	}
+}
+
+static void
+_gconf_cleaner_backup_pop_frame(GConfCleanerBackupParser *parser)
+{
+	GConfCleanerBackupFrame *frame = _gconf_cleaner_backup_current_frame(parser);
+	GConfValue *value;
+	GSList *l;
+
+	if (frame == NULL)
+		return;
+	parser->frames = g_slist_delete_link(parser->frames, parser->frames);
+	value = frame->value;
+	if (value && value->type == GCONF_VALUE_LIST && !frame->broken) {
+		gconf_value_set_list_nocopy(value, g_slist_reverse(frame->items));
+		frame->items = NULL;
+	} else if (value && value->type == GCONF_VALUE_PAIR &&
+		   (gconf_value_get_car(value) == NULL || gconf_value_get_cdr(value) == NULL)) {
+		frame->broken = TRUE;
+	}
+	for (l = frame->items; l != NULL; l = g_slist_next(l))
+		gconf_value_free(l->data);
+	g_slist_free(frame->items);
+	if (frame->broken && value) {
+		gconf_value_free(value);
+		value = NULL;
+	}
+	g_free(frame);
+	_gconf_cleaner_backup_give_value(parser, value);
+}
+
+static void
+_gconf_cleaner_backup_start_element(GMarkupParseContext  *context,
+				    const gchar          *element_name,
+				    const gchar         **attribute_names,
+				    const gchar         **attribute_values,
+				    gpointer              user_data,
+				    GError              **error)
+{
+	GConfCleanerBackupParser *parser = user_data;
+	GConfCleanerBackupFrame *frame = _gconf_cleaner_backup_current_frame(parser);
+	GConfValueType type;
+	gint i;
+
+	if (parser->skip > 0 || parser->stopped) {
+		parser->skip++;
+		return;
+	}
+	if (strcmp(element_name, "entrylist") == 0) {
+		g_free(parser->base);
+		parser->base = NULL;
+		for (i = 0; attribute_names[i] != NULL; i++) {
+			if (strcmp(attribute_names[i], "base") == 0)
+				parser->base = g_strdup(attribute_values[i]);
+		}
+	} else if (strcmp(element_name, "entry") == 0) {
+		parser->in_entry = TRUE;
+	} else if (!parser->in_entry) {
+		if (strcmp(element_name, "gconfentryfile") != 0)
+			parser->skip++;
+	} else if (strcmp(element_name, "key") == 0 && frame == NULL) {
+		g_string_truncate(parser->text, 0);
+		parser->in_key = TRUE;
+	} else if (strcmp(element_name, "value") == 0) {
+		parser->frames = g_slist_prepend(parser->frames,
+						 g_new0(GConfCleanerBackupFrame, 1));
+	} else if (frame == NULL) {
+		/* <schema_key> and so on */
+		parser->skip++;
+	} else if (strcmp(element_name, "car") == 0 ||
+		   strcmp(element_name, "cdr") == 0) {
+		frame->is_cdr = (element_name[1] == 'd');
+	} else if (frame->value != NULL || frame->broken) {
+		frame->broken = TRUE;
+		parser->skip++;
+	} else if (strcmp(element_name, "list") == 0) {
+		type = GCONF_VALUE_INVALID;
+		for (i = 0; attribute_names[i] != NULL; i++) {
+			if (strcmp(attribute_names[i], "type") == 0)
+				type = _gconf_cleaner_backup_type_from_string(attribute_values[i]);
+		}
+		if (type == GCONF_VALUE_INVALID || type == GCONF_VALUE_LIST || type == GCONF_VALUE_PAIR) {
+			frame->broken = TRUE;
+			parser->skip++;
+			return;
+		}
+		frame->value = gconf_value_new(GCONF_VALUE_LIST);
+		gconf_value_set_list_type(frame->value, type);
+	} else if (strcmp(element_name, "pair") == 0) {
+		frame->value = gconf_value_new(GCONF_VALUE_PAIR);
+	} else if ((type = _gconf_cleaner_backup_type_from_string(element_name)) != GCONF_VALUE_INVALID) {
+		g_string_truncate(parser->text, 0);
+		parser->text_type = type;
+	} else {
+		/* <schema> can't be restored */
+		frame->broken = TRUE;
+		parser->skip++;
+	}
+}
+
+static void
+_gconf_cleaner_backup_end_element(GMarkupParseContext  *context,
+				  const gchar          *element_name,
+				  gpointer              user_data,
+				  GError              **error)
+{
+	GConfCleanerBackupParser *parser = user_data;
+	GConfCleanerBackupFrame *frame = _gconf_cleaner_backup_current_frame(parser);
+
+	if (parser->skip > 0) {
+		parser->skip--;
+		return;
+	}
+	if (parser->in_key) {
+		g_free(parser->key);
+		parser->key = g_strdup(parser->text->str);
+		parser->in_key = FALSE;
+	} else if (parser->text_type != GCONF_VALUE_INVALID) {
+		frame->value = _gconf_cleaner_backup_value_from_text(parser->text_type,
+								     parser->text->str);
+		if (frame->value == NULL)
+			frame->broken = TRUE;
+		parser->text_type = GCONF_VALUE_INVALID;
+	} else if (strcmp(element_name, "value") == 0) {
+		_gconf_cleaner_backup_pop_frame(parser);
+	} else if (strcmp(element_name, "entry") == 0) {
+		gchar *key = NULL;
+
+		if (parser->key && parser->key[0] == '/')
+			key = g_strdup(parser->key);
+		else if (parser->key && parser->base)
+			key = gconf_concat_dir_and_key(parser->base, parser->key);
+		if (key && !parser->func(key, parser->value, parser->user_data))
+			parser->stopped = TRUE;
+		g_free(key);
+		g_free(parser->key);
+		parser->key = NULL;
+		if (parser->value)
+			gconf_value_free(parser->value);
+		parser->value = NULL;
+		parser->in_entry = FALSE;
+	}
+}
+
+static void
+_gconf_cleaner_backup_text(GMarkupParseContext  *context,
+			   const gchar          *text,
+			   gsize                 text_len,
+			   gpointer              user_data,
+			   GError              **error)
+{
+	GConfCleanerBackupParser *parser = user_data;
+
+	if (parser->skip == 0 &&
+	    (parser->in_key || parser->text_type != GCONF_VALUE_INVALID))
+		g_string_append_len(parser->text, text, text_len);
+}
+
+static const GMarkupParser gconf_cleaner_backup_parser = {
+	_gconf_cleaner_backup_start_element,
+	_gconf_cleaner_backup_end_element,
+	_gconf_cleaner_backup_text,
+	NULL,
+	NULL
+};
+
+/*
+ * Public Functions
+ */
+gboolean
+gconf_cleaner_backup_is_compression_supported(void)
+{
+#ifdef HAVE_ZLIB
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
+/* the backup is compressed with gzip if @compress is TRUE */
+GConfCleanerBackupWriter *
+gconf_cleaner_backup_writer_new(const gchar  *filename,
+				gboolean      compress,
+				GError      **error)
+{
+	GConfCleanerBackupWriter *retval;
+	gint fd;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	if (compress && !gconf_cleaner_backup_is_compression_supported()) {
+		g_set_error(error, 0, 0,
+			    _("Compressed backups aren't supported"));
+		return NULL;
+	}
+	if ((fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+		g_set_error(error, 0, 0,
+			    _("Failed during opening %s: %s"),
+			    filename, g_strerror(errno));
+		return NULL;
+	}
+	retval = g_new(GConfCleanerBackupWriter, 1);
+	retval->filename = g_strdup(filename);
+	retval->fd = fd;
+	retval->errno_ = 0;
+#ifdef HAVE_ZLIB
+	retval->gz = NULL;
+	if (compress && (retval->gz = gzdopen(fd, "wb")) == NULL) {
+		g_set_error(error, 0, 0,
+			    _("Failed during opening %s: %s"),
+			    filename, g_strerror(ENOMEM));
+		close(fd);
+		g_free(retval->filename);
+		g_free(retval);
+		return NULL;
+	}
+#endif
+	retval->len = 0;
+	_gconf_cleaner_backup_append(retval,
+				     "<gconfentryfile>\n"
+				     "  <entrylist base=\"/\">\n");
+
+	return retval;
+}
+
+/* the entries are buffered and written out in every 64KB */
+/*
+ * open the uncompressed backup written by gconf_cleaner_backup_writer_new()
+ * to add more entries after the ones in it.  the closing tags are taken
+ * off until gconf_cleaner_backup_writer_close() writes them again.
+ */
+GConfCleanerBackupWriter *
+gconf_cleaner_backup_writer_append(const gchar  *filename,
+				   GError      **error)
+{
+	GConfCleanerBackupWriter *retval;
+	gsize footer_len = strlen(GCLEANER_BACKUP_FOOTER);
+	gchar footer[sizeof (GCLEANER_BACKUP_FOOTER)];
+	struct stat st;
+	gint fd;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	if ((fd = open(filename, O_RDWR)) < 0) {
+		g_set_error(error, 0, 0,
+			    _("Failed during opening %s: %s"),
+			    filename, g_strerror(errno));
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)footer_len ||
+	    lseek(fd, st.st_size - footer_len, SEEK_SET) < 0 ||
+	    read(fd, footer, footer_len) != (gssize)footer_len ||
+	    memcmp(footer, GCLEANER_BACKUP_FOOTER, footer_len) != 0) {
+		g_set_error(error, 0, 0,
+			    _("%s isn't a complete backup"), filename);
+		close(fd);
+		return NULL;
+	}
+	if (ftruncate(fd, st.st_size - footer_len) < 0 ||
+	    lseek(fd, 0, SEEK_END) < 0) {
+		g_set_error(error, 0, 0,
+			    _("Failed during writing %s: %s"),
+			    filename, g_strerror(errno));
+		close(fd);
+		return NULL;
+	}
+	retval = g_new(GConfCleanerBackupWriter, 1);
+	retval->filename = g_strdup(filename);
+	retval->fd = fd;
+	retval->errno_ = 0;
+#ifdef HAVE_ZLIB
+	retval->gz = NULL;
+#endif
+	retval->len = 0;
+
+	return retval;
+}
+
+gboolean
+gconf_cleaner_backup_writer_add(GConfCleanerBackupWriter  *writer,
+				const gchar               *key,
+				GConfValue                *value,
+				GError                   **error)
+{
+	g_return_val_if_fail (writer != NULL, FALSE);
+	g_return_val_if_fail (key != NULL, FALSE);
+	g_return_val_if_fail (value != NULL, FALSE);
+
+	_gconf_cleaner_backup_append(writer,
+				     "    <entry>\n"
+				     "      <key>");
+	_gconf_cleaner_backup_append(writer, key);
+	_gconf_cleaner_backup_append(writer, "</key>\n");
+	_gconf_cleaner_backup_append_value(writer, value, 6);
+	_gconf_cleaner_backup_append(writer, "    </entry>\n");
+
+	return _gconf_cleaner_backup_check(writer, error);
+}
+
+/* finish the file and free @writer. the file is incomplete if this fails */
+gboolean
+gconf_cleaner_backup_writer_close(GConfCleanerBackupWriter  *writer,
+				  GError                   **error)
+{
+	gboolean retval;
+
+	g_return_val_if_fail (writer != NULL, FALSE);
+
+	_gconf_cleaner_backup_append(writer, GCLEANER_BACKUP_FOOTER);
+	_gconf_cleaner_backup_flush(writer);
+#ifdef HAVE_ZLIB
+	if (writer->gz) {
+		/* this closes the descriptor too */
+		if (gzclose(writer->gz) != Z_OK && writer->errno_ == 0)
+			writer->errno_ = EIO;
+	} else
+#endif
+	if (close(writer->fd) < 0 && writer->errno_ == 0)
+		writer->errno_ = errno;
+	retval = _gconf_cleaner_backup_check(writer, error);
+	g_free(writer->filename);
+	g_free(writer);
+
+	return retval;
+}
+
+/*
+ * open a backup for reading.  the compressed backups are detected by
+ * their contents, not by the filename.
+ */
+GConfCleanerBackupReader *
+gconf_cleaner_backup_reader_new(const gchar  *filename,
+				GError      **error)
+{
+	GConfCleanerBackupReader *retval;
+#ifdef HAVE_ZLIB
+	gzFile gz;
+#else
+	guchar magic[2];
+	gint fd;
+#endif
+
+	g_return_val_if_fail (filename != NULL, NULL);
+
+#ifdef HAVE_ZLIB
+	/* zlib reads the uncompressed files transparently */
+	if ((gz = gzopen(filename, "rb")) == NULL) {
+		g_set_error(error, 0, 0,
+			    _("Failed during opening %s: %s"),
+			    filename, g_strerror(errno ? errno : ENOMEM));
+		return NULL;
+	}
+#else
+	if ((fd = open(filename, O_RDONLY)) < 0) {
+		g_set_error(error, 0, 0,
+			    _("Failed during opening %s: %s"),
+			    filename, g_strerror(errno));
+		return NULL;
+	}
+	if (read(fd, magic, 2) == 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+		g_set_error(error, 0, 0,
+			    _("Compressed backups aren't supported"));
+		close(fd);
+		return NULL;
+	}
+	lseek(fd, 0, SEEK_SET);
+#endif
+	retval = g_new(GConfCleanerBackupReader, 1);
+	retval->filename = g_strdup(filename);
+#ifdef HAVE_ZLIB
+	retval->gz = gz;
+#else
+	retval->fd = fd;
+#endif
+
+	return retval;
+}
+
+/* returns the number of the bytes read, 0 at the end of the file or -1 on error */
+gssize
+gconf_cleaner_backup_reader_read(GConfCleanerBackupReader  *reader,
+				 gchar                     *buffer,
+				 gsize                      size,
+				 GError                   **error)
+{
+	gssize retval;
+
+	g_return_val_if_fail (reader != NULL, -1);
+	g_return_val_if_fail (buffer != NULL, -1);
+
+#ifdef HAVE_ZLIB
+	if ((retval = gzread(reader->gz, buffer, size)) < 0) {
+		gint errnum;
+		const gchar *message = gzerror(reader->gz, &errnum);
+
+		g_set_error(error, 0, 0,
+			    _("Failed during reading %s: %s"),
+			    reader->filename,
+			    errnum == Z_ERRNO ? g_strerror(errno) : message);
+	}
+#else
+	do {
+		retval = read(reader->fd, buffer, size);
+	} while (retval < 0 && errno == EINTR);
+	if (retval < 0)
+		g_set_error(error, 0, 0,
+			    _("Failed during reading %s: %s"),
+			    reader->filename, g_strerror(errno));
+#endif
+
+	return retval;
+}
+
+void
+gconf_cleaner_backup_reader_free(GConfCleanerBackupReader *reader)
+{
+	g_return_if_fail (reader != NULL);
+
+#ifdef HAVE_ZLIB
+	gzclose(reader->gz);
+#else
+	close(reader->fd);
+#endif
+	g_free(reader->filename);
+	g_free(reader);
+}
+
+/*
+ * read the entries in the backup one by one and give them to @func.
+ * the value is NULL for the entries which can't be restored, e.g.
+ * schemas.  it's freed after @func returns.  @func may return FALSE
+ * to stop reading.
+ */
+gboolean
+gconf_cleaner_backup_read(const gchar              *filename,
+			  GConfCleanerBackupFunc    func,
+			  gpointer                  user_data,
+			  GError                  **error)
+{
+	GConfCleanerBackupReader *reader;
+	GConfCleanerBackupParser parser;
+	GMarkupParseContext *context;
+	gchar buffer[GCLEANER_BACKUP_BUFFER_SIZE];
+	gboolean retval = TRUE;
+	gssize len;
+
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (func != NULL, FALSE);
+
+	if ((reader = gconf_cleaner_backup_reader_new(filename, error)) == NULL)
+		return FALSE;
+	memset(&parser, 0, sizeof (GConfCleanerBackupParser));
+	parser.func = func;
+	parser.user_data = user_data;
+	parser.text = g_string_new(NULL);
+	parser.text_type = GCONF_VALUE_INVALID;
+	context = g_markup_parse_context_new(&gconf_cleaner_backup_parser, 0, &parser, NULL);
+	while (!parser.stopped &&
+	       (len = gconf_cleaner_backup_reader_read(reader, buffer, sizeof (buffer), error)) != 0) {
+		if (len < 0 ||
+		    !g_markup_parse_context_parse(context, buffer, len, error)) {
+			retval = FALSE;
+			break;
+		}
+	}
+	if (retval && !parser.stopped)
+		retval = g_markup_parse_context_end_parse(context, error);
+	g_markup_parse_context_free(context);
+	gconf_cleaner_backup_reader_free(reader);
+
+	/* clean up whatever is left by the broken document */
+	while (parser.frames)
+		_gconf_cleaner_backup_pop_frame(&parser);
+	if (parser.value)
+		gconf_value_free(parser.value);
+	g_free(parser.key);
+	g_free(parser.base);
+	g_string_free(parser.text, TRUE);
+
+	return retval;
+}
@@ -0,0 +1,64 @@
+/* 
+ * gconf-cleaner-backup.h
+ * Copyright (C) 2007 Akira TAGOH
+ * 
+ * Authors:
+ *   Akira TAGOH  <akira@tagoh.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef __GCONF_CLEANER_BACKUP_H__
+#define __GCONF_CLEANER_BACKUP_H__
+
+#include <glib.h>
+#include <gconf/gconf-value.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GConfCleanerBackupWriter GConfCleanerBackupWriter;
+typedef struct _GConfCleanerBackupReader GConfCleanerBackupReader;
+
+typedef gboolean (* GConfCleanerBackupFunc) (const gchar *key,
+					     GConfValue  *value,
+					     gpointer     user_data);
+
+gboolean                  gconf_cleaner_backup_is_compression_supported(void);
+GConfCleanerBackupWriter *gconf_cleaner_backup_writer_new  (const gchar               *filename,
+							    gboolean                   compress,
+							    GError                   **error);
+GConfCleanerBackupWriter *gconf_cleaner_backup_writer_append(const gchar               *filename,
+							    GError                   **error);
+gboolean                  gconf_cleaner_backup_writer_add  (GConfCleanerBackupWriter  *writer,
+							    const gchar               *key,
+							    GConfValue                *value,
+							    GError                   **error);
+gboolean                  gconf_cleaner_backup_writer_close(GConfCleanerBackupWriter  *writer,
+							    GError                   **error);
+GConfCleanerBackupReader *gconf_cleaner_backup_reader_new  (const gchar               *filename,
+							    GError                   **error);
+gssize                    gconf_cleaner_backup_reader_read (GConfCleanerBackupReader  *reader,
+							    gchar                     *buffer,
+							    gsize                      size,
+							    GError                   **error);
+void                      gconf_cleaner_backup_reader_free (GConfCleanerBackupReader  *reader);
+gboolean                  gconf_cleaner_backup_read        (const gchar               *filename,
+							    GConfCleanerBackupFunc     func,
+							    gpointer                   user_data,
+							    GError                   **error);
+
+G_END_DECLS
+
+#endif /* __GCONF_CLEANER_BACKUP_H__ */
@@ -0,0 +1,473 @@
+/* 
+ * gconf-cleaner-bench.c
+ * Copyright (C) 2007 Akira TAGOH
+ * 
+ * Authors:
+ *   Akira TAGOH  <akira@tagoh.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include "gconf-cleaner.h"
+#include "gconf-cleaner-backup.h"
+
+#define GCLEANER_BENCH_MTIME	"1200000000"
+#define GCLEANER_BENCH_XML_FILE	"%gconf.xml"
+
+
+typedef struct _GConfCleanerBenchOptions {
+	gint      depth;
+	gint      fanout;
+	gint      n_keys;
+	gdouble   orphans;
+	gdouble   lists;
+	gdouble   pairs;
+	gint      list_length;
+	gint      seed;
+	gint      runs;
+	gint      n_threads;
+	gboolean  direct;
+	gboolean  keep;
+	gchar    *dir;
+} GConfCleanerBenchOptions;
+typedef struct _GConfCleanerBench {
+	GConfCleanerBenchOptions *options;
+	GRand                    *rand;
+	gchar                    *root;		/* the directory of the tree */
+	gchar                    *address;
+	guint                     n_dirs;
+	guint                     n_keys;
+	guint                     n_orphans;
+	gint                      run;
+	GTimer                   *timer;
+} GConfCleanerBench;
+
+/*
+ * Private Functions
+ */
+static void
+_gconf_cleaner_bench_report(GConfCleanerBench *bench,
+			    const gchar       *phase,
+			    guint              n_items)
+{
+	g_print("%d\t%s\t%.6f\t%u\n",
+		bench->run, phase, g_timer_elapsed(bench->timer, NULL), n_items);
+	g_timer_start(bench->timer);
+}
+
+static gboolean
+_gconf_cleaner_bench_write_xml(const gchar  *dir,
+			       GString      *contents,
+			       GError      **error)
+{
+	gchar *filename;
+	gboolean retval;
+
+	if (g_mkdir_with_parents(dir, 0700) != 0) {
+		g_set_error(error, 0, 0, "Failed to create %s", dir);
+		return FALSE;
+	}
+	filename = g_build_filename(dir, GCLEANER_BENCH_XML_FILE, NULL);
+	g_string_prepend(contents, "<?xml version=\"1.0\"?>\n<gconf>\n");
+	g_string_append(contents, "</gconf>\n");
+	retval = g_file_set_contents(filename, contents->str, contents->len, error);
+	g_free(filename);
+
+	return retval;
+}
+
+/* the rest of <entry>, <li>, <car> or <cdr> after the name and so on */
+static void
+_gconf_cleaner_bench_append_scalar(GString     *xml,
+				   const gchar *element,
+				   guint        type,
+				   guint        n)
+{
+	switch (type % 4) {
+	    case 0:
+		    g_string_append_printf(xml, " type=\"int\" value=\"%u\"/>", n);
+		    break;
+	    case 1:
+		    g_string_append_printf(xml, " type=\"string\"><stringvalue>value %u</stringvalue></%s>",
+					   n, element);
+		    break;
+	    case 2:
+		    g_string_append_printf(xml, " type=\"float\" value=\"%u.5\"/>", n);
+		    break;
+	    default:
+		    g_string_append_printf(xml, " type=\"bool\" value=\"%s\"/>",
+					   n % 2 ? "true" : "false");
+		    break;
+	}
+}
+
+/* write the keys in @path and the schemas for them, and go down */
+static gboolean
+_gconf_cleaner_bench_generate_dir(GConfCleanerBench  *bench,
+				  const gchar        *path,
+				  gint                depth,
+				  GError            **error)
+{
+	GConfCleanerBenchOptions *options = bench->options;
+	GString *keys = g_string_new(NULL), *schemas = g_string_new(NULL);
+	static const gchar *types[] = {"int", "string", "float", "bool"};
+	gchar *dir, *stype;
+	gboolean retval;
+	gint i, j;
+
+	for (i = 0; i < options->n_keys; i++) {
+		gdouble shape = g_rand_double(bench->rand);
+		gboolean is_orphan = g_rand_double(bench->rand) < options->orphans;
+
+		g_string_append_printf(keys, "\t<entry name=\"key%d\" mtime=\"" GCLEANER_BENCH_MTIME "\"", i);
+		if (is_orphan)
+			bench->n_orphans++;
+		else
+			g_string_append_printf(keys, " schema=\"/schemas%s/key%d\"", path, i);
+		if (shape < options->lists) {
+			g_string_append(keys, " type=\"list\" ltype=\"string\">");
+			for (j = 0; j < options->list_length; j++) {
+				g_string_append(keys, "<li");
+				_gconf_cleaner_bench_append_scalar(keys, "li", 1, j);
+			}
+			g_string_append(keys, "</entry>\n");
+			stype = g_strdup("stype=\"list\" list_type=\"string\"");
+		} else if (shape < options->lists + options->pairs) {
+			g_string_append(keys, " type=\"pair\"><car");
+			_gconf_cleaner_bench_append_scalar(keys, "car", 0, i);
+			g_string_append(keys, "<cdr");
+			_gconf_cleaner_bench_append_scalar(keys, "cdr", 1, i);
+			g_string_append(keys, "</entry>\n");
+			stype = g_strdup("stype=\"pair\" car_type=\"int\" cdr_type=\"string\"");
+		} else {
+			_gconf_cleaner_bench_append_scalar(keys, "entry", i, i);
+			g_string_append_c(keys, '\n');
+			stype = g_strdup_printf("stype=\"%s\"", types[i % 4]);
+		}
+		if (!is_orphan)
+			g_string_append_printf(schemas,
+					       "\t<entry name=\"key%d\" mtime=\"" GCLEANER_BENCH_MTIME "\" type=\"schema\" %s owner=\"gconf-cleaner-bench\">"
+					       "<local_schema locale=\"C\" short_desc=\"key%d\"/></entry>\n",
+					       i, stype, i);
+		g_free(stype);
+	}
+	bench->n_dirs++;
+	bench->n_keys += options->n_keys;
+
+	dir = g_build_filename(bench->root, path, NULL);
+	retval = _gconf_cleaner_bench_write_xml(dir, keys, error);
+	g_free(dir);
+	if (retval) {
+		dir = g_build_filename(bench->root, "schemas", path, NULL);
+		retval = _gconf_cleaner_bench_write_xml(dir, schemas, error);
+		g_free(dir);
+	}
+	g_string_free(keys, TRUE);
+	g_string_free(schemas, TRUE);
+
+	for (i = 0; retval && depth > 0 && i < options->fanout; i++) {
+		gchar *subdir = g_strdup_printf("%s/dir%d", path, i);
+
+		retval = _gconf_cleaner_bench_generate_dir(bench, subdir, depth - 1, error);
+		g_free(subdir);
+	}
+
+	return retval;
+}
+
+static gboolean
+_gconf_cleaner_bench_generate(GConfCleanerBench  *bench,
+			      GError            **error)
+{
+	GString *empty;
+	gchar *dir;
+	gboolean retval;
+
+	g_rand_set_seed(bench->rand, bench->options->seed);
+	bench->n_dirs = bench->n_keys = bench->n_orphans = 0;
+	/* the toplevel and /schemas have no keys */
+	empty = g_string_new(NULL);
+	retval = _gconf_cleaner_bench_write_xml(bench->root, empty, error);
+	g_string_free(empty, TRUE);
+	if (retval) {
+		empty = g_string_new(NULL);
+		dir = g_build_filename(bench->root, "schemas", NULL);
+		retval = _gconf_cleaner_bench_write_xml(dir, empty, error);
+		g_free(dir);
+		g_string_free(empty, TRUE);
+	}
+	if (retval)
+		retval = _gconf_cleaner_bench_generate_dir(bench, "/bench",
+							   bench->options->depth,
+							   error);
+
+	return retval;
+}
+
+static void
+_gconf_cleaner_bench_remove(const gchar *path)
+{
+	GDir *dir;
+	const gchar *name;
+
+	if ((dir = g_dir_open(path, 0, NULL)) != NULL) {
+		while ((name = g_dir_read_name(dir)) != NULL) {
+			gchar *child = g_build_filename(path, name, NULL);
+
+			_gconf_cleaner_bench_remove(child);
+			g_free(child);
+		}
+		g_dir_close(dir);
+		g_rmdir(path);
+	} else {
+		g_unlink(path);
+	}
+}
+
+static gboolean
+_gconf_cleaner_bench_count_unknown(const gchar *key,
+				   GConfValue  *value,
+				   const gchar *dir,
+				   gpointer     data)
+{
+	guint *n = data;
+
+	(*n)++;
+
+	return TRUE;
+}
+
+static gboolean
+_gconf_cleaner_bench_run(GConfCleanerBench  *bench,
+			 GError            **error)
+{
+	GConfCleanerBenchOptions *options = bench->options;
+	GConfCleaner *cleaner;
+	const GConfCleanerResult *result;
+	GConfCleanerBackupWriter *writer;
+	const gchar *sources[] = {NULL, NULL};
+	gchar *backup;
+	const gchar **keys;
+	guint n_pairs, n_restored, n_skipped, n, i;
+	gboolean retval = FALSE;
+
+	/* gconfd may still have the previous tree at the same address */
+	g_free(bench->root);
+	g_free(bench->address);
+	bench->root = g_strdup_printf("%s/tree%d", options->dir, bench->run);
+	bench->address = g_strconcat("xml:readwrite:", bench->root, NULL);
+	sources[0] = bench->address;
+
+	g_timer_start(bench->timer);
+	if (!_gconf_cleaner_bench_generate(bench, error))
+		return FALSE;
+	_gconf_cleaner_bench_report(bench, "generate", bench->n_keys);
+
+	if ((cleaner = gconf_cleaner_new_for_address(bench->address, error)) == NULL)
+		return FALSE;
+	if (options->direct &&
+	    !gconf_cleaner_set_sources(cleaner, sources, error))
+		goto finalize;
+	gconf_cleaner_set_n_threads(cleaner, options->n_threads);
+	_gconf_cleaner_bench_report(bench, "new", 1);
+
+	if (!gconf_cleaner_update(cleaner, error))
+		goto finalize;
+	_gconf_cleaner_bench_report(bench, "update", gconf_cleaner_n_dirs(cleaner));
+
+	if (!gconf_cleaner_analyze(cleaner, error))
+		goto finalize;
+	_gconf_cleaner_bench_report(bench, "analyze", gconf_cleaner_n_pairs(cleaner));
+
+	result = gconf_cleaner_get_result(cleaner);
+	n_pairs = gconf_cleaner_result_n_pairs(result);
+	keys = g_new(const gchar *, n_pairs);
+	for (i = 0; i < n_pairs; i++)
+		keys[i] = gconf_cleaner_result_dup_key(result, i);
+	_gconf_cleaner_bench_report(bench, "result", n_pairs);
+
+	backup = g_build_filename(options->dir, "backup.reg", NULL);
+	writer = gconf_cleaner_backup_writer_new(backup, FALSE, error);
+	for (i = 0; writer && i < n_pairs; i++) {
+		if (!gconf_cleaner_backup_writer_add(writer, keys[i],
+						     gconf_cleaner_result_get_value(result, i),
+						     error)) {
+			gconf_cleaner_backup_writer_close(writer, NULL);
+			writer = NULL;
+		}
+	}
+	if (writer && gconf_cleaner_backup_writer_close(writer, error)) {
+		_gconf_cleaner_bench_report(bench, "export", n_pairs);
+
+		n = gconf_cleaner_unset_keys(cleaner, keys, n_pairs, NULL, NULL);
+		_gconf_cleaner_bench_report(bench, "unset_keys", n);
+		gconf_cleaner_sync(cleaner, NULL);
+		_gconf_cleaner_bench_report(bench, "sync", 1);
+
+		if (gconf_cleaner_restore(cleaner, backup, &n_restored, &n_skipped, NULL, error)) {
+			_gconf_cleaner_bench_report(bench, "restore", n_restored);
+			gconf_cleaner_sync(cleaner, NULL);
+
+			/* the restored keys are cleanable again */
+			n = 0;
+			if (gconf_cleaner_update(cleaner, error)) {
+				g_timer_start(bench->timer);
+				if (gconf_cleaner_foreach_unknown(cleaner,
+								  _gconf_cleaner_bench_count_unknown,
+								  &n, error)) {
+					_gconf_cleaner_bench_report(bench, "foreach_unknown", n);
+					retval = TRUE;
+				}
+			}
+		}
+	}
+	for (i = 0; i < n_pairs; i++)
+		g_free((gchar *)keys[i]);
+	g_free(keys);
+	g_unlink(backup);
+	g_free(backup);
+
+  finalize:
+	gconf_cleaner_free(cleaner);
+
+	return retval;
+}
+
+/*
+ * Public Functions
+ */
+int
+main(int    argc,
+     char **argv)
+{
+	GConfCleanerBenchOptions options;
+	GConfCleanerBench bench;
+	GOptionContext *context;
+	GError *error = NULL;
+	gint retval = 0;
+	gboolean is_temp = FALSE;
+	GOptionEntry entries[] = {
+		{"depth", 0, 0, G_OPTION_ARG_INT, &options.depth,
+		 "Generate N levels of the directories", "N"},
+		{"fanout", 0, 0, G_OPTION_ARG_INT, &options.fanout,
+		 "Generate N subdirectories in each directory", "N"},
+		{"keys", 0, 0, G_OPTION_ARG_INT, &options.n_keys,
+		 "Generate N keys in each directory", "N"},
+		{"orphans", 0, 0, G_OPTION_ARG_DOUBLE, &options.orphans,
+		 "Leave the schemas out for this ratio of the keys", "RATIO"},
+		{"lists", 0, 0, G_OPTION_ARG_DOUBLE, &options.lists,
+		 "Make this ratio of the keys lists", "RATIO"},
+		{"pairs", 0, 0, G_OPTION_ARG_DOUBLE, &options.pairs,
+		 "Make this ratio of the keys pairs", "RATIO"},
+		{"list-length", 0, 0, G_OPTION_ARG_INT, &options.list_length,
+		 "Put N values in each list", "N"},
+		{"seed", 0, 0, G_OPTION_ARG_INT, &options.seed,
+		 "Seed of the generator", "N"},
+		{"runs", 0, 0, G_OPTION_ARG_INT, &options.runs,
+		 "Repeat N times", "N"},
+		{"threads", 'j', 0, G_OPTION_ARG_INT, &options.n_threads,
+		 "Analyze with N threads. only with --direct", "N"},
+		{"direct", 'd', 0, G_OPTION_ARG_NONE, &options.direct,
+		 "Read the tree directly instead of asking gconfd", NULL},
+		{"dir", 0, 0, G_OPTION_ARG_FILENAME, &options.dir,
+		 "Generate the tree in DIR instead of a temporary directory", "DIR"},
+		{"keep", 0, 0, G_OPTION_ARG_NONE, &options.keep,
+		 "Don't remove the tree at the end", NULL},
+		{NULL}
+	};
+
+	if (!g_thread_supported())
+		g_thread_init(NULL);
+
+	memset(&options, 0, sizeof (GConfCleanerBenchOptions));
+	options.depth = 4;
+	options.fanout = 4;
+	options.n_keys = 16;
+	options.orphans = 0.1;
+	options.lists = 0.1;
+	options.pairs = 0.1;
+	options.list_length = 8;
+	options.seed = 1;
+	options.runs = 3;
+	options.n_threads = 1;
+	context = g_option_context_new(NULL);
+	g_option_context_set_summary(context, "Benchmark GConf Cleaner on a generated GConf tree");
+	g_option_context_add_main_entries(context, entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		return 2;
+	}
+	g_option_context_free(context);
+
+	if (options.dir == NULL) {
+		options.dir = g_build_filename(g_get_tmp_dir(), "gconf-cleaner-bench-XXXXXX", NULL);
+		if (mkdtemp(options.dir) == NULL) {
+			g_printerr("Failed to create a temporary directory\n");
+			g_free(options.dir);
+			return 3;
+		}
+		is_temp = TRUE;
+	}
+	memset(&bench, 0, sizeof (GConfCleanerBench));
+	bench.options = &options;
+	bench.rand = g_rand_new();
+	bench.timer = g_timer_new();
+
+	/* the lines without '#' are "run phase seconds items", tab-separated */
+	g_print("# gconf-cleaner-bench %s\n", PACKAGE_VERSION);
+	g_print("# depth=%d fanout=%d keys=%d orphans=%.3f lists=%.3f pairs=%.3f list-length=%d seed=%d threads=%d direct=%d\n",
+		options.depth, options.fanout, options.n_keys, options.orphans,
+		options.lists, options.pairs, options.list_length, options.seed,
+		options.n_threads, options.direct);
+	g_print("run\tphase\tseconds\titems\n");
+	for (bench.run = 0; bench.run < options.runs; bench.run++) {
+		if (!_gconf_cleaner_bench_run(&bench, &error)) {
+			g_printerr("run %d: %s\n", bench.run,
+				   error ? error->message : "failed");
+			g_clear_error(&error);
+			retval = 3;
+			break;
+		}
+		if (bench.run + 1 < options.runs && !options.keep)
+			_gconf_cleaner_bench_remove(bench.root);
+	}
+	if (bench.run > 0)
+		g_print("# dirs=%u keys=%u orphans=%u\n",
+			bench.n_dirs, bench.n_keys, bench.n_orphans);
+	if (!options.keep && is_temp) {
+		_gconf_cleaner_bench_remove(options.dir);
+	} else if (!options.keep && bench.root) {
+		/* the rest of --dir isn't ours. backup.reg is gone already */
+		_gconf_cleaner_bench_remove(bench.root);
+	}
+
+	g_timer_destroy(bench.timer);
+	g_rand_free(bench.rand);
+	g_free(bench.address);
+	g_free(bench.root);
+	g_free(options.dir);
+
+	return retval;
+}
@@ -0,0 +1,265 @@
+/* 
+ * gconf-cleaner-cache.c
+ * Copyright (C) 2007 Akira TAGOH
+ * 
+ * Authors:
+ *   Akira TAGOH  <akira@tagoh.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gi18n.h>
+#include "gconf-cleaner-cache.h"
+
+#define GCLEANER_CACHE_MAGIC	"# gconf-cleaner scan cache 2"
+
+
+typedef struct _GConfCleanerCacheEntry {
+	guint64 mtime;
+	guint64 size;
+	guint   n_pairs;
+	guint   n_unknown_pairs;
+} GConfCleanerCacheEntry;
+
+struct _GConfCleanerCache {
+	gchar        *filename;
+	GHashTable   *verdicts;	/* loaded from the file */
+	GHashTable   *updates;	/* seen on this run. this is what will be saved */
+	GStaticMutex  lock;
+};
+
+/*
+ * Private Functions
+ */
+static GHashTable *
+_gconf_cleaner_cache_table_new(void)
+{
+	return g_hash_table_new_full(g_str_hash, g_str_equal,
+				     g_free, g_free);
+}
+
+static void
+_gconf_cleaner_cache_insert(GHashTable  *table,
+			    const gchar *dir,
+			    guint64      mtime,
+			    guint64      size,
+			    guint        n_pairs,
+			    guint        n_unknown_pairs)
+{
+	GConfCleanerCacheEntry *entry = g_new(GConfCleanerCacheEntry, 1);
+
+	entry->mtime = mtime;
+	entry->size = size;
+	entry->n_pairs = n_pairs;
+	entry->n_unknown_pairs = n_unknown_pairs;
+	g_hash_table_replace(table, g_strdup(dir), entry);
+}
+
+/* a line is "<mtime in ns> <size> <n_pairs> <n_unknown_pairs> <dir>" */
+static gboolean
+_gconf_cleaner_cache_parse(GConfCleanerCache  *cache,
+			   const gchar        *contents,
+			   GError            **error)
+{
+	gchar **lines;
+	guint64 values[4];
+	gint i, j;
+	gboolean retval = TRUE;
+
+	lines = g_strsplit(contents, "\n", -1);
+	if (lines[0] == NULL || strcmp(lines[0], GCLEANER_CACHE_MAGIC) != 0) {
+		/* written by the different version. just start over */
+		g_strfreev(lines);
+		return TRUE;
+	}
+	for (i = 1; lines[i] != NULL; i++) {
+		gchar *p = lines[i], *end;
+
+		if (*p == 0)
+			continue;
+		for (j = 0; j < 4; j++) {
+			values[j] = g_ascii_strtoull(p, &end, 10);
+			if (end == p || *end != ' ')
+				break;
+			p = end + 1;
+		}
+		if (j < 4 || *p != '/') {
+			g_set_error(error, 0, 0,
+				    _("Invalid line %d in the scan cache `%s'"),
+				    i + 1, cache->filename);
+			retval = FALSE;
+			break;
+		}
+		_gconf_cleaner_cache_insert(cache->verdicts, p,
+					    values[0], values[1],
+					    (guint)values[2], (guint)values[3]);
+	}
+	g_strfreev(lines);
+
+	return retval;
+}
+
+static void
+_gconf_cleaner_cache_dump_entry(gpointer key,
+				gpointer value,
+				gpointer data)
+{
+	GConfCleanerCacheEntry *entry = value;
+	GString *dump = data;
+
+	g_string_append_printf(dump, "%" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %u %u %s\n",
+			       entry->mtime, entry->size,
+			       entry->n_pairs, entry->n_unknown_pairs,
+			       (const gchar *)key);
+}
+
+/*
+ * Public Functions
+ */
+GConfCleanerCache *
+gconf_cleaner_cache_new(const gchar  *filename,
+			GError      **error)
+{
+	GConfCleanerCache *retval;
+	gchar *contents;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	retval = g_new0(GConfCleanerCache, 1);
+	retval->filename = g_strdup(filename);
+	retval->verdicts = _gconf_cleaner_cache_table_new();
+	retval->updates = _gconf_cleaner_cache_table_new();
+	g_static_mutex_init(&retval->lock);
+
+	if (g_file_test(filename, G_FILE_TEST_EXISTS)) {
+		if (!g_file_get_contents(filename, &contents, NULL, error)) {
+			gconf_cleaner_cache_free(retval);
+			return NULL;
+		}
+		if (!_gconf_cleaner_cache_parse(retval, contents, error)) {
+			g_free(contents);
+			gconf_cleaner_cache_free(retval);
+			return NULL;
+		}
+		g_free(contents);
+	}
+
+	return retval;
+}
+
+void
+gconf_cleaner_cache_free(GConfCleanerCache *cache)
+{
+	g_return_if_fail (cache != NULL);
+
+	g_hash_table_destroy(cache->verdicts);
+	g_hash_table_destroy(cache->updates);
+	g_static_mutex_free(&cache->lock);
+	g_free(cache->filename);
+	g_free(cache);
+}
+
+/*
+ * look up the verdict of @dir which was made when its files had
+ * @mtime and @size.  returns FALSE if there are no such verdicts.
+ */
+gboolean
+gconf_cleaner_cache_lookup(GConfCleanerCache *cache,
+			   const gchar       *dir,
+			   guint64            mtime,
+			   guint64            size,
+			   guint             *n_pairs,
+			   guint             *n_unknown_pairs)
+{
+	GConfCleanerCacheEntry *entry;
+	gboolean retval = FALSE;
+
+	g_return_val_if_fail (cache != NULL, FALSE);
+	g_return_val_if_fail (dir != NULL, FALSE);
+
+	g_static_mutex_lock(&cache->lock);
+	entry = g_hash_table_lookup(cache->verdicts, dir);
+	if (entry && entry->mtime == mtime && entry->size == size) {
+		if (n_pairs)
+			*n_pairs = entry->n_pairs;
+		if (n_unknown_pairs)
+			*n_unknown_pairs = entry->n_unknown_pairs;
+		retval = TRUE;
+	}
+	g_static_mutex_unlock(&cache->lock);
+
+	return retval;
+}
+
+void
+gconf_cleaner_cache_store(GConfCleanerCache *cache,
+			  const gchar       *dir,
+			  guint64            mtime,
+			  guint64            size,
+			  guint              n_pairs,
+			  guint              n_unknown_pairs)
+{
+	g_return_if_fail (cache != NULL);
+	g_return_if_fail (dir != NULL);
+
+	g_static_mutex_lock(&cache->lock);
+	_gconf_cleaner_cache_insert(cache->updates, dir, mtime, size,
+				    n_pairs, n_unknown_pairs);
+	g_static_mutex_unlock(&cache->lock);
+}
+
+/*
+ * forget all of the verdicts.  this has to be called whenever the schemas
+ * are installed or removed, because the files of the directories are
+ * still same but the verdicts aren't valid anymore.
+ */
+void
+gconf_cleaner_cache_invalidate(GConfCleanerCache *cache)
+{
+	g_return_if_fail (cache != NULL);
+
+	g_static_mutex_lock(&cache->lock);
+	g_hash_table_destroy(cache->verdicts);
+	g_hash_table_destroy(cache->updates);
+	cache->verdicts = _gconf_cleaner_cache_table_new();
+	cache->updates = _gconf_cleaner_cache_table_new();
+	g_static_mutex_unlock(&cache->lock);
+}
+
+/* only the directories stored on this run are written out */
+gboolean
+gconf_cleaner_cache_save(GConfCleanerCache  *cache,
+			 GError            **error)
+{
+	GString *dump;
+	gboolean retval;
+
+	g_return_val_if_fail (cache != NULL, FALSE);
+
+	dump = g_string_new(GCLEANER_CACHE_MAGIC "\n");
+	g_static_mutex_lock(&cache->lock);
+	g_hash_table_foreach(cache->updates, _gconf_cleaner_cache_dump_entry, dump);
+	g_static_mutex_unlock(&cache->lock);
+	retval = g_file_set_contents(cache->filename, dump->str, dump->len, error);
+	g_string_free(dump, TRUE);
+
+	return retval;
+}
@@ -0,0 +1,53 @@
+/* 
+ * gconf-cleaner-cache.h
+ * Copyright (C) 2007 Akira TAGOH
+ * 
+ * Authors:
+ *   Akira TAGOH  <akira@tagoh.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef __GCONF_CLEANER_CACHE_H__
+#define __GCONF_CLEANER_CACHE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GConfCleanerCache GConfCleanerCache;
+
+GConfCleanerCache *gconf_cleaner_cache_new       (const gchar        *filename,
+						  GError            **error);
+void               gconf_cleaner_cache_free      (GConfCleanerCache  *cache);
+gboolean           gconf_cleaner_cache_lookup    (GConfCleanerCache  *cache,
+						  const gchar        *dir,
+						  guint64             mtime,
+						  guint64             size,
+						  guint              *n_pairs,
+						  guint              *n_unknown_pairs);
+void               gconf_cleaner_cache_store     (GConfCleanerCache  *cache,
+						  const gchar        *dir,
+						  guint64             mtime,
+						  guint64             size,
+						  guint               n_pairs,
+						  guint               n_unknown_pairs);
+void               gconf_cleaner_cache_invalidate(GConfCleanerCache  *cache);
+gboolean           gconf_cleaner_cache_save      (GConfCleanerCache  *cache,
+						  GError            **error);
+
+G_END_DECLS
+
+#endif /* __GCONF_CLEANER_CACHE_H__ */
@@ -0,0 +1,368 @@
+/* 
+ * gconf-cleaner-exclude.c
+ * Copyright (C) 2007 Akira TAGOH
+ * 
+ * Authors:
+ *   Akira TAGOH  <akira@tagoh.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <glib/gi18n.h>
+#include "gconf-cleaner-exclude.h"
+
+
+/*
+ * the rules are compiled into a trie of the path components.  the exact
+ * components are looked up in the hash table, so that the cost of the
+ * matching doesn't depend on the number of the rules.  the globs and
+ * "**" are the edges that have to be tried one by one.
+ */
+typedef struct _GConfCleanerExcludeNode GConfCleanerExcludeNode;
+typedef struct _GConfCleanerExcludeGlob {
+	GPatternSpec            *pattern;
+	GConfCleanerExcludeNode *node;
+} GConfCleanerExcludeGlob;
+struct _GConfCleanerExcludeNode {
+	GHashTable              *children;	/* component -> node */
+	GSList                  *globs;
+	GConfCleanerExcludeNode *any;		/* "**" */
+	gboolean                 is_any;	/* matches any number of components */
+	gboolean                 excluded;
+};
+
+struct _GConfCleanerExclude {
+	GConfCleanerExcludeNode *root;
+	GPtrArray               *nodes;	/* owns all of the nodes */
+	guint                    n_rules;
+};
+
+/*
+ * Private Functions
+ */
+static GConfCleanerExcludeNode *
+_gconf_cleaner_exclude_node_new(GConfCleanerExclude *exclude)
+{
+	GConfCleanerExcludeNode *retval = g_new0(GConfCleanerExcludeNode, 1);
+
+	g_ptr_array_add(exclude->nodes, retval);
+
+	return retval;
+}
+
+static void
+_gconf_cleaner_exclude_node_free(GConfCleanerExcludeNode *node)
+{
+	GSList *l;
+
+	if (node->children)
+		g_hash_table_destroy(node->children);
+	for (l = node->globs; l != NULL; l = g_slist_next(l)) {
+		GConfCleanerExcludeGlob *glob = l->data;
+
+		g_pattern_spec_free(glob->pattern);
+		g_free(glob);
+	}
+	g_slist_free(node->globs);
+	g_free(node);
+}
+
+static gboolean
+_gconf_cleaner_exclude_is_glob(const gchar *component)
+{
+	return strpbrk(component, "*?") != NULL;
+}
+
+static GConfCleanerExcludeNode *
+_gconf_cleaner_exclude_node_add(GConfCleanerExclude     *exclude,
+				GConfCleanerExcludeNode *node,
+				const gchar             *component)
+{
+	GConfCleanerExcludeNode *retval;
+	GConfCleanerExcludeGlob *glob;
+	GSList *l;
+
+	if (strcmp(component, "**") == 0) {
+		if (node->any == NULL) {
+			node->any = _gconf_cleaner_exclude_node_new(exclude);
+			node->any->is_any = TRUE;
+		}
+		return node->any;
+	}
+	if (_gconf_cleaner_exclude_is_glob(component)) {
+		GPatternSpec *pattern = g_pattern_spec_new(component);
+
+		for (l = node->globs; l != NULL; l = g_slist_next(l)) {
+			glob = l->data;
+			if (g_pattern_spec_equal(glob->pattern, pattern)) {
+				g_pattern_spec_free(pattern);
+				return glob->node;
+			}
+		}
+		glob = g_new(GConfCleanerExcludeGlob, 1);
+		glob->pattern = pattern;
+		glob->node = _gconf_cleaner_exclude_node_new(exclude);
+		node->globs = g_slist_append(node->globs, glob);
+
+		return glob->node;
+	}
+	if (node->children == NULL)
+		node->children = g_hash_table_new_full(g_str_hash, g_str_equal,
+						       g_free, NULL);
+	if ((retval = g_hash_table_lookup(node->children, component)) == NULL) {
+		retval = _gconf_cleaner_exclude_node_new(exclude);
+		g_hash_table_insert(node->children, g_strdup(component), retval);
+	}
+
+	return retval;
+}
+
+/* add @node and the nodes reachable through "**" without any components */
+static void
+_gconf_cleaner_exclude_states_add(GPtrArray               *states,
+				  GConfCleanerExcludeNode *node)
+{
+	guint i;
+
+	for (; node != NULL; node = node->any) {
+		for (i = 0; i < states->len; i++) {
+			if (g_ptr_array_index(states, i) == node)
+				break;
+		}
+		if (i == states->len)
+			g_ptr_array_add(states, node);
+	}
+}
+
+/*
+ * Public Functions
+ */
+GConfCleanerExclude *
+gconf_cleaner_exclude_new(void)
+{
+	GConfCleanerExclude *retval = g_new0(GConfCleanerExclude, 1);
+
+	retval->nodes = g_ptr_array_new();
+	retval->root = _gconf_cleaner_exclude_node_new(retval);
+
+	return retval;
+}
+
+void
+gconf_cleaner_exclude_free(GConfCleanerExclude *exclude)
+{
+	guint i;
+
+	g_return_if_fail (exclude != NULL);
+
+	for (i = 0; i < exclude->nodes->len; i++)
+		_gconf_cleaner_exclude_node_free(g_ptr_array_index(exclude->nodes, i));
+	g_ptr_array_free(exclude->nodes, TRUE);
+	g_free(exclude);
+}
+
+void
+gconf_cleaner_exclude_clear(GConfCleanerExclude *exclude)
+{
+	guint i;
+
+	g_return_if_fail (exclude != NULL);
+
+	for (i = 0; i < exclude->nodes->len; i++)
+		_gconf_cleaner_exclude_node_free(g_ptr_array_index(exclude->nodes, i));
+	g_ptr_array_set_size(exclude->nodes, 0);
+	exclude->root = _gconf_cleaner_exclude_node_new(exclude);
+	exclude->n_rules = 0;
+}
+
+/*
+ * add @rule.  a rule starting with '/' is the full path of the directory,
+ * which may contain '*' and '?' in the components and "**" as any number
+ * of the components.  otherwise it's the basename of the directories.
+ * the subdirectories of the excluded directory are excluded as well.
+ */
+gboolean
+gconf_cleaner_exclude_add(GConfCleanerExclude  *exclude,
+			  const gchar          *rule,
+			  GError              **error)
+{
+	GConfCleanerExcludeNode *node;
+	gchar **components;
+	gint i, n = 0;
+
+	g_return_val_if_fail (exclude != NULL, FALSE);
+	g_return_val_if_fail (rule != NULL, FALSE);
+
+	if (rule[0] != '/' && strchr(rule, '/') != NULL) {
+		g_set_error(error, 0, 0,
+			    _("Invalid exclusion rule `%s': a basename can't contain `/'"),
+			    rule);
+		return FALSE;
+	}
+	node = exclude->root;
+	if (rule[0] != '/')
+		node = _gconf_cleaner_exclude_node_add(exclude, node, "**");
+	components = g_strsplit(rule, "/", -1);
+	for (i = 0; components[i] != NULL; i++) {
+		if (components[i][0] == 0)
+			continue;
+		node = _gconf_cleaner_exclude_node_add(exclude, node, components[i]);
+		n++;
+	}
+	g_strfreev(components);
+	if (n == 0) {
+		g_set_error(error, 0, 0,
+			    _("Invalid exclusion rule `%s': nothing would be analyzed"),
+			    rule);
+		return FALSE;
+	}
+	node->excluded = TRUE;
+	exclude->n_rules++;
+
+	return TRUE;
+}
+
+void
+gconf_cleaner_exclude_add_defaults(GConfCleanerExclude *exclude)
+{
+	gint i;
+	/* XXX: may want to have more strict way of excluding keys */
+	static const gchar *defaults[] = {
+		"schemas", "profiles", "preferences", "prefs", "connected_servers", "wireless", "vpn_connections",
+		NULL,
+	};
+
+	g_return_if_fail (exclude != NULL);
+
+	for (i = 0; defaults[i] != NULL; i++)
+		gconf_cleaner_exclude_add(exclude, defaults[i], NULL);
+}
+
+/*
+ * load the rules from @filename, one per line.  the empty lines and
+ * the lines starting with '#' are ignored.
+ */
+gboolean
+gconf_cleaner_exclude_load(GConfCleanerExclude  *exclude,
+			   const gchar          *filename,
+			   GError              **error)
+{
+	gchar *contents, **lines;
+	gboolean retval = TRUE;
+	GError *err = NULL;
+	gint i;
+
+	g_return_val_if_fail (exclude != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	if (!g_file_get_contents(filename, &contents, NULL, error))
+		return FALSE;
+	lines = g_strsplit(contents, "\n", -1);
+	g_free(contents);
+	for (i = 0; lines[i] != NULL; i++) {
+		gchar *rule = g_strstrip(lines[i]);
+
+		if (*rule == 0 || *rule == '#')
+			continue;
+		if (!gconf_cleaner_exclude_add(exclude, rule, &err)) {
+			g_set_error(error, 0, 0, "%s:%d: %s",
+				    filename, i + 1, err->message);
+			g_error_free(err);
+			retval = FALSE;
+			break;
+		}
+	}
+	g_strfreev(lines);
+
+	return retval;
+}
+
+guint
+gconf_cleaner_exclude_n_rules(GConfCleanerExclude *exclude)
+{
+	g_return_val_if_fail (exclude != NULL, 0);
+
+	return exclude->n_rules;
+}
+
+/*
+ * returns TRUE if @path or any of its parents are excluded.
+ */
+gboolean
+gconf_cleaner_exclude_match(GConfCleanerExclude *exclude,
+			    const gchar         *path)
+{
+	GPtrArray *states, *next, *tmp;
+	GConfCleanerExcludeNode *node, *child;
+	const gchar *p, *end;
+	gchar *component;
+	gboolean retval = FALSE;
+	GSList *l;
+	guint i;
+
+	g_return_val_if_fail (exclude != NULL, FALSE);
+	g_return_val_if_fail (path != NULL, FALSE);
+
+	if (exclude->n_rules == 0)
+		return FALSE;
+
+	states = g_ptr_array_new();
+	next = g_ptr_array_new();
+	_gconf_cleaner_exclude_states_add(states, exclude->root);
+	for (p = path; *p != 0 && states->len > 0 && !retval; p = end) {
+		while (*p == '/')
+			p++;
+		if (*p == 0)
+			break;
+		if ((end = strchr(p, '/')) == NULL)
+			end = p + strlen(p);
+		component = g_strndup(p, end - p);
+		g_ptr_array_set_size(next, 0);
+		for (i = 0; i < states->len; i++) {
+			node = g_ptr_array_index(states, i);
+			if (node->is_any)
+				_gconf_cleaner_exclude_states_add(next, node);
+			if (node->children &&
+			    (child = g_hash_table_lookup(node->children, component)) != NULL)
+				_gconf_cleaner_exclude_states_add(next, child);
+			for (l = node->globs; l != NULL; l = g_slist_next(l)) {
+				GConfCleanerExcludeGlob *glob = l->data;
+
+				if (g_pattern_match_string(glob->pattern, component))
+					_gconf_cleaner_exclude_states_add(next, glob->node);
+			}
+		}
+		g_free(component);
+		for (i = 0; i < next->len; i++) {
+			node = g_ptr_array_index(next, i);
+			if (node->excluded) {
+				retval = TRUE;
+				break;
+			}
+		}
+		tmp = states;
+		states = next;
+		next = tmp;
+	}
+	g_ptr_array_free(states, TRUE);
+	g_ptr_array_free(next, TRUE);
+
+	return retval;
+}
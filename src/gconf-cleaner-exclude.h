@@ -0,0 +1,48 @@
+/* 
+ * gconf-cleaner-exclude.h
+ * Copyright (C) 2007 Akira TAGOH
+ * 
+ * Authors:
+ *   Akira TAGOH  <akira@tagoh.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef __GCONF_CLEANER_EXCLUDE_H__
+#define __GCONF_CLEANER_EXCLUDE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GConfCleanerExclude GConfCleanerExclude;
+
+GConfCleanerExclude *gconf_cleaner_exclude_new       (void);
+void                 gconf_cleaner_exclude_free      (GConfCleanerExclude  *exclude);
+void                 gconf_cleaner_exclude_clear     (GConfCleanerExclude  *exclude);
+gboolean             gconf_cleaner_exclude_add       (GConfCleanerExclude  *exclude,
+						      const gchar          *rule,
+						      GError              **error);
+void                 gconf_cleaner_exclude_add_defaults(GConfCleanerExclude *exclude);
+gboolean             gconf_cleaner_exclude_load      (GConfCleanerExclude  *exclude,
+						      const gchar          *filename,
+						      GError              **error);
+guint                gconf_cleaner_exclude_n_rules   (GConfCleanerExclude  *exclude);
+gboolean             gconf_cleaner_exclude_match     (GConfCleanerExclude  *exclude,
+						      const gchar          *path);
+
+G_END_DECLS
+
+#endif /* __GCONF_CLEANER_EXCLUDE_H__ */
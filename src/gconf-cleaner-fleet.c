@@ -0,0 +1,467 @@
+/* 
+ * gconf-cleaner-fleet.c
+ * Copyright (C) 2007 Akira TAGOH
+ * 
+ * Authors:
+ *   Akira TAGOH  <akira@tagoh.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include "gconf-cleaner-fleet.h"
+
+#ifndef GCLEANER_GCONF_SYSCONFDIR
+#define GCLEANER_GCONF_SYSCONFDIR	"/etc/gconf"
+#endif
+
+
+/*
+ * each source is scanned by its own GConfCleaner.  the ones read directly
+ * are shared out to the threads, at most n_jobs at once.  GConf isn't
+ * thread-safe, so the ones going through gconfd are scanned one by one
+ * in the caller's thread.
+ */
+typedef struct _GConfCleanerFleetOrphan {
+	const gchar *key;
+	guint        n_sources;
+} GConfCleanerFleetOrphan;
+
+struct _GConfCleanerFleet {
+	GPtrArray                  *sources;
+	gchar                     **mandatory;	/* looked up before the source of each user */
+	gchar                     **defaults;	/* and after it */
+	gboolean                    direct;
+	guint                       n_jobs;
+	GConfCleanerFleetSetupFunc  func;
+	gpointer                    user_data;
+	GHashTable                 *orphans;	/* key -> the number of the sources */
+	GStaticMutex                lock;
+	volatile gint               next_source;
+};
+
+/*
+ * Private Functions
+ */
+static void
+_gconf_cleaner_fleet_source_clear(GConfCleanerFleetSource *source)
+{
+	source->n_dirs = source->n_pairs = source->n_unknown_pairs = 0;
+	source->time = 0.0;
+	if (source->error)
+		g_error_free(source->error);
+	source->error = NULL;
+}
+
+/* a home directory is turned into its ~/.gconf */
+static gchar *
+_gconf_cleaner_fleet_get_address(const gchar *source)
+{
+	gchar *basename, *retval;
+
+	if (g_str_has_prefix(source, "xml:"))
+		return g_strdup(source);
+	basename = g_path_get_basename(source);
+	if (strcmp(basename, ".gconf") == 0)
+		retval = g_strconcat("xml:readwrite:", source, NULL);
+	else
+		retval = g_strconcat("xml:readwrite:", source, G_DIR_SEPARATOR_S ".gconf", NULL);
+	g_free(basename);
+
+	return retval;
+}
+
+static void
+_gconf_cleaner_fleet_merge_orphans(GConfCleanerFleet  *fleet,
+				   GConfCleaner       *gcleaner)
+{
+	const GConfCleanerResult *result = gconf_cleaner_get_result(gcleaner);
+	GPtrArray *keys;
+	guint i;
+
+	/* build the keys before taking the lock */
+	keys = g_ptr_array_sized_new(gconf_cleaner_result_n_pairs(result));
+	for (i = 0; i < gconf_cleaner_result_n_pairs(result); i++)
+		g_ptr_array_add(keys, gconf_cleaner_result_dup_key(result, i));
+
+	g_static_mutex_lock(&fleet->lock);
+	for (i = 0; i < keys->len; i++) {
+		gchar *key = g_ptr_array_index(keys, i);
+		gpointer orig_key, value;
+
+		if (g_hash_table_lookup_extended(fleet->orphans, key, &orig_key, &value)) {
+			g_hash_table_insert(fleet->orphans, orig_key,
+					    GUINT_TO_POINTER (GPOINTER_TO_UINT (value) + 1));
+			g_free(key);
+		} else {
+			g_hash_table_insert(fleet->orphans, key, GUINT_TO_POINTER (1));
+		}
+	}
+	g_static_mutex_unlock(&fleet->lock);
+	g_ptr_array_free(keys, TRUE);
+}
+
+static void
+_gconf_cleaner_fleet_scan(GConfCleanerFleet       *fleet,
+			  GConfCleanerFleetSource *source)
+{
+	GConfCleaner *gcleaner;
+	GPtrArray *addresses;
+	GTimer *timer = g_timer_new();
+	gint i;
+
+	/* in order of priority, as in the path file */
+	addresses = g_ptr_array_new();
+	for (i = 0; fleet->mandatory[i] != NULL; i++)
+		g_ptr_array_add(addresses, fleet->mandatory[i]);
+	g_ptr_array_add(addresses, source->address);
+	for (i = 0; fleet->defaults[i] != NULL; i++)
+		g_ptr_array_add(addresses, fleet->defaults[i]);
+	g_ptr_array_add(addresses, NULL);
+
+	if (fleet->direct)
+		gcleaner = gconf_cleaner_new_for_sources((const gchar * const *)addresses->pdata,
+							 &source->error);
+	else
+		gcleaner = gconf_cleaner_new_for_addresses((const gchar * const *)addresses->pdata,
+							   &source->error);
+	g_ptr_array_free(addresses, TRUE);
+	if (gcleaner == NULL)
+		goto finalize;
+	if (fleet->func == NULL || fleet->func(gcleaner, fleet->user_data, &source->error)) {
+		if (gconf_cleaner_update(gcleaner, &source->error) &&
+		    gconf_cleaner_analyze(gcleaner, &source->error)) {
+			source->n_dirs = gconf_cleaner_n_dirs(gcleaner);
+			source->n_pairs = gconf_cleaner_n_pairs(gcleaner);
+			source->n_unknown_pairs = gconf_cleaner_n_unknown_pairs(gcleaner);
+			_gconf_cleaner_fleet_merge_orphans(fleet, gcleaner);
+		}
+	}
+	gconf_cleaner_free(gcleaner);
+
+  finalize:
+	source->time = g_timer_elapsed(timer, NULL);
+	g_timer_destroy(timer);
+}
+
+static gpointer
+_gconf_cleaner_fleet_thread(gpointer data)
+{
+	GConfCleanerFleet *fleet = data;
+	gint i;
+
+	while ((i = g_atomic_int_exchange_and_add(&fleet->next_source, 1)) < (gint)fleet->sources->len)
+		_gconf_cleaner_fleet_scan(fleet, g_ptr_array_index(fleet->sources, i));
+
+	return NULL;
+}
+
+static gint
+_gconf_cleaner_fleet_orphan_compare(gconstpointer a,
+				    gconstpointer b)
+{
+	const GConfCleanerFleetOrphan *oa = a, *ob = b;
+
+	if (oa->n_sources != ob->n_sources)
+		return oa->n_sources > ob->n_sources ? -1 : 1;
+
+	return strcmp(oa->key, ob->key);
+}
+
+static void
+_gconf_cleaner_fleet_collect_orphan(gpointer key,
+				    gpointer value,
+				    gpointer data)
+{
+	GArray *orphans = data;
+	GConfCleanerFleetOrphan orphan;
+
+	orphan.key = key;
+	orphan.n_sources = GPOINTER_TO_UINT (value);
+	g_array_append_val(orphans, orphan);
+}
+
+/*
+ * Public Functions
+ */
+GConfCleanerFleet *
+gconf_cleaner_fleet_new(void)
+{
+	GConfCleanerFleet *retval = g_new0(GConfCleanerFleet, 1);
+
+	retval->sources = g_ptr_array_new();
+	retval->n_jobs = 1;
+	retval->orphans = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	g_static_mutex_init(&retval->lock);
+	gconf_cleaner_fleet_set_shared_sources(retval, NULL, NULL);
+
+	return retval;
+}
+
+void
+gconf_cleaner_fleet_free(GConfCleanerFleet *fleet)
+{
+	guint i;
+
+	g_return_if_fail (fleet != NULL);
+
+	for (i = 0; i < fleet->sources->len; i++) {
+		GConfCleanerFleetSource *source = g_ptr_array_index(fleet->sources, i);
+
+		_gconf_cleaner_fleet_source_clear(source);
+		g_free(source->name);
+		g_free(source->address);
+		g_free(source);
+	}
+	g_ptr_array_free(fleet->sources, TRUE);
+	g_strfreev(fleet->mandatory);
+	g_strfreev(fleet->defaults);
+	g_hash_table_destroy(fleet->orphans);
+	g_static_mutex_free(&fleet->lock);
+	g_free(fleet);
+}
+
+/*
+ * @source is either the address of the configuration source of a user or
+ * the home directory, which means its .gconf.
+ */
+void
+gconf_cleaner_fleet_add_source(GConfCleanerFleet *fleet,
+			       const gchar       *source)
+{
+	GConfCleanerFleetSource *s;
+
+	g_return_if_fail (fleet != NULL);
+	g_return_if_fail (source != NULL);
+
+	s = g_new0(GConfCleanerFleetSource, 1);
+	s->name = g_strdup(source);
+	s->address = _gconf_cleaner_fleet_get_address(source);
+	g_ptr_array_add(fleet->sources, s);
+}
+
+/* one source per line.  the empty lines and the lines starting with '#' are ignored */
+gboolean
+gconf_cleaner_fleet_load_sources(GConfCleanerFleet  *fleet,
+				 const gchar        *filename,
+				 GError            **error)
+{
+	gchar *contents, **lines;
+	gint i;
+
+	g_return_val_if_fail (fleet != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	if (!g_file_get_contents(filename, &contents, NULL, error))
+		return FALSE;
+	lines = g_strsplit(contents, "\n", -1);
+	g_free(contents);
+	for (i = 0; lines[i] != NULL; i++) {
+		gchar *line = g_strstrip(lines[i]);
+
+		if (*line == 0 || *line == '#')
+			continue;
+		gconf_cleaner_fleet_add_source(fleet, line);
+	}
+	g_strfreev(lines);
+
+	return TRUE;
+}
+
+/*
+ * the sources looked up together with the one of each user, mainly for
+ * the schemas: @mandatory before it and @defaults after it.  if both are
+ * NULL, the system-wide mandatory and default sources are used.
+ */
+void
+gconf_cleaner_fleet_set_shared_sources(GConfCleanerFleet   *fleet,
+				       const gchar * const *mandatory,
+				       const gchar * const *defaults)
+{
+	static const gchar *system_mandatory[] = {
+		"xml:readonly:" GCLEANER_GCONF_SYSCONFDIR "/gconf.xml.mandatory",
+		NULL
+	};
+	static const gchar *system_defaults[] = {
+		"xml:readonly:" GCLEANER_GCONF_SYSCONFDIR "/gconf.xml.defaults",
+		NULL
+	};
+	static const gchar *none[] = {
+		NULL
+	};
+
+	g_return_if_fail (fleet != NULL);
+
+	if (mandatory == NULL && defaults == NULL) {
+		mandatory = system_mandatory;
+		defaults = system_defaults;
+	}
+	g_strfreev(fleet->mandatory);
+	g_strfreev(fleet->defaults);
+	fleet->mandatory = g_strdupv((gchar **)(mandatory ? mandatory : none));
+	fleet->defaults = g_strdupv((gchar **)(defaults ? defaults : none));
+}
+
+/* read the sources directly instead of asking gconfd, in parallel */
+void
+gconf_cleaner_fleet_set_direct(GConfCleanerFleet *fleet,
+			       gboolean           flag)
+{
+	g_return_if_fail (fleet != NULL);
+
+	fleet->direct = (flag == TRUE);
+}
+
+/* how many sources are scanned at once when they're read directly */
+void
+gconf_cleaner_fleet_set_n_jobs(GConfCleanerFleet *fleet,
+			       guint              n_jobs)
+{
+	g_return_if_fail (fleet != NULL);
+
+	fleet->n_jobs = MAX (n_jobs, 1);
+}
+
+/*
+ * @func is called for every cleaner before scanning, e.g. to add the
+ * exclusion rules.  it may be called in any thread.
+ */
+void
+gconf_cleaner_fleet_set_setup_func(GConfCleanerFleet          *fleet,
+				   GConfCleanerFleetSetupFunc  func,
+				   gpointer                    user_data)
+{
+	g_return_if_fail (fleet != NULL);
+
+	fleet->func = func;
+	fleet->user_data = user_data;
+}
+
+/*
+ * scan all of the sources.  returns the number of the sources which
+ * couldn't be scanned.  see the error of each source for the reason.
+ */
+guint
+gconf_cleaner_fleet_run(GConfCleanerFleet *fleet)
+{
+	GThread **threads;
+	guint n_threads, i, retval = 0;
+
+	g_return_val_if_fail (fleet != NULL, 0);
+
+	g_hash_table_remove_all(fleet->orphans);
+	for (i = 0; i < fleet->sources->len; i++)
+		_gconf_cleaner_fleet_source_clear(g_ptr_array_index(fleet->sources, i));
+	fleet->next_source = 0;
+
+	n_threads = fleet->direct && g_thread_supported() ? MIN (fleet->n_jobs, fleet->sources->len) : 1;
+	threads = g_new0(GThread *, MAX (n_threads, 1));
+	/* the caller's thread works as the first one */
+	for (i = 1; i < n_threads; i++)
+		threads[i] = g_thread_create(_gconf_cleaner_fleet_thread, fleet, TRUE, NULL);
+	_gconf_cleaner_fleet_thread(fleet);
+	for (i = 1; i < n_threads; i++) {
+		if (threads[i])
+			g_thread_join(threads[i]);
+	}
+	g_free(threads);
+
+	for (i = 0; i < fleet->sources->len; i++) {
+		GConfCleanerFleetSource *source = g_ptr_array_index(fleet->sources, i);
+
+		if (source->error)
+			retval++;
+	}
+
+	return retval;
+}
+
+guint
+gconf_cleaner_fleet_n_sources(GConfCleanerFleet *fleet)
+{
+	g_return_val_if_fail (fleet != NULL, 0);
+
+	return fleet->sources->len;
+}
+
+const GConfCleanerFleetSource *
+gconf_cleaner_fleet_get_source(GConfCleanerFleet *fleet,
+			       guint              index)
+{
+	g_return_val_if_fail (fleet != NULL, NULL);
+	g_return_val_if_fail (index < fleet->sources->len, NULL);
+
+	return g_ptr_array_index(fleet->sources, index);
+}
+
+/*
+ * dump the result of gconf_cleaner_fleet_run() as the tab-separated lines:
+ *   source	<name>	<dirs>	<keys>	<cleanable>	<seconds>	<error>
+ *   total	<sources>	<dirs>	<keys>	<cleanable>	<failed>
+ *   orphan	<sources>	<key>
+ * the @n_orphans keys cleanable in the most sources are listed, or all
+ * of them if @n_orphans is 0.
+ */
+gchar *
+gconf_cleaner_fleet_dump(GConfCleanerFleet *fleet,
+			 guint              n_orphans)
+{
+	GString *retval;
+	GArray *orphans;
+	guint64 n_dirs = 0, n_pairs = 0, n_unknown_pairs = 0;
+	guint i, n_failed = 0;
+
+	g_return_val_if_fail (fleet != NULL, NULL);
+
+	retval = g_string_new("#source\tname\tdirs\tkeys\tcleanable\tseconds\terror\n");
+	for (i = 0; i < fleet->sources->len; i++) {
+		GConfCleanerFleetSource *source = g_ptr_array_index(fleet->sources, i);
+
+		g_string_append_printf(retval, "source\t%s\t%u\t%u\t%u\t%.3f\t%s\n",
+				       source->name, source->n_dirs,
+				       source->n_pairs, source->n_unknown_pairs,
+				       source->time,
+				       source->error ? source->error->message : "-");
+		n_dirs += source->n_dirs;
+		n_pairs += source->n_pairs;
+		n_unknown_pairs += source->n_unknown_pairs;
+		if (source->error)
+			n_failed++;
+	}
+	g_string_append_printf(retval,
+			       "total\t%u\t%" G_GUINT64_FORMAT "\t%" G_GUINT64_FORMAT "\t%" G_GUINT64_FORMAT "\t%u\n",
+			       fleet->sources->len, n_dirs, n_pairs, n_unknown_pairs, n_failed);
+
+	orphans = g_array_sized_new(FALSE, FALSE, sizeof (GConfCleanerFleetOrphan),
+				    g_hash_table_size(fleet->orphans));
+	g_hash_table_foreach(fleet->orphans, _gconf_cleaner_fleet_collect_orphan, orphans);
+	g_array_sort(orphans, _gconf_cleaner_fleet_orphan_compare);
+	if (n_orphans == 0 || n_orphans > orphans->len)
+		n_orphans = orphans->len;
+	g_string_append(retval, "#orphan\tsources\tkey\n");
+	for (i = 0; i < n_orphans; i++) {
+		GConfCleanerFleetOrphan *orphan = &g_array_index(orphans, GConfCleanerFleetOrphan, i);
+
+		g_string_append_printf(retval, "orphan\t%u\t%s\n", orphan->n_sources, orphan->key);
+	}
+	g_array_free(orphans, TRUE);
+
+	return g_string_free(retval, FALSE);
+}
@@ -0,0 +1,74 @@
+/* 
+ * gconf-cleaner-fleet.h
+ * Copyright (C) 2007 Akira TAGOH
+ * 
+ * Authors:
+ *   Akira TAGOH  <akira@tagoh.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef __GCONF_CLEANER_FLEET_H__
+#define __GCONF_CLEANER_FLEET_H__
+
+#include <glib.h>
+#include "gconf-cleaner.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GConfCleanerFleet       GConfCleanerFleet;
+typedef struct _GConfCleanerFleetSource GConfCleanerFleetSource;
+
+typedef gboolean (* GConfCleanerFleetSetupFunc) (GConfCleaner  *gcleaner,
+						 gpointer       user_data,
+						 GError       **error);
+
+struct _GConfCleanerFleetSource {
+	gchar   *name;		/* as it's given */
+	gchar   *address;
+	guint    n_dirs;
+	guint    n_pairs;
+	guint    n_unknown_pairs;
+	gdouble  time;
+	GError  *error;
+};
+
+GConfCleanerFleet             *gconf_cleaner_fleet_new               (void);
+void                           gconf_cleaner_fleet_free              (GConfCleanerFleet           *fleet);
+void                           gconf_cleaner_fleet_add_source        (GConfCleanerFleet           *fleet,
+								      const gchar                 *source);
+gboolean                       gconf_cleaner_fleet_load_sources      (GConfCleanerFleet           *fleet,
+								      const gchar                 *filename,
+								      GError                     **error);
+void                           gconf_cleaner_fleet_set_shared_sources(GConfCleanerFleet           *fleet,
+								      const gchar * const         *mandatory,
+								      const gchar * const         *defaults);
+void                           gconf_cleaner_fleet_set_direct        (GConfCleanerFleet           *fleet,
+								      gboolean                     flag);
+void                           gconf_cleaner_fleet_set_n_jobs        (GConfCleanerFleet           *fleet,
+								      guint                        n_jobs);
+void                           gconf_cleaner_fleet_set_setup_func    (GConfCleanerFleet           *fleet,
+								      GConfCleanerFleetSetupFunc   func,
+								      gpointer                     user_data);
+guint                          gconf_cleaner_fleet_run               (GConfCleanerFleet           *fleet);
+guint                          gconf_cleaner_fleet_n_sources         (GConfCleanerFleet           *fleet);
+const GConfCleanerFleetSource *gconf_cleaner_fleet_get_source        (GConfCleanerFleet           *fleet,
+								      guint                        index);
+gchar                         *gconf_cleaner_fleet_dump              (GConfCleanerFleet           *fleet,
+								      guint                        n_orphans);
+
+G_END_DECLS
+
+#endif /* __GCONF_CLEANER_FLEET_H__ */
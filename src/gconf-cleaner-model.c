@@ -0,0 +1,365 @@
+/* 
+ * gconf-cleaner-model.c
+ * Copyright (C) 2007 Akira TAGOH
+ * 
+ * Authors:
+ *   Akira TAGOH  <akira@tagoh.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <gconf/gconf-value.h>
+#include "gconf-cleaner-model.h"
+
+
+/*
+ * the rows are the pairs in the result as they are.  only the check state
+ * is kept here, and the key and the value are rendered when they're asked.
+ * the strings are cached in a small table indexed by the row number, so
+ * that the rows being drawn again and again are rendered once and the
+ * memory doesn't grow with the number of the rows.
+ */
+#define GCLEANER_MODEL_N_CACHED_ROWS	256
+
+struct _GConfCleanerModelRow {
+	guint  index;
+	gchar *key;
+	gchar *value;
+};
+
+static void _gconf_cleaner_model_tree_model_init(GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (GConfCleanerModel, gconf_cleaner_model, G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL,
+						_gconf_cleaner_model_tree_model_init));
+
+/*
+ * Private Functions
+ */
+static GConfCleanerModelRow *
+_gconf_cleaner_model_get_row(GConfCleanerModel *model,
+			     guint              index)
+{
+	GConfCleanerModelRow *row = &model->rows[index % GCLEANER_MODEL_N_CACHED_ROWS];
+
+	if (row->key == NULL || row->index != index) {
+		g_free(row->key);
+		g_free(row->value);
+		row->index = index;
+		row->key = gconf_cleaner_result_dup_key(model->result, index);
+		row->value = gconf_value_to_string(gconf_cleaner_result_get_value(model->result, index));
+	}
+
+	return row;
+}
+
+static void
+_gconf_cleaner_model_finalize(GObject *object)
+{
+	GConfCleanerModel *model = GCLEANER_MODEL (object);
+	guint i;
+
+	for (i = 0; i < GCLEANER_MODEL_N_CACHED_ROWS; i++) {
+		g_free(model->rows[i].key);
+		g_free(model->rows[i].value);
+	}
+	g_free(model->rows);
+	g_free(model->active);
+
+	G_OBJECT_CLASS (gconf_cleaner_model_parent_class)->finalize(object);
+}
+
+static GtkTreeModelFlags
+_gconf_cleaner_model_get_flags(GtkTreeModel *tree_model)
+{
+	return GTK_TREE_MODEL_ITERS_PERSIST | GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint
+_gconf_cleaner_model_get_n_columns(GtkTreeModel *tree_model)
+{
+	return GCLEANER_MODEL_N_COLUMNS;
+}
+
+static GType
+_gconf_cleaner_model_get_column_type(GtkTreeModel *tree_model,
+				     gint          index)
+{
+	g_return_val_if_fail (index >= 0 && index < GCLEANER_MODEL_N_COLUMNS, G_TYPE_INVALID);
+
+	return index == GCLEANER_MODEL_COLUMN_ACTIVE ? G_TYPE_BOOLEAN : G_TYPE_STRING;
+}
+
+static gboolean
+_gconf_cleaner_model_iter_nth_child(GtkTreeModel *tree_model,
+				    GtkTreeIter  *iter,
+				    GtkTreeIter  *parent,
+				    gint          n)
+{
+	GConfCleanerModel *model = GCLEANER_MODEL (tree_model);
+
+	if (parent != NULL || n < 0 || (guint)n >= model->n_rows)
+		return FALSE;
+	iter->stamp = model->stamp;
+	iter->user_data = GUINT_TO_POINTER (n);
+
+	return TRUE;
+}
+
+static gboolean
+_gconf_cleaner_model_get_iter(GtkTreeModel *tree_model,
+			      GtkTreeIter  *iter,
+			      GtkTreePath  *path)
+{
+	g_return_val_if_fail (gtk_tree_path_get_depth(path) > 0, FALSE);
+
+	if (gtk_tree_path_get_depth(path) > 1)
+		return FALSE;
+
+	return _gconf_cleaner_model_iter_nth_child(tree_model, iter, NULL,
+						   gtk_tree_path_get_indices(path)[0]);
+}
+
+static GtkTreePath *
+_gconf_cleaner_model_get_path(GtkTreeModel *tree_model,
+			      GtkTreeIter  *iter)
+{
+	GtkTreePath *path;
+
+	g_return_val_if_fail (iter->stamp == GCLEANER_MODEL (tree_model)->stamp, NULL);
+
+	path = gtk_tree_path_new();
+	gtk_tree_path_append_index(path, GPOINTER_TO_UINT (iter->user_data));
+
+	return path;
+}
+
+static void
+_gconf_cleaner_model_get_value(GtkTreeModel *tree_model,
+			       GtkTreeIter  *iter,
+			       gint          column,
+			       GValue       *value)
+{
+	GConfCleanerModel *model = GCLEANER_MODEL (tree_model);
+	guint index = GPOINTER_TO_UINT (iter->user_data);
+	GConfCleanerModelRow *row;
+
+	g_return_if_fail (iter->stamp == model->stamp);
+	g_return_if_fail (index < model->n_rows);
+
+	switch (column) {
+	    case GCLEANER_MODEL_COLUMN_ACTIVE:
+		    g_value_init(value, G_TYPE_BOOLEAN);
+		    g_value_set_boolean(value, gconf_cleaner_model_get_active(model, index));
+		    break;
+	    case GCLEANER_MODEL_COLUMN_KEY:
+		    row = _gconf_cleaner_model_get_row(model, index);
+		    g_value_init(value, G_TYPE_STRING);
+		    g_value_set_string(value, row->key);
+		    break;
+	    case GCLEANER_MODEL_COLUMN_VALUE:
+		    row = _gconf_cleaner_model_get_row(model, index);
+		    g_value_init(value, G_TYPE_STRING);
+		    g_value_set_string(value, row->value);
+		    break;
+	    default:
+		    g_warning("Invalid column %d", column);
+		    break;
+	}
+}
+
+static gboolean
+_gconf_cleaner_model_iter_next(GtkTreeModel *tree_model,
+			       GtkTreeIter  *iter)
+{
+	GConfCleanerModel *model = GCLEANER_MODEL (tree_model);
+	guint index = GPOINTER_TO_UINT (iter->user_data) + 1;
+
+	if (index >= model->n_rows)
+		return FALSE;
+	iter->user_data = GUINT_TO_POINTER (index);
+
+	return TRUE;
+}
+
+static gboolean
+_gconf_cleaner_model_iter_children(GtkTreeModel *tree_model,
+				   GtkTreeIter  *iter,
+				   GtkTreeIter  *parent)
+{
+	return _gconf_cleaner_model_iter_nth_child(tree_model, iter, parent, 0);
+}
+
+static gboolean
+_gconf_cleaner_model_iter_has_child(GtkTreeModel *tree_model,
+				    GtkTreeIter  *iter)
+{
+	return FALSE;
+}
+
+static gint
+_gconf_cleaner_model_iter_n_children(GtkTreeModel *tree_model,
+				     GtkTreeIter  *iter)
+{
+	if (iter != NULL)
+		return 0;
+
+	return GCLEANER_MODEL (tree_model)->n_rows;
+}
+
+static gboolean
+_gconf_cleaner_model_iter_parent(GtkTreeModel *tree_model,
+				 GtkTreeIter  *iter,
+				 GtkTreeIter  *child)
+{
+	return FALSE;
+}
+
+static void
+_gconf_cleaner_model_tree_model_init(GtkTreeModelIface *iface)
+{
+	iface->get_flags = _gconf_cleaner_model_get_flags;
+	iface->get_n_columns = _gconf_cleaner_model_get_n_columns;
+	iface->get_column_type = _gconf_cleaner_model_get_column_type;
+	iface->get_iter = _gconf_cleaner_model_get_iter;
+	iface->get_path = _gconf_cleaner_model_get_path;
+	iface->get_value = _gconf_cleaner_model_get_value;
+	iface->iter_next = _gconf_cleaner_model_iter_next;
+	iface->iter_children = _gconf_cleaner_model_iter_children;
+	iface->iter_has_child = _gconf_cleaner_model_iter_has_child;
+	iface->iter_n_children = _gconf_cleaner_model_iter_n_children;
+	iface->iter_nth_child = _gconf_cleaner_model_iter_nth_child;
+	iface->iter_parent = _gconf_cleaner_model_iter_parent;
+}
+
+static void
+gconf_cleaner_model_class_init(GConfCleanerModelClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = _gconf_cleaner_model_finalize;
+}
+
+static void
+gconf_cleaner_model_init(GConfCleanerModel *model)
+{
+	model->stamp = g_random_int();
+	model->rows = g_new0(GConfCleanerModelRow, GCLEANER_MODEL_N_CACHED_ROWS);
+}
+
+/*
+ * Public Functions
+ */
+/*
+ * create the model showing the pairs in @result, which are all checked.
+ * @result must not be changed while the model is alive.
+ */
+GtkTreeModel *
+gconf_cleaner_model_new(const GConfCleanerResult *result)
+{
+	GConfCleanerModel *model;
+
+	g_return_val_if_fail (result != NULL, NULL);
+
+	model = g_object_new(GCLEANER_TYPE_MODEL, NULL);
+	model->result = result;
+	model->n_rows = gconf_cleaner_result_n_pairs(result);
+	model->active = g_new(guint32, (model->n_rows + 31) / 32);
+	memset(model->active, 0xff, sizeof (guint32) * ((model->n_rows + 31) / 32));
+	model->n_active = model->n_rows;
+
+	return GTK_TREE_MODEL (model);
+}
+
+guint
+gconf_cleaner_model_n_rows(GConfCleanerModel *model)
+{
+	g_return_val_if_fail (GCLEANER_IS_MODEL (model), 0);
+
+	return model->n_rows;
+}
+
+guint
+gconf_cleaner_model_n_active(GConfCleanerModel *model)
+{
+	g_return_val_if_fail (GCLEANER_IS_MODEL (model), 0);
+
+	return model->n_active;
+}
+
+gboolean
+gconf_cleaner_model_get_active(GConfCleanerModel *model,
+			       guint              index)
+{
+	g_return_val_if_fail (GCLEANER_IS_MODEL (model), FALSE);
+	g_return_val_if_fail (index < model->n_rows, FALSE);
+
+	return (model->active[index / 32] & (1U << (index % 32))) != 0;
+}
+
+void
+gconf_cleaner_model_set_active(GConfCleanerModel *model,
+			       guint              index,
+			       gboolean           flag)
+{
+	GtkTreePath *path;
+	GtkTreeIter iter;
+
+	g_return_if_fail (GCLEANER_IS_MODEL (model));
+	g_return_if_fail (index < model->n_rows);
+
+	if (gconf_cleaner_model_get_active(model, index) == (flag != FALSE))
+		return;
+	model->active[index / 32] ^= 1U << (index % 32);
+	if (flag)
+		model->n_active++;
+	else
+		model->n_active--;
+
+	path = gtk_tree_path_new();
+	gtk_tree_path_append_index(path, index);
+	iter.stamp = model->stamp;
+	iter.user_data = GUINT_TO_POINTER (index);
+	gtk_tree_model_row_changed(GTK_TREE_MODEL (model), path, &iter);
+	gtk_tree_path_free(path);
+}
+
+/*
+ * flip the check state of the row at @path.  returns the new state.
+ */
+gboolean
+gconf_cleaner_model_toggle(GConfCleanerModel *model,
+			   GtkTreePath       *path)
+{
+	GtkTreeIter iter;
+	guint index;
+	gboolean flag;
+
+	g_return_val_if_fail (GCLEANER_IS_MODEL (model), FALSE);
+	g_return_val_if_fail (path != NULL, FALSE);
+
+	if (!_gconf_cleaner_model_get_iter(GTK_TREE_MODEL (model), &iter, path))
+		return FALSE;
+	index = GPOINTER_TO_UINT (iter.user_data);
+	flag = !gconf_cleaner_model_get_active(model, index);
+	gconf_cleaner_model_set_active(model, index, flag);
+
+	return flag;
+}
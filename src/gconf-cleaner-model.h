@@ -0,0 +1,76 @@
+/* 
+ * gconf-cleaner-model.h
+ * Copyright (C) 2007 Akira TAGOH
+ * 
+ * Authors:
+ *   Akira TAGOH  <akira@tagoh.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef __GCONF_CLEANER_MODEL_H__
+#define __GCONF_CLEANER_MODEL_H__
+
+#include <gtk/gtk.h>
+#include "gconf-cleaner.h"
+
+G_BEGIN_DECLS
+
+#define GCLEANER_TYPE_MODEL		(gconf_cleaner_model_get_type())
+#define GCLEANER_MODEL(_o_)		(G_TYPE_CHECK_INSTANCE_CAST ((_o_), GCLEANER_TYPE_MODEL, GConfCleanerModel))
+#define GCLEANER_MODEL_CLASS(_c_)	(G_TYPE_CHECK_CLASS_CAST ((_c_), GCLEANER_TYPE_MODEL, GConfCleanerModelClass))
+#define GCLEANER_IS_MODEL(_o_)		(G_TYPE_CHECK_INSTANCE_TYPE ((_o_), GCLEANER_TYPE_MODEL))
+
+enum {
+	GCLEANER_MODEL_COLUMN_ACTIVE,
+	GCLEANER_MODEL_COLUMN_KEY,
+	GCLEANER_MODEL_COLUMN_VALUE,
+	GCLEANER_MODEL_N_COLUMNS
+};
+
+typedef struct _GConfCleanerModel      GConfCleanerModel;
+typedef struct _GConfCleanerModelClass GConfCleanerModelClass;
+typedef struct _GConfCleanerModelRow   GConfCleanerModelRow;
+
+struct _GConfCleanerModel {
+	GObject                   parent_instance;
+
+	const GConfCleanerResult *result;
+	gint                      stamp;
+	guint                     n_rows;
+	guint32                  *active;	/* a bit per row */
+	guint                     n_active;
+	GConfCleanerModelRow     *rows;		/* the strings rendered lately */
+};
+struct _GConfCleanerModelClass {
+	GObjectClass parent_class;
+};
+
+
+GType         gconf_cleaner_model_get_type  (void) G_GNUC_CONST;
+GtkTreeModel *gconf_cleaner_model_new       (const GConfCleanerResult *result);
+guint         gconf_cleaner_model_n_rows    (GConfCleanerModel        *model);
+guint         gconf_cleaner_model_n_active  (GConfCleanerModel        *model);
+gboolean      gconf_cleaner_model_get_active(GConfCleanerModel        *model,
+					     guint                     index);
+void          gconf_cleaner_model_set_active(GConfCleanerModel        *model,
+					     guint                     index,
+					     gboolean                  flag);
+gboolean      gconf_cleaner_model_toggle    (GConfCleanerModel        *model,
+					     GtkTreePath              *path);
+
+G_END_DECLS
+
+#endif /* __GCONF_CLEANER_MODEL_H__ */
@@ -0,0 +1,2121 @@
+/* 
+ * gconf-cleaner-xml.c
+ * Copyright (C) 2007 Akira TAGOH
+ * 
+ * Authors:
+ *   Akira TAGOH  <akira@tagoh.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <gconf/gconf.h>
+#include "gconf-cleaner-xml.h"
+
+#ifndef GCLEANER_GCONF_SYSCONFDIR
+#define GCLEANER_GCONF_SYSCONFDIR	"/etc/gconf"
+#endif
+
+#define GCLEANER_XML_DIR_FILE	"%gconf.xml"
+#define GCLEANER_XML_TREE_FILE	"%gconf-tree.xml"
+
+
+typedef struct _GConfCleanerXmlEntry {
+	gchar      *name;
+	gchar      *schema_name;
+	GConfValue *value;
+	gboolean    is_schema;
+} GConfCleanerXmlEntry;
+typedef struct _GConfCleanerXmlDir {
+	GSList *subdirs;
+	GSList *entries;
+} GConfCleanerXmlDir;
+typedef struct _GConfCleanerXmlRoot {
+	gchar      *path;
+	gboolean    writable;
+	GHashTable *tree;	/* only for %gconf-tree.xml */
+	struct stat tree_stat;
+} GConfCleanerXmlRoot;
+typedef struct _GConfCleanerXmlFrame {
+	GConfValue *value;
+	GSList     *items;
+} GConfCleanerXmlFrame;
+typedef enum {
+	GCLEANER_XML_TOKEN_TEXT,
+	GCLEANER_XML_TOKEN_START,	/* <foo ...> */
+	GCLEANER_XML_TOKEN_EMPTY,	/* <foo .../> */
+	GCLEANER_XML_TOKEN_END,		/* </foo> */
+	GCLEANER_XML_TOKEN_CDATA,
+	GCLEANER_XML_TOKEN_COMMENT,
+	GCLEANER_XML_TOKEN_DECL,	/* <?xml ...?> and <!DOCTYPE ...> */
+	GCLEANER_XML_TOKEN_ERROR
+} GConfCleanerXmlTokenType;
+typedef struct _GConfCleanerXmlToken {
+	GConfCleanerXmlTokenType  type;
+	const gchar              *start;
+	const gchar              *end;
+	const gchar              *name;
+	gsize                     name_len;
+	const gchar              *attrs;	/* up to attrs_end, without "/>" */
+	const gchar              *attrs_end;
+} GConfCleanerXmlToken;
+/* a range of the text to be cut out */
+typedef struct _GConfCleanerXmlCut {
+	gsize  start;
+	gsize  end;
+	gchar *key;
+} GConfCleanerXmlCut;
+typedef struct _GConfCleanerXmlDirFrame {
+	gsize    start;
+	gsize    path_len;	/* to go back to the parent */
+	gboolean is_dir;
+	gboolean has_content;
+} GConfCleanerXmlDirFrame;
+typedef gboolean (* GConfCleanerXmlFindFunc) (const gchar  *contents,
+					      gsize         len,
+					      const gchar  *dir,
+					      GHashTable   *names,
+					      GArray       *cuts,
+					      GError      **error);
+typedef struct _GConfCleanerXmlCompactFrame {
+	GString  *out;
+	gboolean  is_dir;	/* written to its own buffer until it's known not empty */
+	gboolean  is_text;
+	gboolean  has_content;
+	gboolean  drop;
+} GConfCleanerXmlCompactFrame;
+/* a file written to the temporary one, waiting to replace the original */
+typedef struct _GConfCleanerXmlRewrite {
+	GConfCleanerXmlRoot *root;
+	gchar               *filename;
+	gchar               *tmpname;
+	GArray              *cuts;
+	GHashTable          *tree;	/* read from tmpname when compacted */
+} GConfCleanerXmlRewrite;
+typedef struct _GConfCleanerXmlParser {
+	GHashTable           *tree;
+	GString              *path;
+	GSList               *dirs;
+	GConfCleanerXmlDir   *dir;
+	GConfCleanerXmlEntry *entry;
+	GSList               *frames;
+	GString              *text;
+	gint                  skip;
+	gboolean              in_string;
+} GConfCleanerXmlParser;
+
+struct _GConfCleanerXmlSource {
+	GPtrArray *roots;
+};
+
+/*
+ * Private Functions
+ */
+static guint64
+_gconf_cleaner_xml_stat_mtime(const struct stat *st)
+{
+	guint64 retval = (guint64)st->st_mtime * 1000000000;
+
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	retval += st->st_mtim.tv_nsec;
+#endif
+
+	return retval;
+}
+
+static void
+_gconf_cleaner_xml_entry_free(GConfCleanerXmlEntry *entry)
+{
+	g_free(entry->name);
+	g_free(entry->schema_name);
+	if (entry->value)
+		gconf_value_free(entry->value);
+	g_free(entry);
+}
+
+static void
+_gconf_cleaner_xml_dir_free(GConfCleanerXmlDir *dir)
+{
+	GSList *l;
+
+	for (l = dir->subdirs; l != NULL; l = g_slist_next(l))
+		g_free(l->data);
+	g_slist_free(dir->subdirs);
+	for (l = dir->entries; l != NULL; l = g_slist_next(l))
+		_gconf_cleaner_xml_entry_free(l->data);
+	g_slist_free(dir->entries);
+	g_free(dir);
+}
+
+static void
+_gconf_cleaner_xml_root_free(GConfCleanerXmlRoot *root)
+{
+	g_free(root->path);
+	if (root->tree)
+		g_hash_table_destroy(root->tree);
+	g_free(root);
+}
+
+static const gchar *
+_gconf_cleaner_xml_lookup_attribute(const gchar  *name,
+				    const gchar **attribute_names,
+				    const gchar **attribute_values)
+{
+	gint i;
+
+	for (i = 0; attribute_names[i] != NULL; i++) {
+		if (strcmp(attribute_names[i], name) == 0)
+			return attribute_values[i];
+	}
+
+	return NULL;
+}
+
+static GConfValue *
+_gconf_cleaner_xml_value_new(const gchar  *type,
+			     const gchar **attribute_names,
+			     const gchar **attribute_values)
+{
+	GConfValueType vtype;
+	GConfValue *retval;
+	const gchar *v;
+
+	if (type == NULL)
+		return NULL;
+	vtype = gconf_value_type_from_string(type);
+	v = _gconf_cleaner_xml_lookup_attribute("value", attribute_names, attribute_values);
+	switch (vtype) {
+	    case GCONF_VALUE_INT:
+		    if (v == NULL)
+			    return NULL;
+		    retval = gconf_value_new(vtype);
+		    gconf_value_set_int(retval, strtol(v, NULL, 10));
+		    break;
+	    case GCONF_VALUE_FLOAT:
+		    if (v == NULL)
+			    return NULL;
+		    retval = gconf_value_new(vtype);
+		    gconf_value_set_float(retval, g_ascii_strtod(v, NULL));
+		    break;
+	    case GCONF_VALUE_BOOL:
+		    if (v == NULL)
+			    return NULL;
+		    retval = gconf_value_new(vtype);
+		    gconf_value_set_bool(retval, strcmp(v, "true") == 0);
+		    break;
+	    case GCONF_VALUE_STRING:
+		    /* the content comes from <stringvalue> */
+		    retval = gconf_value_new(vtype);
+		    gconf_value_set_string(retval, "");
+		    break;
+	    case GCONF_VALUE_LIST:
+		    v = _gconf_cleaner_xml_lookup_attribute("ltype", attribute_names, attribute_values);
+		    if (v == NULL)
+			    return NULL;
+		    retval = gconf_value_new(vtype);
+		    gconf_value_set_list_type(retval, gconf_value_type_from_string(v));
+		    break;
+	    case GCONF_VALUE_PAIR:
+		    retval = gconf_value_new(vtype);
+		    break;
+	    case GCONF_VALUE_SCHEMA:
+		    /* the schema body is never used for cleaning */
+		    retval = gconf_value_new(vtype);
+		    gconf_value_set_schema_nocopy(retval, gconf_schema_new());
+		    break;
+	    default:
+		    retval = NULL;
+		    break;
+	}
+
+	return retval;
+}
+
+static void
+_gconf_cleaner_xml_push_frame(GConfCleanerXmlParser *parser,
+			      GConfValue            *value)
+{
+	GConfCleanerXmlFrame *frame = g_new0(GConfCleanerXmlFrame, 1);
+
+	frame->value = value;
+	parser->frames = g_slist_prepend(parser->frames, frame);
+}
+
+static void
+_gconf_cleaner_xml_pop_frame(GConfCleanerXmlParser *parser,
+			     const gchar           *element_name)
+{
+	GConfCleanerXmlFrame *frame, *parent;
+	GConfValue *value;
+
+	if (parser->frames == NULL)
+		return;
+	frame = parser->frames->data;
+	parser->frames = g_slist_delete_link(parser->frames, parser->frames);
+	value = frame->value;
+	if (value && value->type == GCONF_VALUE_LIST) {
+		gconf_value_set_list_nocopy(value, g_slist_reverse(frame->items));
+	} else {
+		GSList *l;
+
+		for (l = frame->items; l != NULL; l = g_slist_next(l))
+			gconf_value_free(l->data);
+		g_slist_free(frame->items);
+	}
+	g_free(frame);
+
+	if (parser->frames == NULL) {
+		if (parser->entry)
+			parser->entry->value = value;
+		else if (value)
+			gconf_value_free(value);
+		return;
+	}
+	parent = parser->frames->data;
+	if (value == NULL || parent->value == NULL) {
+		/* drop the broken value as a whole */
+		if (value)
+			gconf_value_free(value);
+		if (parent->value) {
+			gconf_value_free(parent->value);
+			parent->value = NULL;
+		}
+	} else if (parent->value->type == GCONF_VALUE_LIST) {
+		parent->items = g_slist_prepend(parent->items, value);
+	} else if (parent->value->type == GCONF_VALUE_PAIR &&
+		   strcmp(element_name, "car") == 0) {
+		gconf_value_set_car_nocopy(parent->value, value);
+	} else if (parent->value->type == GCONF_VALUE_PAIR &&
+		   strcmp(element_name, "cdr") == 0) {
+		gconf_value_set_cdr_nocopy(parent->value, value);
+	} else {
+		gconf_value_free(value);
+	}
+}
+
+static void
+_gconf_cleaner_xml_start_element(GMarkupParseContext  *context,
+				 const gchar          *element_name,
+				 const gchar         **attribute_names,
+				 const gchar         **attribute_values,
+				 gpointer              user_data,
+				 GError              **error)
+{
+	GConfCleanerXmlParser *parser = user_data;
+	const gchar *name, *type;
+
+	if (parser->skip > 0 ||
+	    (parser->entry && parser->entry->is_schema)) {
+		parser->skip++;
+		return;
+	}
+	if (strcmp(element_name, "entry") == 0) {
+		name = _gconf_cleaner_xml_lookup_attribute("name", attribute_names, attribute_values);
+		type = _gconf_cleaner_xml_lookup_attribute("type", attribute_names, attribute_values);
+		if (name == NULL || parser->entry != NULL) {
+			parser->skip++;
+			return;
+		}
+		parser->entry = g_new0(GConfCleanerXmlEntry, 1);
+		parser->entry->name = g_strdup(name);
+		parser->entry->schema_name = g_strdup(_gconf_cleaner_xml_lookup_attribute("schema",
+											  attribute_names,
+											  attribute_values));
+		parser->entry->is_schema = (type && strcmp(type, "schema") == 0);
+		_gconf_cleaner_xml_push_frame(parser,
+					      _gconf_cleaner_xml_value_new(type,
+									   attribute_names,
+									   attribute_values));
+	} else if (strcmp(element_name, "li") == 0 ||
+		   strcmp(element_name, "car") == 0 ||
+		   strcmp(element_name, "cdr") == 0) {
+		if (parser->entry == NULL) {
+			parser->skip++;
+			return;
+		}
+		type = _gconf_cleaner_xml_lookup_attribute("type", attribute_names, attribute_values);
+		_gconf_cleaner_xml_push_frame(parser,
+					      _gconf_cleaner_xml_value_new(type,
+									   attribute_names,
+									   attribute_values));
+	} else if (strcmp(element_name, "stringvalue") == 0) {
+		g_string_truncate(parser->text, 0);
+		parser->in_string = TRUE;
+	} else if (strcmp(element_name, "dir") == 0) {
+		GConfCleanerXmlDir *dir;
+
+		name = _gconf_cleaner_xml_lookup_attribute("name", attribute_names, attribute_values);
+		if (name == NULL || parser->tree == NULL || parser->entry != NULL) {
+			parser->skip++;
+			return;
+		}
+		parser->dir->subdirs = g_slist_prepend(parser->dir->subdirs, g_strdup(name));
+		if (parser->path->len > 1)
+			g_string_append_c(parser->path, '/');
+		g_string_append(parser->path, name);
+		dir = g_new0(GConfCleanerXmlDir, 1);
+		g_hash_table_replace(parser->tree, g_strdup(parser->path->str), dir);
+		parser->dirs = g_slist_prepend(parser->dirs, parser->dir);
+		parser->dir = dir;
+	} else if (strcmp(element_name, "gconf") != 0) {
+		/* <local_schema>, <default>, <longdesc> and unknown elements */
+		parser->skip++;
+	}
+}
+
+static void
+_gconf_cleaner_xml_end_element(GMarkupParseContext  *context,
+			       const gchar          *element_name,
+			       gpointer              user_data,
+			       GError              **error)
+{
+	GConfCleanerXmlParser *parser = user_data;
+
+	if (parser->skip > 0) {
+		parser->skip--;
+		return;
+	}
+	if (strcmp(element_name, "entry") == 0) {
+		_gconf_cleaner_xml_pop_frame(parser, element_name);
+		parser->dir->entries = g_slist_prepend(parser->dir->entries, parser->entry);
+		parser->entry = NULL;
+	} else if (strcmp(element_name, "li") == 0 ||
+		   strcmp(element_name, "car") == 0 ||
+		   strcmp(element_name, "cdr") == 0) {
+		_gconf_cleaner_xml_pop_frame(parser, element_name);
+	} else if (strcmp(element_name, "stringvalue") == 0) {
+		GConfCleanerXmlFrame *frame = parser->frames ? parser->frames->data : NULL;
+
+		if (frame && frame->value && frame->value->type == GCONF_VALUE_STRING)
+			gconf_value_set_string(frame->value, parser->text->str);
+		parser->in_string = FALSE;
+	} else if (strcmp(element_name, "dir") == 0) {
+		gchar *p = strrchr(parser->path->str, '/');
+
+		g_string_truncate(parser->path, p == parser->path->str ? 1 : p - parser->path->str);
+		parser->dir->entries = g_slist_reverse(parser->dir->entries);
+		parser->dir->subdirs = g_slist_reverse(parser->dir->subdirs);
+		parser->dir = parser->dirs->data;
+		parser->dirs = g_slist_delete_link(parser->dirs, parser->dirs);
+	}
+}
+
+static void
+_gconf_cleaner_xml_text(GMarkupParseContext  *context,
+			const gchar          *text,
+			gsize                 text_len,
+			gpointer              user_data,
+			GError              **error)
+{
+	GConfCleanerXmlParser *parser = user_data;
+
+	if (parser->skip == 0 && parser->in_string)
+		g_string_append_len(parser->text, text, text_len);
+}
+
+static const GMarkupParser gconf_cleaner_xml_parser = {
+	_gconf_cleaner_xml_start_element,
+	_gconf_cleaner_xml_end_element,
+	_gconf_cleaner_xml_text,
+	NULL,
+	NULL
+};
+
+/*
+ * parse a file into @dir.  if @tree isn't NULL, <dir> elements of
+ * the merged tree are stored into it as well.
+ */
+static gboolean
+_gconf_cleaner_xml_parse_file(const gchar         *filename,
+			      GConfCleanerXmlDir  *dir,
+			      GHashTable          *tree,
+			      GError             **error)
+{
+	GMarkupParseContext *context;
+	GConfCleanerXmlParser parser;
+	gchar buffer[65536];
+	gboolean retval = TRUE;
+	gsize len;
+	FILE *fp;
+
+	if ((fp = fopen(filename, "rb")) == NULL) {
+		g_set_error(error, 0, 0,
+			    _("Failed during opening %s"),
+			    filename);
+		return FALSE;
+	}
+	memset(&parser, 0, sizeof (GConfCleanerXmlParser));
+	parser.tree = tree;
+	parser.path = g_string_new("/");
+	parser.dir = dir;
+	parser.text = g_string_new(NULL);
+	context = g_markup_parse_context_new(&gconf_cleaner_xml_parser, 0, &parser, NULL);
+	while ((len = fread(buffer, 1, sizeof (buffer), fp)) > 0) {
+		if (!g_markup_parse_context_parse(context, buffer, len, error)) {
+			retval = FALSE;
+			break;
+		}
+	}
+	if (retval)
+		retval = g_markup_parse_context_end_parse(context, error);
+	g_markup_parse_context_free(context);
+	fclose(fp);
+
+	/* clean up whatever is left by the broken document */
+	while (parser.frames)
+		_gconf_cleaner_xml_pop_frame(&parser, "entry");
+	if (parser.entry)
+		_gconf_cleaner_xml_entry_free(parser.entry);
+	if (parser.dirs) {
+		parser.dir = g_slist_last(parser.dirs)->data;
+		g_slist_free(parser.dirs);
+	}
+	parser.dir->entries = g_slist_reverse(parser.dir->entries);
+	parser.dir->subdirs = g_slist_reverse(parser.dir->subdirs);
+	g_string_free(parser.path, TRUE);
+	g_string_free(parser.text, TRUE);
+
+	return retval;
+}
+
+/* parse %gconf-tree.xml into the table of the directories */
+static GHashTable *
+_gconf_cleaner_xml_parse_tree(const gchar  *filename,
+			      GError      **error)
+{
+	GHashTable *retval;
+	GConfCleanerXmlDir *dir = g_new0(GConfCleanerXmlDir, 1);
+
+	retval = g_hash_table_new_full(g_str_hash, g_str_equal,
+				       g_free,
+				       (GDestroyNotify)_gconf_cleaner_xml_dir_free);
+	g_hash_table_insert(retval, g_strdup("/"), dir);
+	if (!_gconf_cleaner_xml_parse_file(filename, dir, retval, error)) {
+		g_hash_table_destroy(retval);
+		return NULL;
+	}
+
+	return retval;
+}
+
+/* expand $(HOME), $(USER) and $(ENV_FOO) in the address */
+static gchar *
+_gconf_cleaner_xml_expand(const gchar *str)
+{
+	GString *retval = g_string_new(NULL);
+	const gchar *p, *end;
+
+	for (p = str; *p; p++) {
+		if (p[0] == '$' && p[1] == '(' && (end = strchr(p, ')')) != NULL) {
+			gchar *var = g_strndup(p + 2, end - p - 2);
+			const gchar *val = NULL;
+
+			if (strcmp(var, "HOME") == 0)
+				val = g_get_home_dir();
+			else if (strcmp(var, "USER") == 0)
+				val = g_get_user_name();
+			else if (strncmp(var, "ENV_", 4) == 0)
+				val = g_getenv(var + 4);
+			g_string_append(retval, val ? val : "");
+			g_free(var);
+			p = end;
+		} else {
+			g_string_append_c(retval, *p);
+		}
+	}
+
+	return g_string_free(retval, FALSE);
+}
+
+/* read the addresses from the GConf path file like gconfd does */
+static void
+_gconf_cleaner_xml_read_path(const gchar *filename,
+			     GPtrArray   *addresses,
+			     gint         depth)
+{
+	gchar *contents, **lines;
+	gint i;
+
+	if (depth > 8 ||
+	    !g_file_get_contents(filename, &contents, NULL, NULL))
+		return;
+	lines = g_strsplit(contents, "\n", -1);
+	g_free(contents);
+	for (i = 0; lines[i] != NULL; i++) {
+		gchar *line = g_strstrip(lines[i]);
+
+		if (*line == 0 || *line == '#')
+			continue;
+		if (strncmp(line, "include", 7) == 0 && g_ascii_isspace(line[7])) {
+			gchar *path = g_strstrip(line + 8), *file;
+			gsize len = strlen(path);
+
+			if (len > 1 && path[0] == '"' && path[len - 1] == '"') {
+				path[len - 1] = 0;
+				path++;
+			}
+			file = _gconf_cleaner_xml_expand(path);
+			_gconf_cleaner_xml_read_path(file, addresses, depth + 1);
+			g_free(file);
+		} else {
+			g_ptr_array_add(addresses, _gconf_cleaner_xml_expand(line));
+		}
+	}
+	g_strfreev(lines);
+}
+
+static GConfCleanerXmlRoot *
+_gconf_cleaner_xml_root_new(const gchar  *address,
+			    GError      **error)
+{
+	GConfCleanerXmlRoot *retval;
+	gchar **tokens, *path, *tree_file;
+
+	tokens = g_strsplit(address, ":", 3);
+	if (g_strv_length(tokens) != 3 || strcmp(tokens[0], "xml") != 0) {
+		g_set_error(error, 0, 0,
+			    _("Unsupported configuration source `%s'"),
+			    address);
+		g_strfreev(tokens);
+		return NULL;
+	}
+	path = _gconf_cleaner_xml_expand(tokens[2]);
+	if (!g_file_test(path, G_FILE_TEST_IS_DIR)) {
+		/* gconfd just ignores it too */
+		g_strfreev(tokens);
+		g_free(path);
+		return NULL;
+	}
+
+	retval = g_new0(GConfCleanerXmlRoot, 1);
+	retval->path = path;
+	/* gconfd writes to the source without the flags if it can */
+	if (strstr(tokens[1], "readonly"))
+		retval->writable = FALSE;
+	else if (strstr(tokens[1], "readwrite"))
+		retval->writable = TRUE;
+	else
+		retval->writable = (access(path, W_OK) == 0);
+	g_strfreev(tokens);
+	tree_file = g_build_filename(path, GCLEANER_XML_TREE_FILE, NULL);
+	if (stat(tree_file, &retval->tree_stat) == 0 &&
+	    (retval->tree = _gconf_cleaner_xml_parse_tree(tree_file, error)) == NULL) {
+		_gconf_cleaner_xml_root_free(retval);
+		retval = NULL;
+	}
+	g_free(tree_file);
+
+	return retval;
+}
+
+/* returns the entries of @dir in @root. *@is_copy tells whether it has to be freed */
+static GConfCleanerXmlDir *
+_gconf_cleaner_xml_root_get_dir(GConfCleanerXmlRoot  *root,
+				const gchar          *dir,
+				gboolean             *is_copy,
+				GError              **error)
+{
+	GConfCleanerXmlDir *retval;
+	gchar *filename;
+
+	*is_copy = FALSE;
+	if (root->tree)
+		return g_hash_table_lookup(root->tree, dir);
+
+	filename = g_build_filename(root->path, dir, GCLEANER_XML_DIR_FILE, NULL);
+	if (!g_file_test(filename, G_FILE_TEST_EXISTS)) {
+		g_free(filename);
+		return NULL;
+	}
+	retval = g_new0(GConfCleanerXmlDir, 1);
+	if (!_gconf_cleaner_xml_parse_file(filename, retval, NULL, error)) {
+		_gconf_cleaner_xml_dir_free(retval);
+		retval = NULL;
+	} else {
+		*is_copy = TRUE;
+	}
+	g_free(filename);
+
+	return retval;
+}
+
+static GSList *
+_gconf_cleaner_xml_root_all_dirs(GConfCleanerXmlRoot  *root,
+				 const gchar          *dir,
+				 GError              **error)
+{
+	GSList *retval = NULL, *l;
+	gchar *path, *file;
+	const gchar *name;
+	GDir *d;
+
+	if (root->tree) {
+		GConfCleanerXmlDir *node = g_hash_table_lookup(root->tree, dir);
+
+		if (node) {
+			for (l = node->subdirs; l != NULL; l = g_slist_next(l))
+				retval = g_slist_prepend(retval, g_strdup(l->data));
+		}
+		return retval;
+	}
+
+	path = g_build_filename(root->path, dir, NULL);
+	if ((d = g_dir_open(path, 0, NULL)) == NULL) {
+		g_free(path);
+		return NULL;
+	}
+	while ((name = g_dir_read_name(d)) != NULL) {
+		if (name[0] == '.' || name[0] == '%')
+			continue;
+		file = g_build_filename(path, name, GCLEANER_XML_DIR_FILE, NULL);
+		if (g_file_test(file, G_FILE_TEST_EXISTS))
+			retval = g_slist_prepend(retval, g_strdup(name));
+		g_free(file);
+	}
+	g_dir_close(d);
+	g_free(path);
+
+	return retval;
+}
+
+static gchar *
+_gconf_cleaner_xml_concat(const gchar *dir,
+			  const gchar *name)
+{
+	if (dir[0] == '/' && dir[1] == 0)
+		return g_strconcat("/", name, NULL);
+
+	return g_strconcat(dir, "/", name, NULL);
+}
+
+/* the attribute values are short and rarely escaped */
+static gchar *
+_gconf_cleaner_xml_unescape(const gchar *str,
+			    gsize        len)
+{
+	static const struct {
+		const gchar *name;
+		gchar        c;
+	} entities[] = {
+		{"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'},
+		{"&quot;", '"'}, {"&apos;", '\''}
+	};
+	GString *retval = g_string_sized_new(len);
+	const gchar *p, *end = str + len;
+	guint i;
+
+	for (p = str; p < end; p++) {
+		if (*p == '&') {
+			for (i = 0; i < G_N_ELEMENTS (entities); i++) {
+				gsize l = strlen(entities[i].name);
+
+				if ((gsize)(end - p) >= l && strncmp(p, entities[i].name, l) == 0) {
+					g_string_append_c(retval, entities[i].c);
+					p += l - 1;
+					break;
+				}
+			}
+			if (i < G_N_ELEMENTS (entities))
+				continue;
+			if (p[1] == '#') {
+				gchar *e;
+				gunichar c = p[2] == 'x' ? strtoul(p + 3, &e, 16) : strtoul(p + 2, &e, 10);
+
+				if (e < end && *e == ';') {
+					g_string_append_unichar(retval, c);
+					p = e;
+					continue;
+				}
+			}
+		}
+		g_string_append_c(retval, *p);
+	}
+
+	return g_string_free(retval, FALSE);
+}
+
+/* skip to the end of @marker. returns NULL if it's not found */
+static const gchar *
+_gconf_cleaner_xml_skip_to(const gchar *p,
+			   const gchar *end,
+			   const gchar *marker)
+{
+	gsize len = strlen(marker);
+
+	for (; p + len <= end; p++) {
+		if (strncmp(p, marker, len) == 0)
+			return p + len;
+	}
+
+	return NULL;
+}
+
+/*
+ * read the next token at *@p.  only the tags are looked into, so that
+ * the text can be copied byte for byte.  returns FALSE at the end of the
+ * document.
+ */
+static gboolean
+_gconf_cleaner_xml_next_token(const gchar        **p,
+			      const gchar         *end,
+			      GConfCleanerXmlToken *token)
+{
+	const gchar *s = *p, *q;
+
+	if (s >= end)
+		return FALSE;
+	memset(token, 0, sizeof (GConfCleanerXmlToken));
+	token->start = s;
+	if (*s != '<') {
+		token->type = GCLEANER_XML_TOKEN_TEXT;
+		q = memchr(s, '<', end - s);
+		token->end = *p = q ? q : end;
+		return TRUE;
+	}
+	if ((gsize)(end - s) >= 4 && strncmp(s, "<!--", 4) == 0) {
+		token->type = GCLEANER_XML_TOKEN_COMMENT;
+		q = _gconf_cleaner_xml_skip_to(s + 4, end, "-->");
+	} else if ((gsize)(end - s) >= 9 && strncmp(s, "<![CDATA[", 9) == 0) {
+		token->type = GCLEANER_XML_TOKEN_CDATA;
+		q = _gconf_cleaner_xml_skip_to(s + 9, end, "]]>");
+	} else if (s + 1 < end && (s[1] == '?' || s[1] == '!')) {
+		token->type = GCLEANER_XML_TOKEN_DECL;
+		q = _gconf_cleaner_xml_skip_to(s + 2, end, ">");
+	} else {
+		q = s + 1;
+		token->type = GCLEANER_XML_TOKEN_START;
+		if (q < end && *q == '/') {
+			token->type = GCLEANER_XML_TOKEN_END;
+			q++;
+		}
+		token->name = q;
+		while (q < end && !g_ascii_isspace(*q) && *q != '>' && *q != '/')
+			q++;
+		token->name_len = q - token->name;
+		token->attrs = q;
+		while (q < end && *q != '>') {
+			if (*q == '"' || *q == '\'') {
+				const gchar *e = memchr(q + 1, *q, end - q - 1);
+
+				if (e == NULL)
+					break;
+				q = e;
+			}
+			q++;
+		}
+		token->attrs_end = q;
+		if (q < end) {
+			if (q[-1] == '/' && token->type == GCLEANER_XML_TOKEN_START) {
+				token->type = GCLEANER_XML_TOKEN_EMPTY;
+				token->attrs_end--;
+			}
+			q++;
+		} else {
+			q = NULL;
+		}
+		if (token->name_len == 0)
+			q = NULL;
+	}
+	if (q == NULL) {
+		token->type = GCLEANER_XML_TOKEN_ERROR;
+		token->end = *p = end;
+	} else {
+		token->end = *p = q;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+_gconf_cleaner_xml_token_is(const GConfCleanerXmlToken *token,
+			    const gchar                *name)
+{
+	return token->name_len == strlen(name) &&
+		strncmp(token->name, name, token->name_len) == 0;
+}
+
+/*
+ * read the next attribute of the tag at *@p.  @value points to the text
+ * between the quotes as it is.
+ */
+static gboolean
+_gconf_cleaner_xml_next_attribute(const gchar **p,
+				  const gchar  *end,
+				  const gchar **name,
+				  gsize        *name_len,
+				  const gchar **value,
+				  gsize        *value_len,
+				  gchar        *quote)
+{
+	const gchar *s = *p, *e;
+
+	while (s < end && g_ascii_isspace(*s))
+		s++;
+	*name = s;
+	while (s < end && *s != '=' && !g_ascii_isspace(*s))
+		s++;
+	*name_len = s - *name;
+	while (s < end && (*s == '=' || g_ascii_isspace(*s)))
+		s++;
+	if (*name_len == 0 || s >= end || (*s != '"' && *s != '\'') ||
+	    (e = memchr(s + 1, *s, end - s - 1)) == NULL)
+		return FALSE;
+	*quote = *s;
+	*value = s + 1;
+	*value_len = e - s - 1;
+	*p = e + 1;
+
+	return TRUE;
+}
+
+/* returns the unescaped value of the attribute @name of @token */
+static gchar *
+_gconf_cleaner_xml_token_get_attribute(const GConfCleanerXmlToken *token,
+				       const gchar                *name)
+{
+	const gchar *p = token->attrs, *n, *v;
+	gsize n_len, v_len;
+	gchar quote;
+
+	while (_gconf_cleaner_xml_next_attribute(&p, token->attrs_end,
+						 &n, &n_len, &v, &v_len, &quote)) {
+		if (n_len == strlen(name) && strncmp(n, name, n_len) == 0)
+			return _gconf_cleaner_xml_unescape(v, v_len);
+	}
+
+	return NULL;
+}
+
+static void
+_gconf_cleaner_xml_pop_path(GString *path,
+			    GArray  *path_lens)
+{
+	if (path_lens->len == 0)
+		return;
+	g_string_truncate(path, g_array_index(path_lens, gsize, path_lens->len - 1));
+	g_array_set_size(path_lens, path_lens->len - 1);
+}
+
+/* end @cut at @end, or take the whole lines if nothing else is on them */
+static void
+_gconf_cleaner_xml_cut_lines(const gchar        *contents,
+			     gsize               len,
+			     GConfCleanerXmlCut *cut,
+			     const gchar        *end)
+{
+	const gchar *s = contents + cut->start, *e = end;
+
+	while (s > contents && (s[-1] == ' ' || s[-1] == '\t'))
+		s--;
+	while (e < contents + len && (*e == ' ' || *e == '\t'))
+		e++;
+	if ((s == contents || s[-1] == '\n') && (e == contents + len || *e == '\n')) {
+		cut->start = s - contents;
+		cut->end = e < contents + len ? e - contents + 1 : len;
+	} else {
+		cut->end = end - contents;
+	}
+}
+
+/*
+ * find the entries in @contents which are in @keys.  @dir is the directory
+ * of %gconf.xml, or "/" for %gconf-tree.xml where the directories are
+ * followed by <dir>.  each cut covers the lines of the entry if nothing
+ * else is on them.
+ */
+static gboolean
+_gconf_cleaner_xml_find_cuts(const gchar  *contents,
+			     gsize         len,
+			     const gchar  *dir,
+			     GHashTable   *keys,
+			     GArray       *cuts,
+			     GError      **error)
+{
+	enum {
+		ELEMENT_OTHER,
+		ELEMENT_CONTAINER,	/* <gconf> or <dir> */
+		ELEMENT_ENTRY
+	};
+	const gchar *p = contents, *end = contents + len;
+	GArray *stack = g_array_new(FALSE, FALSE, sizeof (gint));
+	GArray *path_lens = g_array_new(FALSE, FALSE, sizeof (gsize));
+	GString *path = g_string_new(dir);
+	GConfCleanerXmlToken token;
+	GConfCleanerXmlCut cut;
+	gint cut_depth = -1, kind;
+	gboolean retval = TRUE, broken = FALSE;
+
+	memset(&cut, 0, sizeof (GConfCleanerXmlCut));
+	while (!broken && _gconf_cleaner_xml_next_token(&p, end, &token)) {
+		gboolean is_dir = _gconf_cleaner_xml_token_is(&token, "dir");
+
+		switch (token.type) {
+		    case GCLEANER_XML_TOKEN_ERROR:
+			    broken = TRUE;
+			    break;
+		    case GCLEANER_XML_TOKEN_START:
+		    case GCLEANER_XML_TOKEN_EMPTY:
+			    kind = _gconf_cleaner_xml_token_is(&token, "entry") ? ELEMENT_ENTRY :
+				    (is_dir || _gconf_cleaner_xml_token_is(&token, "gconf")) ? ELEMENT_CONTAINER :
+				    ELEMENT_OTHER;
+			    if (is_dir) {
+				    gchar *name = _gconf_cleaner_xml_token_get_attribute(&token, "name");
+				    gsize l = path->len;
+
+				    g_array_append_val(path_lens, l);
+				    if (path->len > 1)
+					    g_string_append_c(path, '/');
+				    g_string_append(path, name ? name : "");
+				    g_free(name);
+			    } else if (kind == ELEMENT_ENTRY && cut_depth < 0 && stack->len > 0 &&
+				       g_array_index(stack, gint, stack->len - 1) == ELEMENT_CONTAINER) {
+				    gchar *name = _gconf_cleaner_xml_token_get_attribute(&token, "name");
+				    gchar *key = NULL;
+
+				    if (name)
+					    key = path->len > 1 ?
+						    g_strconcat(path->str, "/", name, NULL) :
+						    g_strconcat("/", name, NULL);
+				    if (key && g_hash_table_lookup(keys, key)) {
+					    cut.start = token.start - contents;
+					    cut.key = key;
+					    cut_depth = stack->len;
+				    } else {
+					    g_free(key);
+				    }
+				    g_free(name);
+			    }
+			    if (token.type == GCLEANER_XML_TOKEN_START)
+				    g_array_append_val(stack, kind);
+			    else if (is_dir)
+				    _gconf_cleaner_xml_pop_path(path, path_lens);
+			    break;
+		    case GCLEANER_XML_TOKEN_END:
+			    if (stack->len == 0) {
+				    broken = TRUE;
+				    break;
+			    }
+			    g_array_set_size(stack, stack->len - 1);
+			    if (is_dir)
+				    _gconf_cleaner_xml_pop_path(path, path_lens);
+			    break;
+		    default:
+			    break;
+		}
+		if (!broken && cut_depth >= 0 && (gint)stack->len == cut_depth) {
+			_gconf_cleaner_xml_cut_lines(contents, len, &cut, token.end);
+			g_array_append_val(cuts, cut);
+			cut.key = NULL;
+			cut_depth = -1;
+		}
+	}
+	if (broken || stack->len > 0 || cut_depth >= 0) {
+		g_set_error(error, 0, 0,
+			    _("Malformed XML document"));
+		retval = FALSE;
+	}
+	g_free(cut.key);
+	g_array_free(stack, TRUE);
+	g_array_free(path_lens, TRUE);
+	g_string_free(path, TRUE);
+
+	return retval;
+}
+
+static gboolean
+_gconf_cleaner_xml_is_blank(const gchar *p,
+			    const gchar *end)
+{
+	for (; p < end; p++) {
+		if (!g_ascii_isspace(*p))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * find the <dir> elements in @contents of %gconf-tree.xml for the
+ * directories in @dirs which have nothing but whitespace, comments and
+ * the other <dir> elements to be cut in them.  the cut of a directory
+ * comes before the ones of its subdirectories it covers in @cuts.
+ */
+static gboolean
+_gconf_cleaner_xml_find_dir_cuts(const gchar  *contents,
+				 gsize         len,
+				 const gchar  *dir,
+				 GHashTable   *dirs,
+				 GArray       *cuts,
+				 GError      **error)
+{
+	const gchar *p = contents, *end = contents + len;
+	GArray *stack = g_array_new(FALSE, FALSE, sizeof (GConfCleanerXmlDirFrame));
+	GString *path = g_string_new(dir);
+	GConfCleanerXmlDirFrame frame, *parent;
+	GConfCleanerXmlToken token;
+	GConfCleanerXmlCut cut;
+	gboolean retval = TRUE, broken = FALSE;
+	guint i;
+
+	while (!broken && _gconf_cleaner_xml_next_token(&p, end, &token)) {
+		parent = stack->len > 0 ? &g_array_index(stack, GConfCleanerXmlDirFrame, stack->len - 1) : NULL;
+		switch (token.type) {
+		    case GCLEANER_XML_TOKEN_ERROR:
+			    broken = TRUE;
+			    break;
+		    case GCLEANER_XML_TOKEN_COMMENT:
+			    break;
+		    case GCLEANER_XML_TOKEN_TEXT:
+			    if (parent && !_gconf_cleaner_xml_is_blank(token.start, token.end))
+				    parent->has_content = TRUE;
+			    break;
+		    case GCLEANER_XML_TOKEN_START:
+		    case GCLEANER_XML_TOKEN_EMPTY:
+			    frame.start = token.start - contents;
+			    frame.path_len = path->len;
+			    frame.is_dir = _gconf_cleaner_xml_token_is(&token, "dir");
+			    frame.has_content = FALSE;
+			    if (frame.is_dir) {
+				    gchar *name = _gconf_cleaner_xml_token_get_attribute(&token, "name");
+
+				    if (path->len > 1)
+					    g_string_append_c(path, '/');
+				    g_string_append(path, name ? name : "");
+				    g_free(name);
+			    }
+			    g_array_append_val(stack, frame);
+			    if (token.type == GCLEANER_XML_TOKEN_START)
+				    break;
+			    /* <foo/> ends here */
+		    case GCLEANER_XML_TOKEN_END:
+			    if (stack->len == 0) {
+				    broken = TRUE;
+				    break;
+			    }
+			    frame = g_array_index(stack, GConfCleanerXmlDirFrame, stack->len - 1);
+			    g_array_set_size(stack, stack->len - 1);
+			    parent = stack->len > 0 ? &g_array_index(stack, GConfCleanerXmlDirFrame, stack->len - 1) : NULL;
+			    if (frame.is_dir && !frame.has_content &&
+				g_hash_table_lookup(dirs, path->str)) {
+				    cut.start = frame.start;
+				    cut.key = g_strdup(path->str);
+				    _gconf_cleaner_xml_cut_lines(contents, len, &cut, token.end);
+				    for (i = cuts->len; i > 0; i--) {
+					    if (g_array_index(cuts, GConfCleanerXmlCut, i - 1).start < cut.start)
+						    break;
+				    }
+				    g_array_insert_val(cuts, i, cut);
+			    } else if (parent) {
+				    parent->has_content = TRUE;
+			    }
+			    if (frame.is_dir)
+				    g_string_truncate(path, frame.path_len);
+			    break;
+		    default:
+			    if (parent)
+				    parent->has_content = TRUE;
+			    break;
+		}
+	}
+	if (broken || stack->len > 0) {
+		g_set_error(error, 0, 0,
+			    _("Malformed XML document"));
+		retval = FALSE;
+	}
+	g_array_free(stack, TRUE);
+	g_string_free(path, TRUE);
+
+	return retval;
+}
+
+/* whether %gconf.xml in @contents has no entries */
+static gboolean
+_gconf_cleaner_xml_has_no_entries(const gchar *contents,
+				  gsize        len)
+{
+	const gchar *p = contents, *end = contents + len;
+	GConfCleanerXmlToken token;
+
+	while (_gconf_cleaner_xml_next_token(&p, end, &token)) {
+		if (token.type == GCLEANER_XML_TOKEN_ERROR ||
+		    ((token.type == GCLEANER_XML_TOKEN_START ||
+		      token.type == GCLEANER_XML_TOKEN_EMPTY) &&
+		     _gconf_cleaner_xml_token_is(&token, "entry")))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+_gconf_cleaner_xml_rewrite_free(GConfCleanerXmlRewrite *rewrite)
+{
+	guint i;
+
+	if (rewrite->tmpname) {
+		g_unlink(rewrite->tmpname);
+		g_free(rewrite->tmpname);
+	}
+	for (i = 0; i < rewrite->cuts->len; i++)
+		g_free(g_array_index(rewrite->cuts, GConfCleanerXmlCut, i).key);
+	g_array_free(rewrite->cuts, TRUE);
+	if (rewrite->tree)
+		g_hash_table_destroy(rewrite->tree);
+	g_free(rewrite->filename);
+	g_free(rewrite);
+}
+
+/*
+ * write @len bytes of @data to the temporary file next to @filename with
+ * the same permissions.  returns the name of the temporary file.
+ */
+static gchar *
+_gconf_cleaner_xml_write_temp(const gchar  *filename,
+			      const gchar  *data,
+			      gsize         len,
+			      GError      **error)
+{
+	struct stat st;
+	gchar *retval;
+	gsize written = 0;
+	ssize_t n = 0;
+	gint fd;
+
+	retval = g_strconcat(filename, ".gcleaner-XXXXXX", NULL);
+	if ((fd = g_mkstemp(retval)) == -1) {
+		g_set_error(error, 0, 0,
+			    _("Failed during creating a temporary file for %s: %s"),
+			    filename, g_strerror(errno));
+		g_free(retval);
+		return NULL;
+	}
+	if (stat(filename, &st) == 0)
+		fchmod(fd, st.st_mode & 07777);
+	while (written < len && (n = write(fd, data + written, len - written)) > 0)
+		written += n;
+	if (written != len || fsync(fd) != 0) {
+		g_set_error(error, 0, 0,
+			    _("Failed during writing %s: %s"),
+			    retval, g_strerror(errno));
+		close(fd);
+		g_unlink(retval);
+		g_free(retval);
+		return NULL;
+	}
+	if (close(fd) != 0) {
+		g_set_error(error, 0, 0,
+			    _("Failed during writing %s: %s"),
+			    retval, g_strerror(errno));
+		g_unlink(retval);
+		g_free(retval);
+		return NULL;
+	}
+
+	return retval;
+}
+
+static GConfCleanerXmlRewrite *
+_gconf_cleaner_xml_rewrite_alloc(GConfCleanerXmlRoot *root,
+				 const gchar         *filename)
+{
+	GConfCleanerXmlRewrite *retval = g_new0(GConfCleanerXmlRewrite, 1);
+
+	retval->root = root;
+	retval->filename = g_strdup(filename);
+	retval->cuts = g_array_new(FALSE, FALSE, sizeof (GConfCleanerXmlCut));
+
+	return retval;
+}
+
+/*
+ * write @filename without the parts @func finds for @names to the
+ * temporary file next to it.  returns NULL if nothing is found.
+ */
+static GConfCleanerXmlRewrite *
+_gconf_cleaner_xml_rewrite_new(GConfCleanerXmlRoot      *root,
+			       const gchar              *filename,
+			       const gchar              *dir,
+			       GConfCleanerXmlFindFunc   func,
+			       GHashTable               *names,
+			       GError                  **error)
+{
+	GConfCleanerXmlRewrite *retval;
+	GError *err = NULL;
+	GString *text;
+	gchar *contents;
+	gsize len, pos = 0;
+	guint i;
+
+	if (!g_file_get_contents(filename, &contents, &len, error))
+		return NULL;
+	retval = _gconf_cleaner_xml_rewrite_alloc(root, filename);
+	if (!func(contents, len, dir, names, retval->cuts, &err)) {
+		g_set_error(error, 0, 0,
+			    _("Failed during reading %s: %s"),
+			    filename, err->message);
+		g_error_free(err);
+		_gconf_cleaner_xml_rewrite_free(retval);
+		g_free(contents);
+		return NULL;
+	}
+	if (retval->cuts->len == 0) {
+		_gconf_cleaner_xml_rewrite_free(retval);
+		g_free(contents);
+		return NULL;
+	}
+
+	text = g_string_sized_new(len);
+	for (i = 0; i < retval->cuts->len; i++) {
+		GConfCleanerXmlCut *cut = &g_array_index(retval->cuts, GConfCleanerXmlCut, i);
+
+		/* covered by the previous one */
+		if (cut->start < pos)
+			continue;
+		g_string_append_len(text, contents + pos, cut->start - pos);
+		pos = cut->end;
+	}
+	g_string_append_len(text, contents + pos, len - pos);
+	g_free(contents);
+	retval->tmpname = _gconf_cleaner_xml_write_temp(filename, text->str, text->len, error);
+	g_string_free(text, TRUE);
+	if (retval->tmpname == NULL) {
+		_gconf_cleaner_xml_rewrite_free(retval);
+		return NULL;
+	}
+
+	return retval;
+}
+
+/* the tag in the canonical form: the attributes in double quotes but muser */
+static void
+_gconf_cleaner_xml_append_tag(GString                    *out,
+			      const GConfCleanerXmlToken *token)
+{
+	const gchar *p = token->attrs, *name, *value;
+	gsize name_len, value_len, i;
+	gchar quote;
+
+	g_string_append_c(out, '<');
+	g_string_append_len(out, token->name, token->name_len);
+	while (_gconf_cleaner_xml_next_attribute(&p, token->attrs_end,
+						 &name, &name_len, &value, &value_len, &quote)) {
+		if (name_len == 5 && strncmp(name, "muser", 5) == 0)
+			continue;
+		g_string_append_c(out, ' ');
+		g_string_append_len(out, name, name_len);
+		g_string_append(out, "=\"");
+		for (i = 0; i < value_len; i++) {
+			if (value[i] == '"')
+				g_string_append(out, "&quot;");
+			else
+				g_string_append_c(out, value[i]);
+		}
+		g_string_append_c(out, '"');
+	}
+	g_string_append(out, token->type == GCLEANER_XML_TOKEN_EMPTY ? "/>" : ">");
+}
+
+/*
+ * write @contents of %gconf-tree.xml in the minimal form: no comments and
+ * no whitespace between the elements, no <dir> without any entries under
+ * it, no <entry> without either a value or a schema, and no muser.  the
+ * text in <stringvalue> and <longdesc> is kept as it is.
+ */
+static GString *
+_gconf_cleaner_xml_compact(const gchar  *contents,
+			   gsize         len,
+			   guint        *n_dirs,
+			   guint        *n_entries,
+			   GError      **error)
+{
+	GArray *frames = g_array_new(FALSE, TRUE, sizeof (GConfCleanerXmlCompactFrame));
+	GConfCleanerXmlCompactFrame *frame, child;
+	GConfCleanerXmlToken token;
+	GString *retval = g_string_sized_new(len);
+	const gchar *p = contents, *end = contents + len;
+	gboolean broken = FALSE;
+	gchar *attr = NULL;
+	guint i;
+
+	memset(&child, 0, sizeof (GConfCleanerXmlCompactFrame));
+	child.out = retval;
+	g_array_append_val(frames, child);
+	while (!broken && _gconf_cleaner_xml_next_token(&p, end, &token)) {
+		gboolean is_dir = _gconf_cleaner_xml_token_is(&token, "dir");
+		gboolean is_entry = _gconf_cleaner_xml_token_is(&token, "entry");
+
+		frame = &g_array_index(frames, GConfCleanerXmlCompactFrame, frames->len - 1);
+		memset(&child, 0, sizeof (GConfCleanerXmlCompactFrame));
+		child.out = frame->out;
+		child.drop = frame->drop;
+		switch (token.type) {
+		    case GCLEANER_XML_TOKEN_ERROR:
+			    broken = TRUE;
+			    break;
+		    case GCLEANER_XML_TOKEN_COMMENT:
+			    break;
+		    case GCLEANER_XML_TOKEN_TEXT:
+			    if (!frame->drop &&
+				(frame->is_text || !_gconf_cleaner_xml_is_blank(token.start, token.end)))
+				    g_string_append_len(frame->out, token.start, token.end - token.start);
+			    break;
+		    case GCLEANER_XML_TOKEN_DECL:
+		    case GCLEANER_XML_TOKEN_CDATA:
+			    if (!frame->drop)
+				    g_string_append_len(frame->out, token.start, token.end - token.start);
+			    break;
+		    case GCLEANER_XML_TOKEN_START:
+		    case GCLEANER_XML_TOKEN_EMPTY:
+			    if (frame->drop) {
+				    /* within the dropped entry */
+			    } else if (is_entry &&
+				       (attr = _gconf_cleaner_xml_token_get_attribute(&token, "type")) == NULL &&
+				       (attr = _gconf_cleaner_xml_token_get_attribute(&token, "schema")) == NULL) {
+				    (*n_entries)++;
+				    child.drop = TRUE;
+			    } else if (is_dir && token.type == GCLEANER_XML_TOKEN_EMPTY) {
+				    (*n_dirs)++;
+			    } else if (is_dir) {
+				    child.out = g_string_new(NULL);
+				    child.is_dir = TRUE;
+				    _gconf_cleaner_xml_append_tag(child.out, &token);
+			    } else {
+				    if (is_entry) {
+					    g_free(attr);
+					    frame->has_content = TRUE;
+				    }
+				    _gconf_cleaner_xml_append_tag(frame->out, &token);
+				    child.is_text = _gconf_cleaner_xml_token_is(&token, "stringvalue") ||
+					    _gconf_cleaner_xml_token_is(&token, "longdesc");
+			    }
+			    if (token.type == GCLEANER_XML_TOKEN_START)
+				    g_array_append_val(frames, child);
+			    break;
+		    case GCLEANER_XML_TOKEN_END:
+			    if (frames->len == 1) {
+				    broken = TRUE;
+				    break;
+			    }
+			    child = *frame;
+			    g_array_set_size(frames, frames->len - 1);
+			    frame = &g_array_index(frames, GConfCleanerXmlCompactFrame, frames->len - 1);
+			    if (child.drop && !frame->drop) {
+				    /* the end of the dropped entry */
+			    } else if (child.drop) {
+				    /* within the dropped entry */
+			    } else if (child.is_dir) {
+				    g_string_append(child.out, "</dir>");
+				    if (child.has_content) {
+					    g_string_append_len(frame->out, child.out->str, child.out->len);
+					    frame->has_content = TRUE;
+				    } else {
+					    (*n_dirs)++;
+				    }
+				    g_string_free(child.out, TRUE);
+			    } else {
+				    g_string_append(frame->out, "</");
+				    g_string_append_len(frame->out, token.name, token.name_len);
+				    g_string_append_c(frame->out, '>');
+			    }
+			    break;
+		    default:
+			    break;
+		}
+	}
+	for (i = 1; i < frames->len; i++) {
+		frame = &g_array_index(frames, GConfCleanerXmlCompactFrame, i);
+		if (frame->is_dir && !frame->drop)
+			g_string_free(frame->out, TRUE);
+	}
+	if (broken || frames->len > 1) {
+		g_set_error(error, 0, 0,
+			    _("Malformed XML document"));
+		g_string_free(retval, TRUE);
+		retval = NULL;
+	} else {
+		g_string_append_c(retval, '\n');
+	}
+	g_array_free(frames, TRUE);
+
+	return retval;
+}
+
+/*
+ * replace the originals with the temporary files of @rewrites.  each
+ * original is linked to the .gcleaner-orig file next to it first, and
+ * all of them are put back if any of the temporary files can't replace
+ * its original.
+ */
+static gboolean
+_gconf_cleaner_xml_rewrites_commit(GPtrArray  *rewrites,
+				   GError    **error)
+{
+	GPtrArray *origs = g_ptr_array_new();
+	gboolean retval = TRUE;
+	guint i, n_renamed = 0;
+
+	for (i = 0; retval && i < rewrites->len; i++) {
+		GConfCleanerXmlRewrite *rewrite = g_ptr_array_index(rewrites, i);
+		gchar *orig = g_strconcat(rewrite->filename, ".gcleaner-orig", NULL);
+
+		g_unlink(orig);
+		if (link(rewrite->filename, orig) != 0) {
+			g_set_error(error, 0, 0,
+				    _("Failed to keep the copy of `%s': %s"),
+				    rewrite->filename, g_strerror(errno));
+			g_free(orig);
+			retval = FALSE;
+			break;
+		}
+		g_ptr_array_add(origs, orig);
+	}
+	for (i = 0; retval && i < rewrites->len; i++) {
+		GConfCleanerXmlRewrite *rewrite = g_ptr_array_index(rewrites, i);
+
+		if (g_rename(rewrite->tmpname, rewrite->filename) != 0) {
+			g_set_error(error, 0, 0,
+				    _("Failed to rename `%s' to `%s': %s"),
+				    rewrite->tmpname, rewrite->filename, g_strerror(errno));
+			retval = FALSE;
+			break;
+		}
+		n_renamed++;
+	}
+	/* put back the originals which have been replaced already */
+	for (i = 0; !retval && i < n_renamed; i++) {
+		GConfCleanerXmlRewrite *rewrite = g_ptr_array_index(rewrites, i);
+
+		if (g_rename(g_ptr_array_index(origs, i), rewrite->filename) != 0)
+			g_warning(_("Failed to restore `%s' from `%s': %s"),
+				  rewrite->filename, (gchar *)g_ptr_array_index(origs, i),
+				  g_strerror(errno));
+	}
+	for (i = 0; i < origs->len; i++) {
+		g_unlink(g_ptr_array_index(origs, i));
+		g_free(g_ptr_array_index(origs, i));
+	}
+	g_ptr_array_free(origs, TRUE);
+	for (i = 0; retval && i < rewrites->len; i++) {
+		GConfCleanerXmlRewrite *rewrite = g_ptr_array_index(rewrites, i);
+
+		g_free(rewrite->tmpname);
+		rewrite->tmpname = NULL;
+	}
+
+	return retval;
+}
+
+static void
+_gconf_cleaner_xml_root_remove_entry(GConfCleanerXmlRoot *root,
+				     const gchar         *key)
+{
+	GConfCleanerXmlDir *node;
+	gchar *dir, *name;
+	GSList *l;
+
+	dir = g_path_get_dirname(key);
+	name = g_path_get_basename(key);
+	if ((node = g_hash_table_lookup(root->tree, dir)) != NULL) {
+		for (l = node->entries; l != NULL; l = g_slist_next(l)) {
+			GConfCleanerXmlEntry *e = l->data;
+
+			if (strcmp(e->name, name) == 0) {
+				node->entries = g_slist_delete_link(node->entries, l);
+				_gconf_cleaner_xml_entry_free(e);
+				break;
+			}
+		}
+	}
+	g_free(dir);
+	g_free(name);
+}
+
+static void
+_gconf_cleaner_xml_root_remove_dir(GConfCleanerXmlRoot *root,
+				   const gchar         *dir)
+{
+	GConfCleanerXmlDir *node;
+	gchar *parent, *name;
+	GSList *l;
+
+	parent = g_path_get_dirname(dir);
+	name = g_path_get_basename(dir);
+	if ((node = g_hash_table_lookup(root->tree, parent)) != NULL) {
+		for (l = node->subdirs; l != NULL; l = g_slist_next(l)) {
+			if (strcmp(l->data, name) == 0) {
+				g_free(l->data);
+				node->subdirs = g_slist_delete_link(node->subdirs, l);
+				break;
+			}
+		}
+	}
+	g_hash_table_remove(root->tree, dir);
+	g_free(parent);
+	g_free(name);
+}
+
+/*
+ * Public Functions
+ */
+GConfCleanerXmlSource *
+gconf_cleaner_xml_source_new(const gchar * const  *addresses,
+			     GError              **error)
+{
+	GConfCleanerXmlSource *retval;
+	GPtrArray *list = g_ptr_array_new();
+	guint i;
+
+	if (addresses) {
+		for (i = 0; addresses[i] != NULL; i++)
+			g_ptr_array_add(list, g_strdup(addresses[i]));
+	} else {
+		_gconf_cleaner_xml_read_path(GCLEANER_GCONF_SYSCONFDIR "/2/path", list, 0);
+	}
+
+	retval = g_new0(GConfCleanerXmlSource, 1);
+	retval->roots = g_ptr_array_new();
+	for (i = 0; i < list->len; i++) {
+		GConfCleanerXmlRoot *root;
+		GError *err = NULL;
+
+		root = _gconf_cleaner_xml_root_new(g_ptr_array_index(list, i), &err);
+		if (G_UNLIKELY (err != NULL)) {
+			g_propagate_error(error, err);
+			break;
+		}
+		if (root)
+			g_ptr_array_add(retval->roots, root);
+	}
+	if (i == list->len && retval->roots->len == 0)
+		g_set_error(error, 0, 0,
+			    _("No readable configuration sources"));
+	for (i = 0; i < list->len; i++)
+		g_free(g_ptr_array_index(list, i));
+	g_ptr_array_free(list, TRUE);
+
+	if (error && *error) {
+		gconf_cleaner_xml_source_free(retval);
+		return NULL;
+	}
+
+	return retval;
+}
+
+void
+gconf_cleaner_xml_source_free(GConfCleanerXmlSource *source)
+{
+	guint i;
+
+	g_return_if_fail (source != NULL);
+
+	for (i = 0; i < source->roots->len; i++)
+		_gconf_cleaner_xml_root_free(g_ptr_array_index(source->roots, i));
+	g_ptr_array_free(source->roots, TRUE);
+	g_free(source);
+}
+
+GSList *
+gconf_cleaner_xml_source_all_dirs(GConfCleanerXmlSource  *source,
+				  const gchar            *dir,
+				  GError                **error)
+{
+	GHashTable *seen;
+	GSList *retval = NULL, *names, *l;
+	guint i;
+
+	g_return_val_if_fail (source != NULL, NULL);
+	g_return_val_if_fail (dir != NULL, NULL);
+
+	seen = g_hash_table_new(g_str_hash, g_str_equal);
+	for (i = 0; i < source->roots->len; i++) {
+		names = _gconf_cleaner_xml_root_all_dirs(g_ptr_array_index(source->roots, i),
+							 dir, error);
+		for (l = names; l != NULL; l = g_slist_next(l)) {
+			if (g_hash_table_lookup(seen, l->data)) {
+				g_free(l->data);
+			} else {
+				g_hash_table_insert(seen, l->data, l->data);
+				retval = g_slist_prepend(retval, l->data);
+			}
+		}
+		g_slist_free(names);
+	}
+	g_hash_table_destroy(seen);
+	retval = g_slist_sort(retval, (GCompareFunc)strcmp);
+	for (l = retval; l != NULL; l = g_slist_next(l)) {
+		gchar *name = l->data;
+
+		l->data = _gconf_cleaner_xml_concat(dir, name);
+		g_free(name);
+	}
+
+	return retval;
+}
+
+GSList *
+gconf_cleaner_xml_source_all_entries(GConfCleanerXmlSource  *source,
+				     const gchar            *dir,
+				     GError                **error)
+{
+	GHashTable *entries;
+	GSList *retval = NULL, *l;
+	guint i;
+
+	g_return_val_if_fail (source != NULL, NULL);
+	g_return_val_if_fail (dir != NULL, NULL);
+
+	/* merge the sources in order as gconfd does */
+	entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	for (i = 0; i < source->roots->len; i++) {
+		GConfCleanerXmlDir *node;
+		gboolean is_copy;
+		GError *err = NULL;
+
+		node = _gconf_cleaner_xml_root_get_dir(g_ptr_array_index(source->roots, i),
+						       dir, &is_copy, &err);
+		if (G_UNLIKELY (err != NULL)) {
+			g_propagate_error(error, err);
+			break;
+		}
+		if (node == NULL)
+			continue;
+		for (l = node->entries; l != NULL; l = g_slist_next(l)) {
+			GConfCleanerXmlEntry *e = l->data;
+			GConfEntry *entry = g_hash_table_lookup(entries, e->name);
+
+			if (entry == NULL) {
+				gchar *key = _gconf_cleaner_xml_concat(dir, e->name);
+
+				entry = gconf_entry_new(key, e->value);
+				g_free(key);
+				g_hash_table_insert(entries, g_strdup(e->name), entry);
+				retval = g_slist_prepend(retval, entry);
+			} else if (gconf_entry_get_value(entry) == NULL && e->value) {
+				gconf_entry_set_value_nocopy(entry, gconf_value_copy(e->value));
+			}
+			if (gconf_entry_get_schema_name(entry) == NULL && e->schema_name)
+				gconf_entry_set_schema_name(entry, e->schema_name);
+		}
+		if (is_copy)
+			_gconf_cleaner_xml_dir_free(node);
+	}
+	g_hash_table_destroy(entries);
+
+	return g_slist_reverse(retval);
+}
+
+gboolean
+gconf_cleaner_xml_source_has_schema(GConfCleanerXmlSource *source,
+				    const gchar           *schema_name)
+{
+	gchar *dir, *name;
+	gboolean retval = FALSE;
+	guint i;
+
+	g_return_val_if_fail (source != NULL, FALSE);
+	g_return_val_if_fail (schema_name != NULL, FALSE);
+
+	dir = g_path_get_dirname(schema_name);
+	name = g_path_get_basename(schema_name);
+	for (i = 0; i < source->roots->len && !retval; i++) {
+		GConfCleanerXmlDir *node;
+		gboolean is_copy;
+		GSList *l;
+
+		node = _gconf_cleaner_xml_root_get_dir(g_ptr_array_index(source->roots, i),
+						       dir, &is_copy, NULL);
+		if (node == NULL)
+			continue;
+		for (l = node->entries; l != NULL; l = g_slist_next(l)) {
+			GConfCleanerXmlEntry *e = l->data;
+
+			if (e->is_schema && strcmp(e->name, name) == 0) {
+				retval = TRUE;
+				break;
+			}
+		}
+		if (is_copy)
+			_gconf_cleaner_xml_dir_free(node);
+	}
+	g_free(dir);
+	g_free(name);
+
+	return retval;
+}
+
+/*
+ * get the stamp of the files which @dir is read from.  every directories
+ * in the same %gconf-tree.xml share the stamp of that file.  @mtime is in
+ * nanoseconds, but only the seconds are there where struct stat has no
+ * st_mtim.
+ */
+gboolean
+gconf_cleaner_xml_source_get_stamp(GConfCleanerXmlSource *source,
+				   const gchar           *dir,
+				   guint64               *mtime,
+				   guint64               *size)
+{
+	gboolean retval = FALSE;
+	guint i;
+
+	g_return_val_if_fail (source != NULL, FALSE);
+	g_return_val_if_fail (dir != NULL, FALSE);
+	g_return_val_if_fail (mtime != NULL, FALSE);
+	g_return_val_if_fail (size != NULL, FALSE);
+
+	*mtime = 0;
+	*size = 0;
+	for (i = 0; i < source->roots->len; i++) {
+		GConfCleanerXmlRoot *root = g_ptr_array_index(source->roots, i);
+		struct stat st;
+
+		if (root->tree) {
+			st = root->tree_stat;
+		} else {
+			gchar *filename = g_build_filename(root->path, dir, GCLEANER_XML_DIR_FILE, NULL);
+			gint ret = stat(filename, &st);
+
+			g_free(filename);
+			if (ret != 0)
+				continue;
+		}
+		*mtime = MAX (*mtime, _gconf_cleaner_xml_stat_mtime(&st));
+		*size += st.st_size;
+		retval = TRUE;
+	}
+
+	return retval;
+}
+
+/*
+ * remove @keys from the files of the writable sources without gconfd.
+ * each file is rewritten once, to the temporary file first, and the
+ * originals are replaced only when all of them are written, so nothing
+ * is changed if it fails halfway.  gconfd must not be running.
+ */
+gboolean
+gconf_cleaner_xml_source_remove_keys(GConfCleanerXmlSource  *source,
+				     const gchar * const    *keys,
+				     guint                   n_keys,
+				     guint                  *n_removed,
+				     GError                **error)
+{
+	GHashTable *key_table, *dirs, *removed;
+	GPtrArray *rewrites, *dir_list;
+	gboolean retval = TRUE;
+	guint i, j, k;
+
+	g_return_val_if_fail (source != NULL, FALSE);
+	g_return_val_if_fail (keys != NULL || n_keys == 0, FALSE);
+
+	/* group the keys by the directory */
+	key_table = g_hash_table_new(g_str_hash, g_str_equal);
+	dirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	dir_list = g_ptr_array_new();
+	for (i = 0; i < n_keys; i++) {
+		gchar *dir = g_path_get_dirname(keys[i]);
+
+		g_hash_table_insert(key_table, (gpointer)keys[i], (gpointer)keys[i]);
+		if (g_hash_table_lookup(dirs, dir)) {
+			g_free(dir);
+		} else {
+			g_hash_table_insert(dirs, dir, dir);
+			g_ptr_array_add(dir_list, dir);
+		}
+	}
+
+	rewrites = g_ptr_array_new();
+	for (i = 0; retval && i < source->roots->len; i++) {
+		GConfCleanerXmlRoot *root = g_ptr_array_index(source->roots, i);
+		GConfCleanerXmlRewrite *rewrite;
+		GError *err = NULL;
+		gchar *filename;
+
+		if (!root->writable)
+			continue;
+		if (root->tree) {
+			filename = g_build_filename(root->path, GCLEANER_XML_TREE_FILE, NULL);
+			rewrite = _gconf_cleaner_xml_rewrite_new(root, filename, "/",
+								 _gconf_cleaner_xml_find_cuts,
+								 key_table, &err);
+			g_free(filename);
+			if (rewrite)
+				g_ptr_array_add(rewrites, rewrite);
+			retval = (err == NULL);
+			if (err)
+				g_propagate_error(error, err);
+			continue;
+		}
+		for (k = 0; retval && k < dir_list->len; k++) {
+			const gchar *dir = g_ptr_array_index(dir_list, k);
+
+			filename = g_build_filename(root->path, dir, GCLEANER_XML_DIR_FILE, NULL);
+			if (g_file_test(filename, G_FILE_TEST_EXISTS)) {
+				rewrite = _gconf_cleaner_xml_rewrite_new(root, filename, dir,
+									 _gconf_cleaner_xml_find_cuts,
+									 key_table, &err);
+				if (rewrite)
+					g_ptr_array_add(rewrites, rewrite);
+				retval = (err == NULL);
+				if (err)
+					g_propagate_error(error, err);
+			}
+			g_free(filename);
+		}
+	}
+	g_ptr_array_free(dir_list, TRUE);
+
+	removed = g_hash_table_new(g_str_hash, g_str_equal);
+	if (retval)
+		retval = _gconf_cleaner_xml_rewrites_commit(rewrites, error);
+	for (i = 0; retval && i < rewrites->len; i++) {
+		GConfCleanerXmlRewrite *rewrite = g_ptr_array_index(rewrites, i);
+
+		for (j = 0; j < rewrite->cuts->len; j++) {
+			const gchar *key = g_array_index(rewrite->cuts, GConfCleanerXmlCut, j).key;
+
+			/* keep what's read already in sync with the file */
+			if (rewrite->root->tree)
+				_gconf_cleaner_xml_root_remove_entry(rewrite->root, key);
+			g_hash_table_insert(removed, (gpointer)key, (gpointer)key);
+		}
+		if (rewrite->root->tree)
+			stat(rewrite->filename, &rewrite->root->tree_stat);
+	}
+	if (n_removed)
+		*n_removed = g_hash_table_size(removed);
+	g_hash_table_destroy(removed);
+	for (i = 0; i < rewrites->len; i++)
+		_gconf_cleaner_xml_rewrite_free(g_ptr_array_index(rewrites, i));
+	g_ptr_array_free(rewrites, TRUE);
+	g_hash_table_destroy(dirs);
+	g_hash_table_destroy(key_table);
+
+	return retval;
+}
+
+gboolean
+gconf_cleaner_xml_source_compact(GConfCleanerXmlSource  *source,
+				 GConfCleanerCompaction *compaction,
+				 GError                **error)
+{
+	GPtrArray *rewrites;
+	GTimer *timer;
+	gboolean retval = TRUE;
+	guint i;
+
+	g_return_val_if_fail (source != NULL, FALSE);
+	g_return_val_if_fail (compaction != NULL, FALSE);
+
+	memset(compaction, 0, sizeof (GConfCleanerCompaction));
+	timer = g_timer_new();
+	rewrites = g_ptr_array_new();
+	for (i = 0; retval && i < source->roots->len; i++) {
+		GConfCleanerXmlRoot *root = g_ptr_array_index(source->roots, i);
+		GConfCleanerXmlRewrite *rewrite;
+		GHashTable *tree;
+		GString *text;
+		GError *err = NULL;
+		gchar *filename, *contents;
+		gsize len;
+
+		if (!root->writable || root->tree == NULL)
+			continue;
+		filename = g_build_filename(root->path, GCLEANER_XML_TREE_FILE, NULL);
+		/* what gconfd would go through at the next start-up */
+		g_timer_start(timer);
+		tree = _gconf_cleaner_xml_parse_tree(filename, error);
+		compaction->parse_time_before += g_timer_elapsed(timer, NULL);
+		if (tree == NULL ||
+		    !g_file_get_contents(filename, &contents, &len, error)) {
+			if (tree)
+				g_hash_table_destroy(tree);
+			g_free(filename);
+			retval = FALSE;
+			break;
+		}
+		g_hash_table_destroy(tree);
+		text = _gconf_cleaner_xml_compact(contents, len,
+						  &compaction->n_dropped_dirs,
+						  &compaction->n_dropped_entries,
+						  &err);
+		g_free(contents);
+		if (text == NULL) {
+			g_set_error(error, 0, 0,
+				    _("Failed during reading %s: %s"),
+				    filename, err->message);
+			g_error_free(err);
+			g_free(filename);
+			retval = FALSE;
+			break;
+		}
+		rewrite = _gconf_cleaner_xml_rewrite_alloc(root, filename);
+		g_free(filename);
+		g_ptr_array_add(rewrites, rewrite);
+		rewrite->tmpname = _gconf_cleaner_xml_write_temp(rewrite->filename,
+								 text->str, text->len,
+								 error);
+		compaction->n_files++;
+		compaction->size_before += len;
+		compaction->size_after += text->len;
+		g_string_free(text, TRUE);
+		if (rewrite->tmpname == NULL) {
+			retval = FALSE;
+			break;
+		}
+		/* read it back before it replaces the original */
+		g_timer_start(timer);
+		rewrite->tree = _gconf_cleaner_xml_parse_tree(rewrite->tmpname, error);
+		compaction->parse_time_after += g_timer_elapsed(timer, NULL);
+		if (rewrite->tree == NULL)
+			retval = FALSE;
+	}
+	g_timer_destroy(timer);
+
+	if (retval)
+		retval = _gconf_cleaner_xml_rewrites_commit(rewrites, error);
+	for (i = 0; retval && i < rewrites->len; i++) {
+		GConfCleanerXmlRewrite *rewrite = g_ptr_array_index(rewrites, i);
+
+		g_hash_table_destroy(rewrite->root->tree);
+		rewrite->root->tree = rewrite->tree;
+		rewrite->tree = NULL;
+		stat(rewrite->filename, &rewrite->root->tree_stat);
+	}
+	for (i = 0; i < rewrites->len; i++)
+		_gconf_cleaner_xml_rewrite_free(g_ptr_array_index(rewrites, i));
+	g_ptr_array_free(rewrites, TRUE);
+
+	return retval;
+}
+
+/*
+ * remove @dirs, given the subdirectories first, from the writable roots
+ * if they have neither entries nor subdirectories there.  %gconf-tree.xml
+ * is rewritten as in gconf_cleaner_xml_source_remove_keys(), and the
+ * empty %gconf.xml is removed together with the directory of it.
+ */
+gboolean
+gconf_cleaner_xml_source_remove_dirs(GConfCleanerXmlSource  *source,
+				     const gchar * const    *dirs,
+				     guint                   n_dirs,
+				     guint                  *n_removed,
+				     GError                **error)
+{
+	GHashTable *dir_table, *removed;
+	GPtrArray *rewrites;
+	gboolean retval = TRUE;
+	guint i, j, k;
+
+	g_return_val_if_fail (source != NULL, FALSE);
+	g_return_val_if_fail (dirs != NULL || n_dirs == 0, FALSE);
+
+	dir_table = g_hash_table_new(g_str_hash, g_str_equal);
+	for (i = 0; i < n_dirs; i++)
+		g_hash_table_insert(dir_table, (gpointer)dirs[i], (gpointer)dirs[i]);
+
+	removed = g_hash_table_new(g_str_hash, g_str_equal);
+	rewrites = g_ptr_array_new();
+	for (i = 0; retval && i < source->roots->len; i++) {
+		GConfCleanerXmlRoot *root = g_ptr_array_index(source->roots, i);
+		GConfCleanerXmlRewrite *rewrite;
+		GError *err = NULL;
+		gchar *filename, *contents, *path;
+		gsize len;
+		GSList *subdirs, *l;
+
+		if (!root->writable)
+			continue;
+		if (root->tree) {
+			filename = g_build_filename(root->path, GCLEANER_XML_TREE_FILE, NULL);
+			rewrite = _gconf_cleaner_xml_rewrite_new(root, filename, "/",
+								 _gconf_cleaner_xml_find_dir_cuts,
+								 dir_table, &err);
+			g_free(filename);
+			if (rewrite)
+				g_ptr_array_add(rewrites, rewrite);
+			retval = (err == NULL);
+			if (err)
+				g_propagate_error(error, err);
+			continue;
+		}
+		for (k = 0; retval && k < n_dirs; k++) {
+			filename = g_build_filename(root->path, dirs[k], GCLEANER_XML_DIR_FILE, NULL);
+			if (!g_file_test(filename, G_FILE_TEST_EXISTS)) {
+				g_free(filename);
+				continue;
+			}
+			if (!g_file_get_contents(filename, &contents, &len, error)) {
+				g_free(filename);
+				retval = FALSE;
+				break;
+			}
+			subdirs = _gconf_cleaner_xml_root_all_dirs(root, dirs[k], NULL);
+			if (subdirs == NULL && _gconf_cleaner_xml_has_no_entries(contents, len)) {
+				if (g_unlink(filename) != 0) {
+					g_set_error(error, 0, 0,
+						    _("Failed to remove `%s': %s"),
+						    filename, g_strerror(errno));
+					retval = FALSE;
+				} else {
+					/* anything else left there is kept */
+					path = g_build_filename(root->path, dirs[k], NULL);
+					g_rmdir(path);
+					g_free(path);
+					g_hash_table_insert(removed, (gpointer)dirs[k], (gpointer)dirs[k]);
+				}
+			}
+			for (l = subdirs; l != NULL; l = g_slist_next(l))
+				g_free(l->data);
+			g_slist_free(subdirs);
+			g_free(contents);
+			g_free(filename);
+		}
+	}
+
+	if (retval)
+		retval = _gconf_cleaner_xml_rewrites_commit(rewrites, error);
+	for (i = 0; retval && i < rewrites->len; i++) {
+		GConfCleanerXmlRewrite *rewrite = g_ptr_array_index(rewrites, i);
+
+		for (j = 0; j < rewrite->cuts->len; j++) {
+			const gchar *dir = g_array_index(rewrite->cuts, GConfCleanerXmlCut, j).key;
+
+			_gconf_cleaner_xml_root_remove_dir(rewrite->root, dir);
+			dir = g_hash_table_lookup(dir_table, dir);
+			g_hash_table_insert(removed, (gpointer)dir, (gpointer)dir);
+		}
+		stat(rewrite->filename, &rewrite->root->tree_stat);
+	}
+	if (n_removed)
+		*n_removed = g_hash_table_size(removed);
+	g_hash_table_destroy(removed);
+	for (i = 0; i < rewrites->len; i++)
+		_gconf_cleaner_xml_rewrite_free(g_ptr_array_index(rewrites, i));
+	g_ptr_array_free(rewrites, TRUE);
+	g_hash_table_destroy(dir_table);
+
+	return retval;
+}
@@ -0,0 +1,64 @@
+/* 
+ * gconf-cleaner-xml.h
+ * Copyright (C) 2007 Akira TAGOH
+ * 
+ * Authors:
+ *   Akira TAGOH  <akira@tagoh.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#ifndef __GCONF_CLEANER_XML_H__
+#define __GCONF_CLEANER_XML_H__
+
+#include <glib.h>
+#include "gconf-cleaner.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GConfCleanerXmlSource GConfCleanerXmlSource;
+
+GConfCleanerXmlSource *gconf_cleaner_xml_source_new        (const gchar * const    *addresses,
+							    GError                **error);
+void                   gconf_cleaner_xml_source_free       (GConfCleanerXmlSource  *source);
+GSList                *gconf_cleaner_xml_source_all_dirs   (GConfCleanerXmlSource  *source,
+							    const gchar            *dir,
+							    GError                **error);
+GSList                *gconf_cleaner_xml_source_all_entries(GConfCleanerXmlSource  *source,
+							    const gchar            *dir,
+							    GError                **error);
+gboolean               gconf_cleaner_xml_source_has_schema (GConfCleanerXmlSource  *source,
+							    const gchar            *schema_name);
+gboolean               gconf_cleaner_xml_source_get_stamp  (GConfCleanerXmlSource  *source,
+							    const gchar            *dir,
+							    guint64                *mtime,
+							    guint64                *size);
+gboolean               gconf_cleaner_xml_source_remove_keys(GConfCleanerXmlSource  *source,
+							    const gchar * const    *keys,
+							    guint                   n_keys,
+							    guint                  *n_removed,
+							    GError                **error);
+gboolean               gconf_cleaner_xml_source_remove_dirs(GConfCleanerXmlSource  *source,
+							    const gchar * const    *dirs,
+							    guint                   n_dirs,
+							    guint                  *n_removed,
+							    GError                **error);
+gboolean               gconf_cleaner_xml_source_compact    (GConfCleanerXmlSource  *source,
+							    GConfCleanerCompaction *compaction,
+							    GError                **error);
+
+G_END_DECLS
+
+#endif /* __GCONF_CLEANER_XML_H__ */
@@ -24,255 +24,2632 @@
 #include "config.h"
 #endif
 
+#include <errno.h>
 #include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <gconf/gconf.h>
 #include "gconf-cleaner.h"
+#include "gconf-cleaner-xml.h"
+#include "gconf-cleaner-cache.h"
+#include "gconf-cleaner-backup.h"
+#include "gconf-cleaner-exclude.h"
 
 
-struct _GConfCleaner {
-	GConfEngine *gconf;
-	GSList      *dirs;
-	GSList      *current_dir;
-	guint        n_dirs;
+/*
+ * the paths are kept as a trie of the interned components.  the footprint
+ * is filled in when the directory is analyzed, by the only worker which
+ * analyzes it.
+ */
+typedef struct _GConfCleanerDir {
+	guint        parent;	/* GCLEANER_NO_PARENT for the toplevel */
+	const gchar *name;
+	guint        n_excluded;	/* the subdirectories not traversed */
 	guint        n_pairs;
 	guint        n_unknown_pairs;
-	gboolean     initialized;
+	guint        max_list_length;
+	gsize        unknown_size;	/* the values of the unknown pairs as strings */
+} GConfCleanerDir;
+typedef struct _GConfCleanerPair {
+	const gchar *name;	/* the basename of the key */
+	GConfValue  *value;
+	guint        dir;
+} GConfCleanerPair;
+/* the layout of a value inside GConf, which only shows the type */
+typedef struct _GConfCleanerValueNode {
+	GConfValueType type;
+	union {
+		gdouble  d;
+		gpointer p[2];
+	} d;
+} GConfCleanerValueNode;
+typedef gboolean (* GConfCleanerVisitFunc) (const gchar *key,
+					    GConfValue  *value,
+					    guint        dir,
+					    const gchar *path,
+					    gpointer     data);
+typedef struct _GConfCleanerForeach {
+	GConfCleaner            *gcleaner;
+	GConfCleanerForeachFunc  func;
+	gpointer                 user_data;
+	gboolean                 stopped;
+} GConfCleanerForeach;
+typedef struct _GConfCleanerWorker {
+	GHashTable *schemas;
+	GString    *path;	/* the directory being analyzed */
+	GTimer     *timer;
+	guint       n_calls[GCLEANER_N_CALLS];
+	guint       n_slowest;
+	guint       slowest_dirs[GCLEANER_STATS_N_SLOWEST_DIRS];
+	gdouble     slowest_times[GCLEANER_STATS_N_SLOWEST_DIRS];
+	guint       n_pairs;
+	guint       n_unknown_pairs;
+	guint       n_schema_lookups;
+	guint       n_schema_hits;
+	guint       n_cache_hits;
+} GConfCleanerWorker;
+typedef struct _GConfCleanerBlock {
+	guint         first_dir;
+	guint         n_dirs;
+	GArray       *pairs;
+	gsize         values_size;
+	GStringChunk *names;	/* until merged into the result */
+	GHashTable   *names_table;
+	GError       *error;
+} GConfCleanerBlock;
+typedef struct _GConfCleanerStore {
+	GConfCleanerResult *result;
+	GConfCleanerBlock  *block;	/* NULL unless in a thread */
+	GArray             *pairs;
+} GConfCleanerStore;
+typedef struct _GConfCleanerPool {
+	GConfCleaner      *gcleaner;
+	GConfCleanerBlock *blocks;
+	gint               n_blocks;
+	volatile gint      next_block;
+	volatile gint      failed;
+} GConfCleanerPool;
+typedef struct _GConfCleanerThread {
+	GConfCleanerPool   *pool;
+	GConfCleanerWorker  worker;
+	GThread            *thread;
+} GConfCleanerThread;
+
+/* a directory found but not visited yet */
+typedef struct _GConfCleanerPending {
+	guint  parent;
+	guint  depth;
+	gchar *path;
+} GConfCleanerPending;
+
+typedef struct _GConfCleanerResume {
+	GConfCleaner *gcleaner;
+	GHashTable   *dirs;	/* path -> index + 1 */
+	guint         n_pairs;	/* to be read */
+	GError       *error;
+} GConfCleanerResume;
+
+typedef struct _GConfCleanerRestore {
+	GConfCleaner   *gcleaner;
+	GConfChangeSet *cs;
+	GPtrArray      *keys;	/* in @cs */
+	GHashTable     *restored;	/* the keys set already */
+	guint           n_restored;
+	guint           n_skipped;
+	guint           n_failed;
+} GConfCleanerRestore;
+
+struct _GConfCleanerResult {
+	GArray       *dirs;	/* in order of the traversal */
+	GArray       *pairs;
+	GStringChunk *names;	/* the components of the paths */
+	GHashTable   *names_table;
+	gsize         names_size;
+	gsize         values_size;	/* the copies of the values in @pairs */
+	GStaticMutex  lock;	/* for the names while merging the blocks */
 };
 
+struct _GConfCleaner {
+	GConfEngine           *gconf;
+	GConfCleanerXmlSource *xml;
+	GConfCleanerCache     *cache;
+	GConfCleanerExclude   *exclude;
+	GHashTable            *schema_index;	/* every schema under /schemas */
+	gdouble                schema_index_time;
+	gboolean               use_schema_index;
+	GConfCleanerResult     result;
+	guint                  current_dir;
+	GString               *current_path;
+	GArray                *pending;	/* the stack of the traversal */
+	guint                  depth;
+	gchar                 *checkpoint;
+	guint                  checkpoint_interval;
+	guint                  n_since_checkpoint;
+	guint                  n_checkpoint_pairs;	/* in the .pairs file already */
+	guint                  n_threads;
+	guint                  unset_batch_size;
+	GConfCleanerWorker     worker;
+	GConfCleanerStats      stats;
+	GTimer                *phase_timer;
+	gdouble                phase_cpu_time;
+	guint                  phase_calls[GCLEANER_N_CALLS];
+	gint                   phase_depth;
+	gboolean               initialized;
+};
+
+#define GCLEANER_UNSET_BATCH_SIZE	512
+#define GCLEANER_CHECKPOINT_MAGIC	"# gconf-cleaner checkpoint 3"
+#define GCLEANER_NO_PARENT		G_MAXUINT
+#define GCLEANER_BLOCKS_PER_THREAD	16
+
 /*
  * Private Functions
  */
 static GSList *
-_gconf_cleaner_all_dirs_recursively(GConfCleaner      *gcleaner,
-				    const gchar       *path,
-				    gboolean          *is_blocked,
-				    GError           **error)
+_gconf_cleaner_all_dirs(GConfCleaner        *gcleaner,
+			GConfCleanerWorker  *worker,
+			const gchar         *path,
+			GError             **error)
 {
-	GSList *subdirs, *l, *retval = NULL;
-	GError *err = NULL;
-	gint i;
-	/* XXX: may want to have more strict way of excluding keys */
-	static const gchar *blacklist[] = {
-		"schemas", "profiles", "preferences", "prefs", "connected_servers", "wireless", "vpn_connections",
-		NULL,
-	};
+	worker->n_calls[GCLEANER_CALL_ALL_DIRS]++;
+	if (gcleaner->xml)
+		return gconf_cleaner_xml_source_all_dirs(gcleaner->xml, path, error);
 
-	if (is_blocked)
-		*is_blocked = FALSE;
-	for (i = 0; blacklist[i] != NULL; i++) {
-		if (strcmp(g_basename(path), blacklist[i]) == 0) {
-			if (is_blocked)
-				*is_blocked = TRUE;
-			return NULL;
-		}
+	return gconf_engine_all_dirs(gcleaner->gconf, path, error);
+}
+
+static GSList *
+_gconf_cleaner_all_entries(GConfCleaner        *gcleaner,
+			   GConfCleanerWorker  *worker,
+			   const gchar         *path,
+			   GError             **error)
+{
+	worker->n_calls[GCLEANER_CALL_ALL_ENTRIES]++;
+	if (gcleaner->xml)
+		return gconf_cleaner_xml_source_all_entries(gcleaner->xml, path, error);
+
+	return gconf_engine_all_entries(gcleaner->gconf, path, error);
+}
+
+static gsize
+_gconf_cleaner_value_size(GConfValue *value)
+{
+	gsize retval = sizeof (GConfCleanerValueNode);
+	GConfSchema *schema;
+	GSList *l;
+
+	switch (value->type) {
+	    case GCONF_VALUE_STRING:
+		    if (gconf_value_get_string(value))
+			    retval += strlen(gconf_value_get_string(value)) + 1;
+		    break;
+	    case GCONF_VALUE_SCHEMA:
+		    if ((schema = gconf_value_get_schema(value)) == NULL)
+			    break;
+		    retval += sizeof (GConfValueType) * 4 + sizeof (gpointer) * 6;
+		    if (gconf_schema_get_locale(schema))
+			    retval += strlen(gconf_schema_get_locale(schema)) + 1;
+		    if (gconf_schema_get_owner(schema))
+			    retval += strlen(gconf_schema_get_owner(schema)) + 1;
+		    if (gconf_schema_get_short_desc(schema))
+			    retval += strlen(gconf_schema_get_short_desc(schema)) + 1;
+		    if (gconf_schema_get_long_desc(schema))
+			    retval += strlen(gconf_schema_get_long_desc(schema)) + 1;
+		    if (gconf_schema_get_default_value(schema))
+			    retval += _gconf_cleaner_value_size(gconf_schema_get_default_value(schema));
+		    break;
+	    case GCONF_VALUE_LIST:
+		    for (l = gconf_value_get_list(value); l != NULL; l = g_slist_next(l))
+			    retval += sizeof (GSList) + _gconf_cleaner_value_size(l->data);
+		    break;
+	    case GCONF_VALUE_PAIR:
+		    if (gconf_value_get_car(value))
+			    retval += _gconf_cleaner_value_size(gconf_value_get_car(value));
+		    if (gconf_value_get_cdr(value))
+			    retval += _gconf_cleaner_value_size(gconf_value_get_cdr(value));
+		    break;
+	    default:
+		    break;
+	}
+
+	return retval;
+}
+
+/* GArray keeps its allocation to itself, but grows it to a power of two */
+static gsize
+_gconf_cleaner_array_size(GArray *array,
+			  gsize   element_size)
+{
+	gsize size = array->len * element_size, retval = 16;
+
+	if (size == 0)
+		return 0;
+	while (retval < size)
+		retval <<= 1;
+
+	return retval;
+}
+
+static const gchar *
+_gconf_cleaner_names_insert(GStringChunk *names,
+			    GHashTable   *names_table,
+			    const gchar  *name,
+			    gsize        *size)
+{
+	const gchar *retval;
+
+	if ((retval = g_hash_table_lookup(names_table, name)) == NULL) {
+		retval = g_string_chunk_insert(names, name);
+		g_hash_table_insert(names_table, (gpointer)retval, (gpointer)retval);
+		if (size)
+			*size += strlen(retval) + 1;
 	}
 
-	subdirs = gconf_engine_all_dirs(gcleaner->gconf, path, &err);
+	return retval;
+}
+
+static const gchar *
+_gconf_cleaner_result_intern(GConfCleanerResult *result,
+			     const gchar        *name)
+{
+	const gchar *retval;
+
+	g_static_mutex_lock(&result->lock);
+	retval = _gconf_cleaner_names_insert(result->names, result->names_table,
+					     name, &result->names_size);
+	g_static_mutex_unlock(&result->lock);
+
+	return retval;
+}
+
+static void
+_gconf_cleaner_result_append_path(const GConfCleanerResult *result,
+				  guint                     dir,
+				  GString                  *path)
+{
+	const GConfCleanerDir *d = &g_array_index(result->dirs, GConfCleanerDir, dir);
+
+	if (d->parent != GCLEANER_NO_PARENT)
+		_gconf_cleaner_result_append_path(result, d->parent, path);
+	g_string_append_c(path, '/');
+	g_string_append(path, d->name);
+}
+
+static void
+_gconf_cleaner_result_build_path(const GConfCleanerResult *result,
+				 guint                     dir,
+				 GString                  *path)
+{
+	g_string_truncate(path, 0);
+	_gconf_cleaner_result_append_path(result, dir, path);
+}
+
+static void
+_gconf_cleaner_result_build_key(const GConfCleanerResult *result,
+				guint                     index,
+				GString                  *key)
+{
+	const GConfCleanerPair *pair = &g_array_index(result->pairs, GConfCleanerPair, index);
+
+	_gconf_cleaner_result_build_path(result, pair->dir, key);
+	g_string_append_c(key, '/');
+	g_string_append(key, pair->name);
+}
+
+static guint
+_gconf_cleaner_result_add_dir(GConfCleanerResult *result,
+			      guint               parent,
+			      const gchar        *path)
+{
+	GConfCleanerDir dir;
+	const gchar *p = strrchr(path, '/');
+
+	memset(&dir, 0, sizeof (GConfCleanerDir));
+	dir.parent = parent;
+	dir.name = _gconf_cleaner_result_intern(result, p ? p + 1 : path);
+	g_array_append_val(result->dirs, dir);
+
+	return result->dirs->len - 1;
+}
+
+static void
+_gconf_cleaner_pending_push(GConfCleaner *gcleaner,
+			    guint         parent,
+			    guint         depth,
+			    gchar        *path)
+{
+	GConfCleanerPending pending;
+
+	pending.parent = parent;
+	pending.depth = depth;
+	pending.path = path;
+	g_array_append_val(gcleaner->pending, pending);
+}
+
+static void
+_gconf_cleaner_pending_clear(GConfCleaner *gcleaner)
+{
+	guint i;
+
+	for (i = 0; i < gcleaner->pending->len; i++)
+		g_free(g_array_index(gcleaner->pending, GConfCleanerPending, i).path);
+	g_array_set_size(gcleaner->pending, 0);
+}
+
+/*
+ * visit the directory on the top of the stack.  it's added to the result
+ * and its subdirectories are pushed in reverse so that the directories
+ * are still stored in the depth-first order.
+ */
+static gboolean
+_gconf_cleaner_traverse_dir(GConfCleaner  *gcleaner,
+			    GError       **error)
+{
+	GConfCleanerPending pending;
+	GSList *subdirs, *l;
+	GError *err = NULL;
+	guint dir;
+
+	pending = g_array_index(gcleaner->pending, GConfCleanerPending,
+				gcleaner->pending->len - 1);
+	g_array_set_size(gcleaner->pending, gcleaner->pending->len - 1);
+	gcleaner->depth = pending.depth;
+	/* the toplevel isn't stored */
+	if (pending.depth > 0)
+		dir = _gconf_cleaner_result_add_dir(&gcleaner->result,
+						    pending.parent, pending.path);
+	else
+		dir = GCLEANER_NO_PARENT;
+
+	subdirs = _gconf_cleaner_all_dirs(gcleaner, &gcleaner->worker, pending.path, &err);
 	if (G_UNLIKELY (err != NULL)) {
-		if (error)
-			g_set_error(error, 0, 0,
-				    N_("Failed to get the directories in `%s': %s"),
-				    path, err->message);
+		g_set_error(error, 0, 0,
+			    N_("Failed to get the directories in `%s': %s"),
+			    pending.path, err->message);
 		g_error_free(err);
-		return NULL;
+		g_free(pending.path);
+		return FALSE;
 	}
+	g_free(pending.path);
+	subdirs = g_slist_reverse(subdirs);
 	for (l = subdirs; l != NULL; l = g_slist_next(l)) {
-		GSList *ll;
-		gboolean was_blocked;
-
-		ll = _gconf_cleaner_all_dirs_recursively(gcleaner,
-							 l->data,
-							 &was_blocked,
-							 error);
-		if (G_UNLIKELY (*error)) {
-			if (ll)
-				g_slist_free(ll);
-			if (retval)
-				g_slist_free(retval);
-			return NULL;
-		}
-		if (!was_blocked) {
-			gcleaner->n_dirs++;
-			retval = g_slist_append(retval, l->data);
-			if (G_LIKELY (ll))
-				retval = g_slist_concat(retval, ll);
-		}
+		if (gconf_cleaner_exclude_match(gcleaner->exclude, l->data)) {
+			if (dir != GCLEANER_NO_PARENT)
+				g_array_index(gcleaner->result.dirs, GConfCleanerDir, dir).n_excluded++;
+			g_free(l->data);
+		} else
+			_gconf_cleaner_pending_push(gcleaner, dir, pending.depth + 1, l->data);
 	}
+	g_slist_free(subdirs);
 
-	return retval;
+	return TRUE;
 }
 
-/*
- * Public Functions
- */
-GConfCleaner *
-gconf_cleaner_new(void)
+static void
+_gconf_cleaner_result_init(GConfCleanerResult *result)
 {
-	GConfCleaner *retval = g_new0(GConfCleaner, 1);
+	result->dirs = g_array_new(FALSE, FALSE, sizeof (GConfCleanerDir));
+	result->pairs = g_array_new(FALSE, FALSE, sizeof (GConfCleanerPair));
+	result->names = g_string_chunk_new(4096);
+	result->names_table = g_hash_table_new(g_str_hash, g_str_equal);
+	result->names_size = 0;
+	result->values_size = 0;
+	g_static_mutex_init(&result->lock);
+}
+
+static void
+_gconf_cleaner_pairs_clear(GArray *pairs)
+{
+	guint i;
+
+	for (i = 0; i < pairs->len; i++) {
+		GConfCleanerPair *pair = &g_array_index(pairs, GConfCleanerPair, i);
+
+		gconf_value_free(pair->value);
+	}
+	g_array_set_size(pairs, 0);
+}
+
+static void
+_gconf_cleaner_result_clear(GConfCleanerResult *result)
+{
+	g_array_set_size(result->dirs, 0);
+	_gconf_cleaner_pairs_clear(result->pairs);
+	g_hash_table_remove_all(result->names_table);
+	g_string_chunk_free(result->names);
+	result->names = g_string_chunk_new(4096);
+	result->names_size = 0;
+	result->values_size = 0;
+}
+
+static void
+_gconf_cleaner_result_finalize(GConfCleanerResult *result)
+{
+	_gconf_cleaner_pairs_clear(result->pairs);
+	g_array_free(result->dirs, TRUE);
+	g_array_free(result->pairs, TRUE);
+	g_hash_table_destroy(result->names_table);
+	g_string_chunk_free(result->names);
+	g_static_mutex_free(&result->lock);
+}
+
+/* copy the pairs from @start into the old style list of key and value */
+static GSList *
+_gconf_cleaner_result_to_list(GConfCleanerResult *result,
+			      guint               start)
+{
+	GSList *retval = NULL;
+	GString *key = g_string_new(NULL);
+	guint i;
 
-	g_return_val_if_fail (retval != NULL, NULL);
-	retval->gconf = gconf_engine_get_default();
-	g_return_val_if_fail (retval->gconf != NULL, NULL);
+	for (i = result->pairs->len; i > start; i--) {
+		GConfCleanerPair *pair = &g_array_index(result->pairs, GConfCleanerPair, i - 1);
+
+		_gconf_cleaner_result_build_key(result, i - 1, key);
+		retval = g_slist_prepend(retval, gconf_value_copy(pair->value));
+		retval = g_slist_prepend(retval, g_strdup(key->str));
+	}
+	g_string_free(key, TRUE);
 
 	return retval;
 }
 
-void
-gconf_cleaner_free(GConfCleaner *gcleaner)
+static void
+_gconf_cleaner_worker_init(GConfCleanerWorker *worker)
 {
-	g_return_if_fail (gcleaner != NULL);
+	memset(worker, 0, sizeof (GConfCleanerWorker));
+	worker->schemas = g_hash_table_new_full(g_str_hash, g_str_equal,
+						g_free, NULL);
+	worker->path = g_string_new(NULL);
+	worker->timer = g_timer_new();
+}
 
-	gconf_engine_unref(gcleaner->gconf);
-	if (G_LIKELY (gcleaner->dirs))
-		g_slist_free(gcleaner->dirs);
-	g_free(gcleaner);
+static void
+_gconf_cleaner_worker_finalize(GConfCleanerWorker *worker)
+{
+	g_hash_table_destroy(worker->schemas);
+	g_string_free(worker->path, TRUE);
+	g_timer_destroy(worker->timer);
 }
 
-gboolean
-gconf_cleaner_is_initialized(GConfCleaner *gcleaner)
+/* keep @dir if it's one of the slowest */
+static void
+_gconf_cleaner_worker_add_time(GConfCleanerWorker *worker,
+			       guint               dir,
+			       gdouble             time)
 {
-	return gcleaner->initialized;
+	guint i;
+
+	if (worker->n_slowest == GCLEANER_STATS_N_SLOWEST_DIRS &&
+	    time <= worker->slowest_times[worker->n_slowest - 1])
+		return;
+	if (worker->n_slowest < GCLEANER_STATS_N_SLOWEST_DIRS)
+		worker->n_slowest++;
+	for (i = worker->n_slowest - 1; i > 0 && worker->slowest_times[i - 1] < time; i--) {
+		worker->slowest_dirs[i] = worker->slowest_dirs[i - 1];
+		worker->slowest_times[i] = worker->slowest_times[i - 1];
+	}
+	worker->slowest_dirs[i] = dir;
+	worker->slowest_times[i] = time;
 }
 
-gboolean
-gconf_cleaner_update(GConfCleaner  *gcleaner,
-		     GError       **error)
+static void
+_gconf_cleaner_worker_merge(GConfCleanerWorker *worker,
+			    GConfCleanerWorker *from)
 {
-	g_return_val_if_fail (gcleaner != NULL, FALSE);
-	g_return_val_if_fail (error != NULL, FALSE);
+	guint i;
 
-	if (G_UNLIKELY (*error != NULL)) {
-		g_error_free(*error);
-		*error = NULL;
+	worker->n_pairs += from->n_pairs;
+	worker->n_unknown_pairs += from->n_unknown_pairs;
+	worker->n_schema_lookups += from->n_schema_lookups;
+	worker->n_schema_hits += from->n_schema_hits;
+	worker->n_cache_hits += from->n_cache_hits;
+	for (i = 0; i < GCLEANER_N_CALLS; i++)
+		worker->n_calls[i] += from->n_calls[i];
+	for (i = 0; i < from->n_slowest; i++)
+		_gconf_cleaner_worker_add_time(worker, from->slowest_dirs[i], from->slowest_times[i]);
+}
+
+static gdouble
+_gconf_cleaner_cpu_time(void)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+		return 0.0;
+
+	return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1000000.0 +
+		ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1000000.0;
+}
+
+/* the phases may be nested. only the outermost one is counted */
+static void
+_gconf_cleaner_phase_begin(GConfCleaner *gcleaner)
+{
+	if (gcleaner->phase_depth++ > 0)
+		return;
+	g_timer_start(gcleaner->phase_timer);
+	gcleaner->phase_cpu_time = _gconf_cleaner_cpu_time();
+	memcpy(gcleaner->phase_calls, gcleaner->worker.n_calls, sizeof (gcleaner->phase_calls));
+}
+
+static void
+_gconf_cleaner_phase_end(GConfCleaner      *gcleaner,
+			 GConfCleanerPhase  phase)
+{
+	GConfCleanerPhaseStats *stats = &gcleaner->stats.phases[phase];
+	guint i;
+
+	if (--gcleaner->phase_depth > 0)
+		return;
+	stats->wall_time += g_timer_elapsed(gcleaner->phase_timer, NULL);
+	stats->cpu_time += _gconf_cleaner_cpu_time() - gcleaner->phase_cpu_time;
+	for (i = 0; i < GCLEANER_N_CALLS; i++)
+		stats->n_calls[i] += gcleaner->worker.n_calls[i] - gcleaner->phase_calls[i];
+}
+
+static void
+_gconf_cleaner_stats_clear(GConfCleanerStats *stats)
+{
+	guint i;
+
+	for (i = 0; i < stats->n_slowest_dirs; i++)
+		g_free(stats->slowest_dirs[i]);
+	memset(stats, 0, sizeof (GConfCleanerStats));
+}
+
+static gboolean
+_gconf_cleaner_has_schema(GConfCleaner       *gcleaner,
+			  GConfCleanerWorker *worker,
+			  const gchar        *schema_name)
+{
+	GConfSchema *schema;
+	GError *err = NULL;
+	gpointer found;
+
+	/* the index is read-only while analyzing. no need to lock */
+	if (gcleaner->schema_index && g_str_has_prefix(schema_name, "/schemas/"))
+		return g_hash_table_lookup(gcleaner->schema_index, schema_name) != NULL;
+	worker->n_schema_lookups++;
+	/* the missing schemas are cached as well as the found ones */
+	if (g_hash_table_lookup_extended(worker->schemas, schema_name, NULL, &found)) {
+		worker->n_schema_hits++;
+		return GPOINTER_TO_UINT (found);
 	}
-	gcleaner->n_dirs = gcleaner->n_pairs = gcleaner->n_unknown_pairs = 0;
-	gcleaner->dirs = _gconf_cleaner_all_dirs_recursively(gcleaner, "/", NULL, error);
-	gcleaner->current_dir = gcleaner->dirs;
-	gcleaner->initialized = TRUE;
+	worker->n_calls[GCLEANER_CALL_GET_SCHEMA]++;
+	if (gcleaner->xml) {
+		gboolean retval = gconf_cleaner_xml_source_has_schema(gcleaner->xml, schema_name);
 
-	return *error == NULL;
+		g_hash_table_insert(worker->schemas, g_strdup(schema_name),
+				    GUINT_TO_POINTER (retval));
+
+		return retval;
+	}
+	schema = gconf_engine_get_schema(gcleaner->gconf, schema_name, &err);
+	if (G_UNLIKELY (err != NULL)) {
+		/* don't remember a result that may be temporary */
+		g_error_free(err);
+		return FALSE;
+	}
+	g_hash_table_insert(worker->schemas, g_strdup(schema_name),
+			    GUINT_TO_POINTER (schema != NULL));
+	if (schema) {
+		gconf_schema_free(schema);
+		return TRUE;
+	}
+
+	return FALSE;
 }
 
-guint
-gconf_cleaner_n_dirs(GConfCleaner *gcleaner)
+static void
+_gconf_cleaner_schema_index_add_dir(GConfCleaner  *gcleaner,
+				    const gchar   *path,
+				    GError       **error)
 {
-	g_return_val_if_fail (gcleaner != NULL, 0);
+	GSList *entries, *subdirs, *l;
+	GError *err = NULL;
 
-	return gcleaner->n_dirs;
+	entries = _gconf_cleaner_all_entries(gcleaner, &gcleaner->worker, path, &err);
+	if (G_UNLIKELY (err != NULL)) {
+		g_set_error(error, 0, 0,
+			    N_("Failed to get the entries in `%s': %s"),
+			    path, err->message);
+		g_error_free(err);
+		return;
+	}
+	for (l = entries; l != NULL; l = g_slist_next(l)) {
+		GConfEntry *entry = l->data;
+		/* the direct reader doesn't give the schema values. the key is enough */
+		gchar *key = g_strdup(gconf_entry_get_key(entry));
+
+		g_hash_table_replace(gcleaner->schema_index, key, key);
+		gconf_entry_free(entry);
+	}
+	g_slist_free(entries);
+
+	subdirs = _gconf_cleaner_all_dirs(gcleaner, &gcleaner->worker, path, &err);
+	if (G_UNLIKELY (err != NULL)) {
+		g_set_error(error, 0, 0,
+			    N_("Failed to get the directories in `%s': %s"),
+			    path, err->message);
+		g_error_free(err);
+		return;
+	}
+	for (l = subdirs; l != NULL; l = g_slist_next(l)) {
+		if (*error == NULL)
+			_gconf_cleaner_schema_index_add_dir(gcleaner, l->data, error);
+		g_free(l->data);
+	}
+	g_slist_free(subdirs);
 }
 
-guint
-gconf_cleaner_n_pairs(GConfCleaner *gcleaner)
+/* read all of the schemas at once instead of looking them up one by one */
+static gboolean
+_gconf_cleaner_schema_index_build(GConfCleaner  *gcleaner,
+				  GError       **error)
 {
-	g_return_val_if_fail (gcleaner != NULL, 0);
+	GTimer *timer = g_timer_new();
 
-	return gcleaner->n_pairs;
+	if (gcleaner->schema_index)
+		g_hash_table_destroy(gcleaner->schema_index);
+	gcleaner->schema_index = g_hash_table_new_full(g_str_hash, g_str_equal,
+						       g_free, NULL);
+	_gconf_cleaner_schema_index_add_dir(gcleaner, "/schemas", error);
+	gcleaner->schema_index_time = g_timer_elapsed(timer, NULL);
+	g_timer_destroy(timer);
+	if (*error != NULL) {
+		/* looking up one by one still works */
+		g_hash_table_destroy(gcleaner->schema_index);
+		gcleaner->schema_index = NULL;
+		return FALSE;
+	}
+
+	return TRUE;
 }
 
-guint
-gconf_cleaner_n_unknown_pairs(GConfCleaner *gcleaner)
+static gboolean
+_gconf_cleaner_store_pair(const gchar *key,
+			  GConfValue  *value,
+			  guint        dir,
+			  const gchar *path,
+			  gpointer     data)
 {
-	g_return_val_if_fail (gcleaner != NULL, 0);
+	GConfCleanerStore *store = data;
+	GConfCleanerPair pair;
+	const gchar *p = strrchr(key, '/');
+
+	p = p ? p + 1 : key;
+	/* the threads keep their own names so they never wait for each other */
+	if (store->block)
+		pair.name = _gconf_cleaner_names_insert(store->block->names,
+							store->block->names_table,
+							p, NULL);
+	else
+		pair.name = _gconf_cleaner_result_intern(store->result, p);
+	pair.value = gconf_value_copy(value);
+	if (store->block)
+		store->block->values_size += _gconf_cleaner_value_size(pair.value);
+	else
+		store->result->values_size += _gconf_cleaner_value_size(pair.value);
+	pair.dir = dir;
+	g_array_append_val(store->pairs, pair);
 
-	return gcleaner->n_unknown_pairs;
+	return TRUE;
 }
 
-GSList *
-gconf_cleaner_get_unknown_pairs_at_current_dir(GConfCleaner  *gcleaner,
-					       GError       **error)
+static gboolean
+_gconf_cleaner_foreach_pair(const gchar *key,
+			    GConfValue  *value,
+			    guint        dir,
+			    const gchar *path,
+			    gpointer     data)
+{
+	GConfCleanerForeach *foreach = data;
+
+	if (!foreach->func(key, value, path, foreach->user_data))
+		foreach->stopped = TRUE;
+
+	return !foreach->stopped;
+}
+
+/*
+ * @func is called for each unknown pair with the key and the value that
+ * is owned by the entry.  the rest of the entries are just discarded
+ * once @func returns FALSE.
+ */
+static gboolean
+_gconf_cleaner_analyze_dir(GConfCleaner           *gcleaner,
+			   GConfCleanerWorker     *worker,
+			   guint                   dir,
+			   GConfCleanerVisitFunc   func,
+			   gpointer                data,
+			   GError                **error)
 {
-	GSList *pairs, *l, *retval = NULL;
+	GConfCleanerDir *d = &g_array_index(gcleaner->result.dirs, GConfCleanerDir, dir);
 	const gchar *path;
+	GSList *pairs, *l;
 	GError *err = NULL;
+	gboolean stopped = FALSE, has_stamp = FALSE;
+	guint64 mtime = 0, size = 0;
+	guint n_pairs = worker->n_pairs, n_unknown_pairs = worker->n_unknown_pairs;
 
-	g_return_val_if_fail (gcleaner != NULL, NULL);
-	g_return_val_if_fail (error != NULL, NULL);
+	g_timer_start(worker->timer);
+	_gconf_cleaner_result_build_path(&gcleaner->result, dir, worker->path);
+	path = worker->path->str;
+	/* the scan cache can be used only when the files are known */
+	if (gcleaner->cache && gcleaner->xml)
+		has_stamp = gconf_cleaner_xml_source_get_stamp(gcleaner->xml, path,
+								&mtime, &size);
+	if (has_stamp) {
+		guint n, n_unknown;
 
-	if (G_UNLIKELY (*error != NULL)) {
-		g_error_free(*error);
-		*error = NULL;
+		/* the values are still needed if there are any unknown pairs */
+		if (gconf_cleaner_cache_lookup(gcleaner->cache, path, mtime, size,
+					       &n, &n_unknown) &&
+		    n_unknown == 0) {
+			worker->n_pairs += n;
+			worker->n_cache_hits++;
+			/* the lists aren't known without reading them */
+			d->n_pairs = n;
+			gconf_cleaner_cache_store(gcleaner->cache, path, mtime, size,
+						  n, n_unknown);
+			return TRUE;
+		}
 	}
-	path = gcleaner->current_dir->data;
-	gcleaner->current_dir = g_slist_next(gcleaner->current_dir);
-	pairs = gconf_engine_all_entries(gcleaner->gconf, path, &err);
+
+	pairs = _gconf_cleaner_all_entries(gcleaner, worker, path, &err);
 	if (G_UNLIKELY (err != NULL)) {
 		g_set_error(error, 0, 0,
 			    N_("Failed to get the entries in `%s': %s"),
 			    path, err->message);
 		g_error_free(err);
-		return NULL;
+		return FALSE;
 	}
 	for (l = pairs; l != NULL; l = g_slist_next(l)) {
-		GConfEntry *pair = l->data;
-		const gchar *schema_name = gconf_entry_get_schema_name(pair);
-		GConfSchema *schema = NULL;
+		GConfEntry *entry = l->data;
+		const gchar *schema_name = gconf_entry_get_schema_name(entry);
 
-		gcleaner->n_pairs++;
-		if (schema_name) {
-			schema = gconf_engine_get_schema(gcleaner->gconf, schema_name, &err);
-		} else {
-			schema = NULL;
+		if (stopped) {
+			gconf_entry_free(entry);
+			continue;
 		}
-		if (!schema) {
-			GConfValue *v = gconf_entry_get_value(pair);
+		worker->n_pairs++;
+		d->n_pairs++;
+		if (gconf_entry_get_value(entry) &&
+		    gconf_entry_get_value(entry)->type == GCONF_VALUE_LIST) {
+			guint length = g_slist_length(gconf_value_get_list(gconf_entry_get_value(entry)));
+
+			d->max_list_length = MAX (d->max_list_length, length);
+		}
+		if (!schema_name ||
+		    !_gconf_cleaner_has_schema(gcleaner, worker, schema_name)) {
+			GConfValue *v = gconf_entry_get_value(entry);
 
 			if (v) {
-				gcleaner->n_unknown_pairs++;
-				retval = g_slist_append(retval, g_strdup(gconf_entry_get_key(pair)));
-				retval = g_slist_append(retval, gconf_value_copy(v));
+				gchar *text = gconf_value_to_string(v);
+
+				worker->n_unknown_pairs++;
+				d->n_unknown_pairs++;
+				d->unknown_size += strlen(text);
+				g_free(text);
+				stopped = !func(gconf_entry_get_key(entry), v, dir, path, data);
 			} else {
-				g_warning(_("No value for a key `%s'"), gconf_entry_get_key(pair));
+				g_warning(_("No value for a key `%s'"), gconf_entry_get_key(entry));
 			}
 		}
-		gconf_entry_free(pair);
+		gconf_entry_free(entry);
 	}
 	if (G_LIKELY (pairs))
 		g_slist_free(pairs);
+	if (has_stamp && !stopped)
+		gconf_cleaner_cache_store(gcleaner->cache, path, mtime, size,
+					  worker->n_pairs - n_pairs,
+					  worker->n_unknown_pairs - n_unknown_pairs);
+	_gconf_cleaner_worker_add_time(worker, dir, g_timer_elapsed(worker->timer, NULL));
 
-	return retval;
+	return TRUE;
 }
 
-const gchar *
-gconf_cleaner_get_current_dir(GConfCleaner *gcleaner)
+static gpointer
+_gconf_cleaner_analysis_thread(gpointer data)
 {
-	g_return_val_if_fail (gcleaner != NULL, NULL);
-	g_return_val_if_fail (gcleaner->current_dir != NULL, NULL);
+	GConfCleanerThread *thread = data;
+	GConfCleanerPool *pool = thread->pool;
+	gint i;
+
+	/* the only thing shared between the threads is the block counter */
+	while (!g_atomic_int_get(&pool->failed) &&
+	       (i = g_atomic_int_exchange_and_add(&pool->next_block, 1)) < pool->n_blocks) {
+		GConfCleanerBlock *block = &pool->blocks[i];
+		GConfCleanerStore store;
+		guint j;
+
+		block->pairs = g_array_new(FALSE, FALSE, sizeof (GConfCleanerPair));
+		block->names = g_string_chunk_new(1024);
+		block->names_table = g_hash_table_new(g_str_hash, g_str_equal);
+		store.result = &pool->gcleaner->result;
+		store.block = block;
+		store.pairs = block->pairs;
+		for (j = 0; j < block->n_dirs; j++) {
+			if (!_gconf_cleaner_analyze_dir(pool->gcleaner,
+							&thread->worker,
+							block->first_dir + j,
+							_gconf_cleaner_store_pair,
+							&store,
+							&block->error)) {
+				g_atomic_int_set(&pool->failed, TRUE);
+				break;
+			}
+		}
+	}
 
-	return gcleaner->current_dir->data;
+	return NULL;
 }
 
-void
-gconf_cleaner_pairs_free(GSList *list)
+/* count @key once even if the backup has it more than once */
+static void
+_gconf_cleaner_restore_done(GConfCleanerRestore *restore,
+			    const gchar         *key)
 {
-	GSList *l;
+	if (g_hash_table_lookup(restore->restored, key) == NULL) {
+		g_hash_table_insert(restore->restored, g_strdup(key), GINT_TO_POINTER (TRUE));
+		restore->n_restored++;
+	}
+}
 
-	g_return_if_fail (list != NULL);
+static void
+_gconf_cleaner_restore_flush(GConfCleanerRestore *restore)
+{
+	GConfCleaner *gcleaner = restore->gcleaner;
+	GConfValue *value;
+	GError *error = NULL;
+	guint i;
 
-	for (l = list; l != NULL; l = g_slist_next(l)) {
-		g_free(l->data);
-		l = g_slist_next(l);
-		gconf_value_free(l->data);
+	if (restore->keys->len == 0)
+		return;
+	if (gconf_engine_commit_change_set(gcleaner->gconf, restore->cs, TRUE, &error)) {
+		for (i = 0; i < restore->keys->len; i++)
+			_gconf_cleaner_restore_done(restore, g_ptr_array_index(restore->keys, i));
+	} else {
+		/* the committed keys are gone from the set. try the rest one by one */
+		g_clear_error(&error);
+		for (i = 0; i < restore->keys->len; i++) {
+			const gchar *key = g_ptr_array_index(restore->keys, i);
+
+			if (gconf_change_set_check_value(restore->cs, key, &value) &&
+			    !gconf_engine_set(gcleaner->gconf, key, value, &error)) {
+				g_warning(_("Failed to restore %s: %s"), key, error->message);
+				g_clear_error(&error);
+				restore->n_failed++;
+			} else {
+				_gconf_cleaner_restore_done(restore, key);
+			}
+		}
 	}
-	g_slist_free(list);
+	gconf_change_set_clear(restore->cs);
+	for (i = 0; i < restore->keys->len; i++)
+		g_free(g_ptr_array_index(restore->keys, i));
+	g_ptr_array_set_size(restore->keys, 0);
 }
 
-void
-gconf_cleaner_unset_key(GConfCleaner  *gcleaner,
-			const gchar   *key,
-			GError       **error)
+static gboolean
+_gconf_cleaner_restore_entry(const gchar *key,
+			     GConfValue  *value,
+			     gpointer     data)
 {
-	g_return_if_fail (gcleaner != NULL);
-	g_return_if_fail (key != NULL);
+	GConfCleanerRestore *restore = data;
 
-	gconf_engine_unset(gcleaner->gconf, key, error);
+	if (value == NULL || !gconf_valid_key(key, NULL)) {
+		restore->n_skipped++;
+		return TRUE;
+	}
+	/* the last one wins as with gconftool-2 --load */
+	if (gconf_change_set_check_value(restore->cs, key, NULL)) {
+		gconf_change_set_set(restore->cs, key, value);
+		return TRUE;
+	}
+	gconf_change_set_set(restore->cs, key, value);
+	g_ptr_array_add(restore->keys, g_strdup(key));
+	if (restore->keys->len >= restore->gcleaner->unset_batch_size)
+		_gconf_cleaner_restore_flush(restore);
+
+	return TRUE;
 }
 
-void
-gconf_cleaner_sync(GConfCleaner  *gcleaner,
-		   GError       **error)
+/* analyze @n_dirs directories from the current one with @n_threads threads */
+static void
+_gconf_cleaner_analyze_dirs(GConfCleaner  *gcleaner,
+			    guint          n_dirs,
+			    guint          n_threads,
+			    GError       **error)
 {
-	g_return_if_fail (gcleaner != NULL);
+	GConfCleanerPool pool;
+	GConfCleanerThread *threads;
+	guint block_size, i;
+	gint j;
 
-	gconf_engine_suggest_sync(gcleaner->gconf, error);
+	n_threads = MIN (n_threads, n_dirs);
+	memset(&pool, 0, sizeof (GConfCleanerPool));
+	pool.gcleaner = gcleaner;
+	block_size = MAX (n_dirs / (n_threads * GCLEANER_BLOCKS_PER_THREAD), 1);
+	pool.n_blocks = (n_dirs + block_size - 1) / block_size;
+	pool.blocks = g_new0(GConfCleanerBlock, pool.n_blocks);
+	for (j = 0; j < pool.n_blocks; j++) {
+		pool.blocks[j].first_dir = gcleaner->current_dir + j * block_size;
+		pool.blocks[j].n_dirs = MIN (block_size, n_dirs - j * block_size);
+	}
+
+	threads = g_new0(GConfCleanerThread, n_threads);
+	for (i = 0; i < n_threads; i++) {
+		threads[i].pool = &pool;
+		_gconf_cleaner_worker_init(&threads[i].worker);
+	}
+	/* the caller's thread works as the first one */
+	for (i = 1; i < n_threads; i++)
+		threads[i].thread = g_thread_create(_gconf_cleaner_analysis_thread,
+						    &threads[i], TRUE, NULL);
+	_gconf_cleaner_analysis_thread(&threads[0]);
+	for (i = 0; i < n_threads; i++) {
+		GConfCleanerWorker *worker = &threads[i].worker;
+
+		if (threads[i].thread)
+			g_thread_join(threads[i].thread);
+		_gconf_cleaner_worker_merge(&gcleaner->worker, worker);
+		_gconf_cleaner_worker_finalize(worker);
+	}
+	g_free(threads);
+
+	/* the blocks are in order of the directories */
+	for (j = 0; j < pool.n_blocks; j++) {
+		GConfCleanerBlock *block = &pool.blocks[j];
+
+		if (block->error && *error == NULL)
+			g_propagate_error(error, block->error);
+		else if (block->error)
+			g_error_free(block->error);
+		if (block->pairs == NULL)
+			continue;
+		if (*error == NULL) {
+			GConfCleanerResult *result = &gcleaner->result;
+			guint k;
+
+			/* the names point into the block's chunk until here */
+			g_static_mutex_lock(&result->lock);
+			for (k = 0; k < block->pairs->len; k++) {
+				GConfCleanerPair *pair = &g_array_index(block->pairs, GConfCleanerPair, k);
+
+				pair->name = _gconf_cleaner_names_insert(result->names,
+									 result->names_table,
+									 pair->name,
+									 &result->names_size);
+			}
+			g_static_mutex_unlock(&result->lock);
+			result->values_size += block->values_size;
+			g_array_append_vals(result->pairs,
+					    block->pairs->data, block->pairs->len);
+			g_array_free(block->pairs, TRUE);
+		} else {
+			_gconf_cleaner_pairs_clear(block->pairs);
+			g_array_free(block->pairs, TRUE);
+		}
+		g_hash_table_destroy(block->names_table);
+		g_string_chunk_free(block->names);
+	}
+	g_free(pool.blocks);
+	gcleaner->current_dir += n_dirs;
+}
+
+/*
+ * add the pairs found since the last checkpoint to @filename, or write
+ * all of them to the temporary file replacing it if it isn't there yet.
+ */
+static gboolean
+_gconf_cleaner_checkpoint_save_pairs(GConfCleaner  *gcleaner,
+				     const gchar   *filename,
+				     GError       **error)
+{
+	GConfCleanerBackupWriter *writer = NULL;
+	GString *key = g_string_new(NULL);
+	gchar *tmp = NULL;
+	guint i = 0;
+	gboolean retval = TRUE;
+
+	if (gcleaner->n_checkpoint_pairs > 0 &&
+	    gcleaner->n_checkpoint_pairs <= gcleaner->result.pairs->len)
+		writer = gconf_cleaner_backup_writer_append(filename, NULL);
+	if (writer) {
+		i = gcleaner->n_checkpoint_pairs;
+	} else {
+		tmp = g_strconcat(filename, ".tmp", NULL);
+		if ((writer = gconf_cleaner_backup_writer_new(tmp, FALSE, error)) == NULL) {
+			g_free(tmp);
+			g_string_free(key, TRUE);
+			return FALSE;
+		}
+	}
+	for (; retval && i < gcleaner->result.pairs->len; i++) {
+		GConfCleanerPair *pair = &g_array_index(gcleaner->result.pairs, GConfCleanerPair, i);
+
+		_gconf_cleaner_result_build_key(&gcleaner->result, i, key);
+		retval = gconf_cleaner_backup_writer_add(writer, key->str, pair->value, error);
+	}
+	g_string_free(key, TRUE);
+	if (!retval)
+		gconf_cleaner_backup_writer_close(writer, NULL);
+	else
+		retval = gconf_cleaner_backup_writer_close(writer, error);
+	if (retval && tmp && g_rename(tmp, filename) != 0) {
+		g_set_error(error, 0, 0,
+			    _("Failed to rename `%s' to `%s': %s"),
+			    tmp, filename, g_strerror(errno));
+		retval = FALSE;
+	}
+	if (tmp) {
+		if (!retval)
+			g_unlink(tmp);
+		g_free(tmp);
+	}
+	/* start over from the first pair if anything went wrong */
+	gcleaner->n_checkpoint_pairs = retval ? gcleaner->result.pairs->len : 0;
+
+	return retval;
+}
+
+/*
+ * the state is written after the pairs, and only as many pairs as the
+ * state says are read back.  the pairs are only appended while scanning,
+ * so the files are consistent whenever the writing is interrupted.
+ */
+static gboolean
+_gconf_cleaner_checkpoint_save(GConfCleaner  *gcleaner,
+			       GError       **error)
+{
+	GString *dump;
+	gchar *filename;
+	guint i;
+	gboolean retval;
+
+	filename = g_strconcat(gcleaner->checkpoint, ".pairs", NULL);
+	retval = _gconf_cleaner_checkpoint_save_pairs(gcleaner, filename, error);
+	g_free(filename);
+	if (!retval)
+		return FALSE;
+
+	dump = g_string_new(GCLEANER_CHECKPOINT_MAGIC "\n");
+	g_string_append_printf(dump, "analyzed %u %u %u %u\n",
+			       gcleaner->current_dir,
+			       gcleaner->worker.n_pairs,
+			       gcleaner->worker.n_unknown_pairs,
+			       gcleaner->result.pairs->len);
+	for (i = 0; i < gcleaner->result.dirs->len; i++) {
+		GConfCleanerDir *d = &g_array_index(gcleaner->result.dirs, GConfCleanerDir, i);
+
+		g_string_append_printf(dump, "dir %u %u %u %u %" G_GSIZE_FORMAT " %u %s\n",
+				       d->parent, d->n_pairs, d->n_unknown_pairs,
+				       d->max_list_length, d->unknown_size,
+				       d->n_excluded, d->name);
+	}
+	for (i = 0; i < gcleaner->pending->len; i++) {
+		GConfCleanerPending *pending = &g_array_index(gcleaner->pending, GConfCleanerPending, i);
+
+		g_string_append_printf(dump, "pending %u %u %s\n",
+				       pending->parent, pending->depth, pending->path);
+	}
+	retval = g_file_set_contents(gcleaner->checkpoint, dump->str, dump->len, error);
+	g_string_free(dump, TRUE);
+	gcleaner->n_since_checkpoint = 0;
+
+	return retval;
+}
+
+static void
+_gconf_cleaner_checkpoint_remove(GConfCleaner *gcleaner)
+{
+	gchar *filename = g_strconcat(gcleaner->checkpoint, ".pairs", NULL);
+
+	g_unlink(gcleaner->checkpoint);
+	g_unlink(filename);
+	g_free(filename);
+	gcleaner->n_checkpoint_pairs = 0;
+}
+
+/*
+ * called after @n_dirs directories are analyzed successfully.  the
+ * checkpoint isn't needed any more once everything is analyzed.
+ */
+static void
+_gconf_cleaner_checkpoint_tick(GConfCleaner *gcleaner,
+			       guint         n_dirs)
+{
+	GError *err = NULL;
+
+	if (gcleaner->checkpoint == NULL)
+		return;
+	if (gcleaner->current_dir == gcleaner->result.dirs->len &&
+	    gcleaner->pending->len == 0) {
+		_gconf_cleaner_checkpoint_remove(gcleaner);
+		return;
+	}
+	gcleaner->n_since_checkpoint += n_dirs;
+	if (gcleaner->n_since_checkpoint < gcleaner->checkpoint_interval)
+		return;
+	if (!_gconf_cleaner_checkpoint_save(gcleaner, &err)) {
+		g_warning(_("Failed to save the checkpoint: %s"), err->message);
+		g_error_free(err);
+	}
+}
+
+/* the numbers separated by a space. @rest points to what follows them */
+static gboolean
+_gconf_cleaner_checkpoint_parse_numbers(const gchar  *line,
+					guint64      *values,
+					gint          n_values,
+					const gchar **rest)
+{
+	const gchar *p = line;
+	gchar *end;
+	gint i;
+
+	for (i = 0; i < n_values; i++) {
+		values[i] = g_ascii_strtoull(p, &end, 10);
+		if (end == p || (*end != ' ' && *end != 0))
+			return FALSE;
+		p = *end ? end + 1 : end;
+	}
+	if (rest)
+		*rest = p;
+
+	return TRUE;
+}
+
+static gboolean
+_gconf_cleaner_resume_pair(const gchar *key,
+			   GConfValue  *value,
+			   gpointer     data)
+{
+	GConfCleanerResume *resume = data;
+	GConfCleaner *gcleaner = resume->gcleaner;
+	GConfCleanerPair pair;
+	const gchar *p = strrchr(key, '/');
+	gchar *dir;
+	guint index;
+
+	if (gcleaner->result.pairs->len >= resume->n_pairs)
+		return FALSE;
+	dir = p && p != key ? g_strndup(key, p - key) : NULL;
+	index = dir ? GPOINTER_TO_UINT (g_hash_table_lookup(resume->dirs, dir)) : 0;
+	g_free(dir);
+	if (index == 0 || value == NULL) {
+		g_set_error(&resume->error, 0, 0,
+			    _("Invalid key `%s' in the checkpoint"), key);
+		return FALSE;
+	}
+	pair.name = _gconf_cleaner_result_intern(&gcleaner->result, p + 1);
+	pair.value = gconf_value_copy(value);
+	gcleaner->result.values_size += _gconf_cleaner_value_size(pair.value);
+	pair.dir = index - 1;
+	g_array_append_val(gcleaner->result.pairs, pair);
+
+	/* what follows may be cut off by the interrupted checkpoint */
+	return gcleaner->result.pairs->len < resume->n_pairs;
+}
+
+static gboolean
+_gconf_cleaner_checkpoint_load(GConfCleaner  *gcleaner,
+			       const gchar   *filename,
+			       GError       **error)
+{
+	GConfCleanerResume resume;
+	gchar *contents, **lines, *pairs;
+	GString *path = g_string_new(NULL);
+	guint64 values[4];
+	const gchar *rest;
+	gint i;
+	gboolean retval = TRUE;
+
+	if (!g_file_get_contents(filename, &contents, NULL, error))
+		return FALSE;
+	lines = g_strsplit(contents, "\n", -1);
+	g_free(contents);
+	if (lines[0] == NULL || strcmp(lines[0], GCLEANER_CHECKPOINT_MAGIC) != 0 ||
+	    lines[1] == NULL || !g_str_has_prefix(lines[1], "analyzed ") ||
+	    !_gconf_cleaner_checkpoint_parse_numbers(lines[1] + 9, values, 4, NULL)) {
+		g_set_error(error, 0, 0,
+			    _("`%s' isn't a checkpoint of gconf-cleaner"), filename);
+		g_strfreev(lines);
+		g_string_free(path, TRUE);
+		return FALSE;
+	}
+	resume.gcleaner = gcleaner;
+	resume.dirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	resume.n_pairs = (guint)values[3];
+	resume.error = NULL;
+	gcleaner->current_dir = (guint)values[0];
+	gcleaner->worker.n_pairs = (guint)values[1];
+	gcleaner->worker.n_unknown_pairs = (guint)values[2];
+	for (i = 2; retval && lines[i] != NULL; i++) {
+		guint64 v[6];
+
+		if (*lines[i] == 0)
+			continue;
+		if (g_str_has_prefix(lines[i], "dir ") &&
+		    _gconf_cleaner_checkpoint_parse_numbers(lines[i] + 4, v, 6, &rest) &&
+		    *rest != 0 &&
+		    (v[0] == GCLEANER_NO_PARENT || v[0] < gcleaner->result.dirs->len)) {
+			guint dir = _gconf_cleaner_result_add_dir(&gcleaner->result, (guint)v[0], rest);
+			GConfCleanerDir *d = &g_array_index(gcleaner->result.dirs, GConfCleanerDir, dir);
+
+			d->n_pairs = (guint)v[1];
+			d->n_unknown_pairs = (guint)v[2];
+			d->max_list_length = (guint)v[3];
+			d->unknown_size = (gsize)v[4];
+			d->n_excluded = (guint)v[5];
+
+			_gconf_cleaner_result_build_path(&gcleaner->result, dir, path);
+			g_hash_table_insert(resume.dirs, g_strdup(path->str), GUINT_TO_POINTER (dir + 1));
+		} else if (g_str_has_prefix(lines[i], "pending ") &&
+			   _gconf_cleaner_checkpoint_parse_numbers(lines[i] + 8, v, 2, &rest) &&
+			   *rest == '/' &&
+			   (v[0] == GCLEANER_NO_PARENT || v[0] < gcleaner->result.dirs->len)) {
+			_gconf_cleaner_pending_push(gcleaner, (guint)v[0], (guint)v[1], g_strdup(rest));
+		} else {
+			g_set_error(error, 0, 0,
+				    _("Invalid line %d in the checkpoint `%s'"),
+				    i + 1, filename);
+			retval = FALSE;
+		}
+	}
+	g_strfreev(lines);
+	g_string_free(path, TRUE);
+	if (retval && gcleaner->current_dir > gcleaner->result.dirs->len) {
+		g_set_error(error, 0, 0,
+			    _("Invalid line %d in the checkpoint `%s'"),
+			    2, filename);
+		retval = FALSE;
+	}
+	if (retval && resume.n_pairs > 0) {
+		GError *err = NULL;
+
+		pairs = g_strconcat(filename, ".pairs", NULL);
+		gconf_cleaner_backup_read(pairs, _gconf_cleaner_resume_pair, &resume, &err);
+		g_free(pairs);
+		if (resume.error) {
+			g_clear_error(&err);
+			err = resume.error;
+		} else if (err == NULL && gcleaner->result.pairs->len < resume.n_pairs) {
+			g_set_error(&err, 0, 0,
+				    _("Some of the keys are missing in the checkpoint `%s'"),
+				    filename);
+		}
+		if (err) {
+			g_propagate_error(error, err);
+			retval = FALSE;
+		}
+	}
+	g_hash_table_destroy(resume.dirs);
+
+	return retval;
+}
+
+/* the heaviest first, and in order of the traversal for the same weight */
+static gint
+_gconf_cleaner_footprint_compare(gconstpointer a,
+				 gconstpointer b,
+				 gpointer      data)
+{
+	GArray *dirs = data;
+	guint ia = *(const guint *)a, ib = *(const guint *)b;
+	const GConfCleanerDir *da = &g_array_index(dirs, GConfCleanerDir, ia);
+	const GConfCleanerDir *db = &g_array_index(dirs, GConfCleanerDir, ib);
+
+	if (da->unknown_size != db->unknown_size)
+		return da->unknown_size > db->unknown_size ? -1 : 1;
+	if (da->n_unknown_pairs != db->n_unknown_pairs)
+		return da->n_unknown_pairs > db->n_unknown_pairs ? -1 : 1;
+	if (da->n_pairs != db->n_pairs)
+		return da->n_pairs > db->n_pairs ? -1 : 1;
+	if (da->max_list_length != db->max_list_length)
+		return da->max_list_length > db->max_list_length ? -1 : 1;
+
+	return ia < ib ? -1 : (ia > ib ? 1 : 0);
+}
+
+static void
+_gconf_cleaner_reset_result(GConfCleaner *gcleaner)
+{
+	_gconf_cleaner_pending_clear(gcleaner);
+	_gconf_cleaner_result_clear(&gcleaner->result);
+	gcleaner->current_dir = 0;
+	gcleaner->worker.n_pairs = gcleaner->worker.n_unknown_pairs = 0;
+	gcleaner->worker.n_schema_lookups = gcleaner->worker.n_schema_hits = 0;
+	gcleaner->worker.n_cache_hits = 0;
+	gcleaner->worker.n_slowest = 0;
+	gcleaner->initialized = FALSE;
+	gcleaner->depth = 0;
+	gcleaner->n_since_checkpoint = 0;
+	gcleaner->n_checkpoint_pairs = 0;
+}
+
+static void
+_gconf_cleaner_reset(GConfCleaner *gcleaner)
+{
+	_gconf_cleaner_reset_result(gcleaner);
+	g_hash_table_remove_all(gcleaner->worker.schemas);
+	_gconf_cleaner_stats_clear(&gcleaner->stats);
+	if (gcleaner->use_schema_index) {
+		GError *err = NULL;
+
+		if (!_gconf_cleaner_schema_index_build(gcleaner, &err)) {
+			g_warning(_("Failed to build the schema index: %s"), err->message);
+			g_error_free(err);
+		}
+	}
+}
+
+static GConfCleaner *
+_gconf_cleaner_new_with_engine(GConfEngine *gconf)
+{
+	GConfCleaner *retval = g_new0(GConfCleaner, 1);
+
+	retval->gconf = gconf;
+	retval->n_threads = 1;
+	retval->unset_batch_size = GCLEANER_UNSET_BATCH_SIZE;
+	retval->exclude = gconf_cleaner_exclude_new();
+	gconf_cleaner_exclude_add_defaults(retval->exclude);
+	_gconf_cleaner_result_init(&retval->result);
+	_gconf_cleaner_worker_init(&retval->worker);
+	retval->current_path = g_string_new(NULL);
+	retval->phase_timer = g_timer_new();
+	retval->pending = g_array_new(FALSE, FALSE, sizeof (GConfCleanerPending));
+
+	return retval;
+}
+
+/*
+ * Public Functions
+ */
+GConfCleaner *
+gconf_cleaner_new(void)
+{
+	GConfEngine *gconf = gconf_engine_get_default();
+
+	g_return_val_if_fail (gconf != NULL, NULL);
+
+	return _gconf_cleaner_new_with_engine(gconf);
+}
+
+/*
+ * create the cleaner working on the configuration source @address only,
+ * instead of the default ones, e.g. "xml:readwrite:/path/to/tree".
+ */
+GConfCleaner *
+gconf_cleaner_new_for_address(const gchar  *address,
+			      GError      **error)
+{
+	GConfEngine *gconf;
+
+	g_return_val_if_fail (address != NULL, NULL);
+
+	if ((gconf = gconf_engine_get_for_address(address, error)) == NULL)
+		return NULL;
+
+	return _gconf_cleaner_new_with_engine(gconf);
+}
+
+/*
+ * same as gconf_cleaner_new_for_address() but with the sources of
+ * @addresses, in order of priority.
+ */
+GConfCleaner *
+gconf_cleaner_new_for_addresses(const gchar * const  *addresses,
+				GError              **error)
+{
+	GConfEngine *gconf;
+	GSList *list = NULL;
+	gint i;
+
+	g_return_val_if_fail (addresses != NULL && addresses[0] != NULL, NULL);
+
+	for (i = 0; addresses[i] != NULL; i++)
+		list = g_slist_append(list, (gpointer)addresses[i]);
+	gconf = gconf_engine_get_for_addresses(list, error);
+	g_slist_free(list);
+	if (gconf == NULL)
+		return NULL;
+
+	return _gconf_cleaner_new_with_engine(gconf);
+}
+
+/*
+ * create the cleaner reading the xml: sources of @addresses, or the ones
+ * in the GConf path file if it's NULL, directly without any connection
+ * to gconfd.  it can be used in any thread.  the keys can only be
+ * unset with gconf_cleaner_unset_keys_offline() and never restored.
+ */
+GConfCleaner *
+gconf_cleaner_new_for_sources(const gchar * const  *addresses,
+			      GError              **error)
+{
+	GConfCleaner *retval;
+	GConfCleanerXmlSource *xml;
+
+	if ((xml = gconf_cleaner_xml_source_new(addresses, error)) == NULL)
+		return NULL;
+	retval = _gconf_cleaner_new_with_engine(NULL);
+	retval->xml = xml;
+
+	return retval;
+}
+
+void
+gconf_cleaner_free(GConfCleaner *gcleaner)
+{
+	g_return_if_fail (gcleaner != NULL);
+
+	if (gcleaner->gconf)
+		gconf_engine_unref(gcleaner->gconf);
+	if (gcleaner->xml)
+		gconf_cleaner_xml_source_free(gcleaner->xml);
+	if (gcleaner->cache)
+		gconf_cleaner_cache_free(gcleaner->cache);
+	gconf_cleaner_exclude_free(gcleaner->exclude);
+	if (gcleaner->schema_index)
+		g_hash_table_destroy(gcleaner->schema_index);
+	_gconf_cleaner_result_finalize(&gcleaner->result);
+	_gconf_cleaner_worker_finalize(&gcleaner->worker);
+	g_string_free(gcleaner->current_path, TRUE);
+	_gconf_cleaner_stats_clear(&gcleaner->stats);
+	g_timer_destroy(gcleaner->phase_timer);
+	_gconf_cleaner_pending_clear(gcleaner);
+	g_array_free(gcleaner->pending, TRUE);
+	g_free(gcleaner->checkpoint);
+	g_free(gcleaner);
+}
+
+/*
+ * read the configuration sources straight from the files instead of
+ * asking gconfd.  if @addresses is NULL, the GConf path file is used.
+ * FALSE is returned and the engine keeps being used when any of them
+ * isn't readable.
+ */
+gboolean
+gconf_cleaner_set_sources(GConfCleaner         *gcleaner,
+			  const gchar * const  *addresses,
+			  GError              **error)
+{
+	GConfCleanerXmlSource *xml;
+
+	g_return_val_if_fail (gcleaner != NULL, FALSE);
+
+	xml = gconf_cleaner_xml_source_new(addresses, error);
+	if (xml == NULL)
+		return FALSE;
+	if (gcleaner->xml)
+		gconf_cleaner_xml_source_free(gcleaner->xml);
+	gcleaner->xml = xml;
+
+	return TRUE;
+}
+
+gboolean
+gconf_cleaner_is_initialized(GConfCleaner *gcleaner)
+{
+	return gcleaner->initialized;
+}
+
+gboolean
+gconf_cleaner_update(GConfCleaner  *gcleaner,
+		     GError       **error)
+{
+	g_return_val_if_fail (gcleaner != NULL, FALSE);
+	g_return_val_if_fail (error != NULL, FALSE);
+
+	if (G_UNLIKELY (*error != NULL)) {
+		g_error_free(*error);
+		*error = NULL;
+	}
+	_gconf_cleaner_phase_begin(gcleaner);
+	gconf_cleaner_traverse_begin(gcleaner);
+	while (gconf_cleaner_traverse_step(gcleaner, error));
+	_gconf_cleaner_phase_end(gcleaner, GCLEANER_PHASE_TRAVERSAL);
+
+	return *error == NULL;
+}
+
+/*
+ * start over the traversal of the directories.  the result is cleared and
+ * the directories are added one by one by gconf_cleaner_traverse_step().
+ * they can be analyzed as soon as they are added.
+ */
+void
+gconf_cleaner_traverse_begin(GConfCleaner *gcleaner)
+{
+	g_return_if_fail (gcleaner != NULL);
+
+	_gconf_cleaner_phase_begin(gcleaner);
+	_gconf_cleaner_reset(gcleaner);
+	_gconf_cleaner_pending_push(gcleaner, GCLEANER_NO_PARENT, 0, g_strdup("/"));
+	_gconf_cleaner_phase_end(gcleaner, GCLEANER_PHASE_TRAVERSAL);
+}
+
+/*
+ * keep the state of the scan in @filename every @interval directories
+ * analyzed, so that it can be continued with gconf_cleaner_resume() when
+ * it's interrupted.  the keys found so far are written to @filename.pairs.
+ * both files are removed when all of the directories are analyzed.
+ * @filename may be NULL to stop checkpointing.
+ */
+void
+gconf_cleaner_set_checkpoint(GConfCleaner *gcleaner,
+			     const gchar  *filename,
+			     guint         interval)
+{
+	g_return_if_fail (gcleaner != NULL);
+
+	g_free(gcleaner->checkpoint);
+	gcleaner->checkpoint = g_strdup(filename);
+	gcleaner->checkpoint_interval = MAX (interval, 1);
+	gcleaner->n_since_checkpoint = 0;
+	gcleaner->n_checkpoint_pairs = 0;
+}
+
+gboolean
+gconf_cleaner_save_checkpoint(GConfCleaner  *gcleaner,
+			      GError       **error)
+{
+	g_return_val_if_fail (gcleaner != NULL, FALSE);
+
+	if (gcleaner->checkpoint == NULL)
+		return TRUE;
+
+	return _gconf_cleaner_checkpoint_save(gcleaner, error);
+}
+
+/*
+ * start over the scan from the checkpoint in @filename instead of
+ * gconf_cleaner_traverse_begin().  the rest of the directories are
+ * traversed and analyzed as usual, and the result is the same as the
+ * uninterrupted scan with the same sources and exclusion rules.
+ */
+gboolean
+gconf_cleaner_resume(GConfCleaner  *gcleaner,
+		     const gchar   *filename,
+		     GError       **error)
+{
+	gboolean retval;
+
+	g_return_val_if_fail (gcleaner != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	_gconf_cleaner_phase_begin(gcleaner);
+	_gconf_cleaner_reset(gcleaner);
+	retval = _gconf_cleaner_checkpoint_load(gcleaner, filename, error);
+	_gconf_cleaner_phase_end(gcleaner, GCLEANER_PHASE_TRAVERSAL);
+	if (!retval)
+		_gconf_cleaner_reset_result(gcleaner);
+	else if (gcleaner->pending->len == 0)
+		gcleaner->initialized = TRUE;
+
+	return retval;
+}
+
+/*
+ * visit one directory.  returns FALSE when there are no more directories
+ * to visit or @error is set.  the pending directories are dropped on
+ * error so that the traversal is finished anyway.
+ */
+gboolean
+gconf_cleaner_traverse_step(GConfCleaner  *gcleaner,
+			    GError       **error)
+{
+	gboolean retval;
+
+	g_return_val_if_fail (gcleaner != NULL, FALSE);
+
+	if (gcleaner->pending->len == 0)
+		return FALSE;
+	_gconf_cleaner_phase_begin(gcleaner);
+	retval = _gconf_cleaner_traverse_dir(gcleaner, error);
+	_gconf_cleaner_phase_end(gcleaner, GCLEANER_PHASE_TRAVERSAL);
+	if (!retval)
+		_gconf_cleaner_pending_clear(gcleaner);
+	if (gcleaner->pending->len == 0)
+		gcleaner->initialized = TRUE;
+
+	return retval && gcleaner->pending->len > 0;
+}
+
+/*
+ * stop the traversal.  the directories found so far are kept in the result.
+ */
+void
+gconf_cleaner_traverse_cancel(GConfCleaner *gcleaner)
+{
+	g_return_if_fail (gcleaner != NULL);
+
+	_gconf_cleaner_pending_clear(gcleaner);
+}
+
+gboolean
+gconf_cleaner_traverse_is_finished(GConfCleaner *gcleaner)
+{
+	g_return_val_if_fail (gcleaner != NULL, TRUE);
+
+	return gcleaner->pending->len == 0;
+}
+
+/*
+ * the depth of the directory visited last.  the toplevel ones are 1.
+ */
+guint
+gconf_cleaner_traverse_get_depth(GConfCleaner *gcleaner)
+{
+	g_return_val_if_fail (gcleaner != NULL, 0);
+
+	return gcleaner->depth;
+}
+
+/*
+ * the number of the directories found but not visited yet.
+ */
+guint
+gconf_cleaner_traverse_n_pending(GConfCleaner *gcleaner)
+{
+	g_return_val_if_fail (gcleaner != NULL, 0);
+
+	return gcleaner->pending->len;
+}
+
+guint
+gconf_cleaner_n_dirs(GConfCleaner *gcleaner)
+{
+	g_return_val_if_fail (gcleaner != NULL, 0);
+
+	return gcleaner->result.dirs->len;
+}
+
+guint
+gconf_cleaner_n_analyzed_dirs(GConfCleaner *gcleaner)
+{
+	g_return_val_if_fail (gcleaner != NULL, 0);
+
+	return gcleaner->current_dir;
+}
+
+guint
+gconf_cleaner_n_pairs(GConfCleaner *gcleaner)
+{
+	g_return_val_if_fail (gcleaner != NULL, 0);
+
+	return gcleaner->worker.n_pairs;
+}
+
+guint
+gconf_cleaner_n_unknown_pairs(GConfCleaner *gcleaner)
+{
+	g_return_val_if_fail (gcleaner != NULL, 0);
+
+	return gcleaner->worker.n_unknown_pairs;
+}
+
+guint
+gconf_cleaner_n_schema_lookups(GConfCleaner *gcleaner)
+{
+	g_return_val_if_fail (gcleaner != NULL, 0);
+
+	return gcleaner->worker.n_schema_lookups;
+}
+
+guint
+gconf_cleaner_n_schema_cache_hits(GConfCleaner *gcleaner)
+{
+	g_return_val_if_fail (gcleaner != NULL, 0);
+
+	return gcleaner->worker.n_schema_hits;
+}
+
+/*
+ * read every schema under /schemas into the memory at once on
+ * gconf_cleaner_update() and look the schemas up there without asking
+ * gconfd.  the schemas installed elsewhere are still looked up one by one.
+ */
+void
+gconf_cleaner_set_use_schema_index(GConfCleaner *gcleaner,
+				   gboolean      flag)
+{
+	g_return_if_fail (gcleaner != NULL);
+
+	gcleaner->use_schema_index = (flag != FALSE);
+	if (!flag && gcleaner->schema_index) {
+		g_hash_table_destroy(gcleaner->schema_index);
+		gcleaner->schema_index = NULL;
+	}
+}
+
+guint
+gconf_cleaner_schema_index_size(GConfCleaner *gcleaner)
+{
+	g_return_val_if_fail (gcleaner != NULL, 0);
+
+	return gcleaner->schema_index ? g_hash_table_size(gcleaner->schema_index) : 0;
+}
+
+/* the seconds taken to build the schema index */
+gdouble
+gconf_cleaner_schema_index_build_time(GConfCleaner *gcleaner)
+{
+	g_return_val_if_fail (gcleaner != NULL, 0.0);
+
+	return gcleaner->schema_index ? gcleaner->schema_index_time : 0.0;
+}
+
+guint
+gconf_cleaner_n_scan_cache_hits(GConfCleaner *gcleaner)
+{
+	g_return_val_if_fail (gcleaner != NULL, 0);
+
+	return gcleaner->worker.n_cache_hits;
+}
+
+/*
+ * remember the verdict of each directory in @filename and reuse it on
+ * the later runs while the files of the directory aren't changed.  this
+ * works only with the xml: sources read by gconf_cleaner_set_sources().
+ */
+gboolean
+gconf_cleaner_set_scan_cache(GConfCleaner  *gcleaner,
+			     const gchar   *filename,
+			     GError       **error)
+{
+	GConfCleanerCache *cache = NULL;
+
+	g_return_val_if_fail (gcleaner != NULL, FALSE);
+
+	if (filename) {
+		cache = gconf_cleaner_cache_new(filename, error);
+		if (cache == NULL)
+			return FALSE;
+	}
+	if (gcleaner->cache)
+		gconf_cleaner_cache_free(gcleaner->cache);
+	gcleaner->cache = cache;
+
+	return TRUE;
+}
+
+void
+gconf_cleaner_invalidate_scan_cache(GConfCleaner *gcleaner)
+{
+	g_return_if_fail (gcleaner != NULL);
+
+	if (gcleaner->cache)
+		gconf_cleaner_cache_invalidate(gcleaner->cache);
+}
+
+/*
+ * exclude the directories matching @rule and their subdirectories from
+ * the analysis.  see gconf_cleaner_exclude_add() for the syntax.  the
+ * default rules are there until gconf_cleaner_clear_excludes() is called.
+ * takes effect on the next gconf_cleaner_update().
+ */
+gboolean
+gconf_cleaner_add_exclude(GConfCleaner  *gcleaner,
+			  const gchar   *rule,
+			  GError       **error)
+{
+	g_return_val_if_fail (gcleaner != NULL, FALSE);
+	g_return_val_if_fail (rule != NULL, FALSE);
+
+	return gconf_cleaner_exclude_add(gcleaner->exclude, rule, error);
+}
+
+gboolean
+gconf_cleaner_load_excludes(GConfCleaner  *gcleaner,
+			    const gchar   *filename,
+			    GError       **error)
+{
+	g_return_val_if_fail (gcleaner != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	return gconf_cleaner_exclude_load(gcleaner->exclude, filename, error);
+}
+
+void
+gconf_cleaner_clear_excludes(GConfCleaner *gcleaner)
+{
+	g_return_if_fail (gcleaner != NULL);
+
+	gconf_cleaner_exclude_clear(gcleaner->exclude);
+}
+
+gboolean
+gconf_cleaner_save_scan_cache(GConfCleaner  *gcleaner,
+			      GError       **error)
+{
+	g_return_val_if_fail (gcleaner != NULL, FALSE);
+
+	if (gcleaner->cache == NULL)
+		return TRUE;
+
+	return gconf_cleaner_cache_save(gcleaner->cache, error);
+}
+
+gboolean
+gconf_cleaner_analyze_current_dir(GConfCleaner  *gcleaner,
+				  GError       **error)
+{
+	GConfCleanerStore store;
+	gboolean retval;
+
+	g_return_val_if_fail (gcleaner != NULL, FALSE);
+	g_return_val_if_fail (error != NULL, FALSE);
+	g_return_val_if_fail (gcleaner->current_dir < gcleaner->result.dirs->len, FALSE);
+
+	if (G_UNLIKELY (*error != NULL)) {
+		g_error_free(*error);
+		*error = NULL;
+	}
+	store.result = &gcleaner->result;
+	store.block = NULL;
+	store.pairs = gcleaner->result.pairs;
+
+	_gconf_cleaner_phase_begin(gcleaner);
+	retval = _gconf_cleaner_analyze_dir(gcleaner, &gcleaner->worker,
+					    gcleaner->current_dir++,
+					    _gconf_cleaner_store_pair,
+					    &store,
+					    error);
+	if (retval)
+		_gconf_cleaner_checkpoint_tick(gcleaner, 1);
+	_gconf_cleaner_phase_end(gcleaner, GCLEANER_PHASE_ANALYSIS);
+
+	return retval;
+}
+
+void
+gconf_cleaner_set_n_threads(GConfCleaner *gcleaner,
+			    guint         n_threads)
+{
+	g_return_if_fail (gcleaner != NULL);
+
+	gcleaner->n_threads = MAX (n_threads, 1);
+}
+
+/*
+ * analyze all of the rest directories with gconf_cleaner_set_n_threads()
+ * threads at most.  the result is exactly the same as what calling
+ * gconf_cleaner_analyze_current_dir() repeatedly stores.
+ */
+gboolean
+gconf_cleaner_analyze(GConfCleaner  *gcleaner,
+		      GError       **error)
+{
+	guint n_threads, n_dirs;
+
+	g_return_val_if_fail (gcleaner != NULL, FALSE);
+	g_return_val_if_fail (error != NULL, FALSE);
+
+	if (G_UNLIKELY (*error != NULL)) {
+		g_error_free(*error);
+		*error = NULL;
+	}
+	n_dirs = gcleaner->result.dirs->len - gcleaner->current_dir;
+	n_threads = MIN (gcleaner->n_threads, n_dirs);
+	/* GConf isn't thread-safe. only the direct reader can be shared */
+	if (gcleaner->xml == NULL || !g_thread_supported())
+		n_threads = 1;
+
+	_gconf_cleaner_phase_begin(gcleaner);
+	if (n_threads <= 1) {
+		while (gcleaner->current_dir < gcleaner->result.dirs->len) {
+			if (!gconf_cleaner_analyze_current_dir(gcleaner, error))
+				break;
+		}
+		_gconf_cleaner_phase_end(gcleaner, GCLEANER_PHASE_ANALYSIS);
+
+		return *error == NULL;
+	}
+
+	while (*error == NULL && gcleaner->current_dir < gcleaner->result.dirs->len) {
+		n_dirs = gcleaner->result.dirs->len - gcleaner->current_dir;
+		if (gcleaner->checkpoint)
+			n_dirs = MIN (n_dirs, gcleaner->checkpoint_interval);
+		_gconf_cleaner_analyze_dirs(gcleaner, n_dirs, n_threads, error);
+		if (*error == NULL)
+			_gconf_cleaner_checkpoint_tick(gcleaner, n_dirs);
+	}
+	_gconf_cleaner_phase_end(gcleaner, GCLEANER_PHASE_ANALYSIS);
+
+	return *error == NULL;
+}
+
+/*
+ * analyze all of the rest directories and give the unknown pairs to @func
+ * as soon as they are found, instead of storing them into the result.
+ * @func gets the key and the value which are valid only during the call,
+ * and may return FALSE to stop the analysis.  this always runs in the
+ * caller's thread so that the pairs come in the same order as
+ * gconf_cleaner_analyze() stores.
+ */
+gboolean
+gconf_cleaner_foreach_unknown(GConfCleaner             *gcleaner,
+			      GConfCleanerForeachFunc   func,
+			      gpointer                  user_data,
+			      GError                  **error)
+{
+	GConfCleanerForeach foreach;
+
+	g_return_val_if_fail (gcleaner != NULL, FALSE);
+	g_return_val_if_fail (func != NULL, FALSE);
+	g_return_val_if_fail (error != NULL, FALSE);
+
+	if (G_UNLIKELY (*error != NULL)) {
+		g_error_free(*error);
+		*error = NULL;
+	}
+	foreach.gcleaner = gcleaner;
+	foreach.func = func;
+	foreach.user_data = user_data;
+	foreach.stopped = FALSE;
+	_gconf_cleaner_phase_begin(gcleaner);
+	while (!foreach.stopped &&
+	       gcleaner->current_dir < gcleaner->result.dirs->len) {
+		if (!_gconf_cleaner_analyze_dir(gcleaner, &gcleaner->worker,
+						gcleaner->current_dir++,
+						_gconf_cleaner_foreach_pair,
+						&foreach,
+						error))
+			break;
+	}
+	_gconf_cleaner_phase_end(gcleaner, GCLEANER_PHASE_ANALYSIS);
+
+	return *error == NULL;
+}
+
+/* the list returned by the following two functions is a copy of the result */
+GSList *
+gconf_cleaner_get_unknown_pairs_at_current_dir(GConfCleaner  *gcleaner,
+					       GError       **error)
+{
+	guint start;
+
+	g_return_val_if_fail (gcleaner != NULL, NULL);
+
+	start = gcleaner->result.pairs->len;
+	if (!gconf_cleaner_analyze_current_dir(gcleaner, error))
+		return NULL;
+
+	return _gconf_cleaner_result_to_list(&gcleaner->result, start);
+}
+
+GSList *
+gconf_cleaner_get_unknown_pairs(GConfCleaner  *gcleaner,
+				GError       **error)
+{
+	guint start;
+
+	g_return_val_if_fail (gcleaner != NULL, NULL);
+
+	start = gcleaner->result.pairs->len;
+	if (!gconf_cleaner_analyze(gcleaner, error))
+		return NULL;
+
+	return _gconf_cleaner_result_to_list(&gcleaner->result, start);
+}
+
+const GConfCleanerResult *
+gconf_cleaner_get_result(GConfCleaner *gcleaner)
+{
+	g_return_val_if_fail (gcleaner != NULL, NULL);
+
+	return &gcleaner->result;
+}
+
+guint
+gconf_cleaner_result_n_dirs(const GConfCleanerResult *result)
+{
+	g_return_val_if_fail (result != NULL, 0);
+
+	return result->dirs->len;
+}
+
+/*
+ * the paths aren't stored as is.  returns the newly allocated path of
+ * the directory which has to be freed.
+ */
+gchar *
+gconf_cleaner_result_dup_dir(const GConfCleanerResult *result,
+			     guint                     index)
+{
+	GString *path;
+
+	g_return_val_if_fail (result != NULL, NULL);
+	g_return_val_if_fail (index < result->dirs->len, NULL);
+
+	path = g_string_new(NULL);
+	_gconf_cleaner_result_build_path(result, index, path);
+
+	return g_string_free(path, FALSE);
+}
+
+guint
+gconf_cleaner_result_n_pairs(const GConfCleanerResult *result)
+{
+	g_return_val_if_fail (result != NULL, 0);
+
+	return result->pairs->len;
+}
+
+gchar *
+gconf_cleaner_result_dup_key(const GConfCleanerResult *result,
+			     guint                     index)
+{
+	GString *key;
+
+	g_return_val_if_fail (result != NULL, NULL);
+	g_return_val_if_fail (index < result->pairs->len, NULL);
+
+	key = g_string_new(NULL);
+	_gconf_cleaner_result_build_key(result, index, key);
+
+	return g_string_free(key, FALSE);
+}
+
+/* the basename of the key, which is valid until the result is cleared */
+const gchar *
+gconf_cleaner_result_get_key_name(const GConfCleanerResult *result,
+				  guint                     index)
+{
+	g_return_val_if_fail (result != NULL, NULL);
+	g_return_val_if_fail (index < result->pairs->len, NULL);
+
+	return g_array_index(result->pairs, GConfCleanerPair, index).name;
+}
+
+GConfValue *
+gconf_cleaner_result_get_value(const GConfCleanerResult *result,
+			       guint                     index)
+{
+	g_return_val_if_fail (result != NULL, NULL);
+	g_return_val_if_fail (index < result->pairs->len, NULL);
+
+	return g_array_index(result->pairs, GConfCleanerPair, index).value;
+}
+
+guint
+gconf_cleaner_result_get_pair_dir(const GConfCleanerResult *result,
+				  guint                     index)
+{
+	g_return_val_if_fail (result != NULL, 0);
+	g_return_val_if_fail (index < result->pairs->len, 0);
+
+	return g_array_index(result->pairs, GConfCleanerPair, index).dir;
+}
+
+/* the returned string is valid until the next call */
+const gchar *
+gconf_cleaner_get_current_dir(GConfCleaner *gcleaner)
+{
+	g_return_val_if_fail (gcleaner != NULL, NULL);
+	g_return_val_if_fail (gcleaner->current_dir < gcleaner->result.dirs->len, NULL);
+
+	_gconf_cleaner_result_build_path(&gcleaner->result, gcleaner->current_dir,
+					 gcleaner->current_path);
+
+	return gcleaner->current_path->str;
+}
+
+void
+gconf_cleaner_pairs_free(GSList *list)
+{
+	GSList *l;
+
+	g_return_if_fail (list != NULL);
+
+	for (l = list; l != NULL; l = g_slist_next(l)) {
+		g_free(l->data);
+		l = g_slist_next(l);
+		gconf_value_free(l->data);
+	}
+	g_slist_free(list);
+}
+
+void
+gconf_cleaner_unset_key(GConfCleaner  *gcleaner,
+			const gchar   *key,
+			GError       **error)
+{
+	g_return_if_fail (gcleaner != NULL);
+	g_return_if_fail (key != NULL);
+	g_return_if_fail (gcleaner->gconf != NULL);
+
+	_gconf_cleaner_phase_begin(gcleaner);
+	gcleaner->worker.n_calls[GCLEANER_CALL_UNSET]++;
+	gconf_engine_unset(gcleaner->gconf, key, error);
+	_gconf_cleaner_phase_end(gcleaner, GCLEANER_PHASE_CLEAN);
+}
+
+void
+gconf_cleaner_set_unset_batch_size(GConfCleaner *gcleaner,
+				   guint         size)
+{
+	g_return_if_fail (gcleaner != NULL);
+
+	gcleaner->unset_batch_size = MAX (size, 1);
+}
+
+guint
+gconf_cleaner_get_unset_batch_size(GConfCleaner *gcleaner)
+{
+	g_return_val_if_fail (gcleaner != NULL, 0);
+
+	return gcleaner->unset_batch_size;
+}
+
+/*
+ * unset @n_keys keys in the change sets of gconf_cleaner_set_unset_batch_size()
+ * keys.  @func is called for every key with the error if it couldn't be
+ * unset, and may return FALSE to stop after the current change set.
+ * returns the number of the keys which has been unset.
+ */
+guint
+gconf_cleaner_unset_keys(GConfCleaner           *gcleaner,
+			 const gchar * const    *keys,
+			 guint                   n_keys,
+			 GConfCleanerUnsetFunc   func,
+			 gpointer                user_data)
+{
+	GConfChangeSet *cs;
+	GError *error = NULL;
+	guint i, j, n, retval = 0;
+	gboolean stopped = FALSE;
+
+	g_return_val_if_fail (gcleaner != NULL, 0);
+	g_return_val_if_fail (keys != NULL || n_keys == 0, 0);
+	g_return_val_if_fail (gcleaner->gconf != NULL, 0);
+
+	_gconf_cleaner_phase_begin(gcleaner);
+	for (i = 0; i < n_keys && !stopped; i += n) {
+		n = MIN (gcleaner->unset_batch_size, n_keys - i);
+		cs = gconf_change_set_new();
+		for (j = 0; j < n; j++)
+			gconf_change_set_unset(cs, keys[i + j]);
+		gcleaner->worker.n_calls[GCLEANER_CALL_UNSET]++;
+		if (!gconf_engine_commit_change_set(gcleaner->gconf, cs, TRUE, &error)) {
+			/* the committed keys are gone from the set. try the rest one by one */
+			g_clear_error(&error);
+			for (j = 0; j < n; j++) {
+				if (gconf_change_set_check_value(cs, keys[i + j], NULL)) {
+					gcleaner->worker.n_calls[GCLEANER_CALL_UNSET]++;
+					gconf_engine_unset(gcleaner->gconf, keys[i + j], &error);
+				}
+				if (error == NULL)
+					retval++;
+				if (func && !func(keys[i + j], error, user_data))
+					stopped = TRUE;
+				g_clear_error(&error);
+			}
+		} else {
+			retval += n;
+			for (j = 0; j < n; j++) {
+				if (func && !func(keys[i + j], NULL, user_data))
+					stopped = TRUE;
+			}
+		}
+		gconf_change_set_unref(cs);
+	}
+	_gconf_cleaner_phase_end(gcleaner, GCLEANER_PHASE_CLEAN);
+
+	return retval;
+}
+
+/*
+ * unset @keys by rewriting the files of the xml: sources directly, each
+ * of them once, instead of asking gconfd.  gconfd must not be running,
+ * or it would write the keys it has in memory back later.  nothing is
+ * changed when it fails.  returns the number of the keys removed.
+ */
+guint
+gconf_cleaner_unset_keys_offline(GConfCleaner         *gcleaner,
+				 const gchar * const  *keys,
+				 guint                 n_keys,
+				 GError              **error)
+{
+	guint retval = 0;
+
+	g_return_val_if_fail (gcleaner != NULL, 0);
+	g_return_val_if_fail (keys != NULL || n_keys == 0, 0);
+
+	if (gcleaner->xml == NULL) {
+		g_set_error(error, 0, 0,
+			    _("The configuration sources aren't read directly"));
+		return 0;
+	}
+	if (gconf_ping_daemon()) {
+		g_set_error(error, 0, 0,
+			    _("gconfd is running. shut it down with `gconftool-2 --shutdown' first"));
+		return 0;
+	}
+	_gconf_cleaner_phase_begin(gcleaner);
+	gconf_cleaner_xml_source_remove_keys(gcleaner->xml, keys, n_keys, &retval, error);
+	_gconf_cleaner_phase_end(gcleaner, GCLEANER_PHASE_CLEAN);
+
+	return retval;
+}
+
+/*
+ * rewrite %gconf-tree.xml of the writable xml: sources in the minimal
+ * form after cleaning up, without the comments, the whitespace between
+ * the elements, the directories left with no entries and the entries
+ * with neither a value nor a schema.  as with
+ * gconf_cleaner_unset_keys_offline(), gconfd must not be running and
+ * nothing is changed when it fails.
+ */
+gboolean
+gconf_cleaner_compact(GConfCleaner            *gcleaner,
+		      GConfCleanerCompaction  *compaction,
+		      GError                 **error)
+{
+	gboolean retval;
+
+	g_return_val_if_fail (gcleaner != NULL, FALSE);
+	g_return_val_if_fail (compaction != NULL, FALSE);
+
+	if (gcleaner->xml == NULL) {
+		g_set_error(error, 0, 0,
+			    _("The configuration sources aren't read directly"));
+		return FALSE;
+	}
+	if (gconf_ping_daemon()) {
+		g_set_error(error, 0, 0,
+			    _("gconfd is running. shut it down with `gconftool-2 --shutdown' first"));
+		return FALSE;
+	}
+	_gconf_cleaner_phase_begin(gcleaner);
+	retval = gconf_cleaner_xml_source_compact(gcleaner->xml, compaction, error);
+	_gconf_cleaner_phase_end(gcleaner, GCLEANER_PHASE_CLEAN);
+
+	return retval;
+}
+
+/*
+ * remove the directories left with neither keys nor subdirectories after
+ * cleaning up, going up from the deepest ones in the result of the
+ * traversal.  the directories having any subdirectories excluded, or not
+ * analyzed yet, are kept.  each of them is checked to be empty before
+ * removing it through gconfd, or by gconf_cleaner_xml_source_remove_dirs()
+ * when there's no engine.  returns the number of the directories removed.
+ */
+guint
+gconf_cleaner_prune_empty_dirs(GConfCleaner  *gcleaner,
+			       GError       **error)
+{
+	GArray *dirs;
+	GPtrArray *paths;
+	GString *path;
+	GError *err = NULL;
+	guint *n_subdirs, i, retval = 0;
+
+	g_return_val_if_fail (gcleaner != NULL, 0);
+
+	if (gcleaner->gconf == NULL && gconf_ping_daemon()) {
+		g_set_error(error, 0, 0,
+			    _("gconfd is running. shut it down with `gconftool-2 --shutdown' first"));
+		return 0;
+	}
+	_gconf_cleaner_phase_begin(gcleaner);
+	dirs = gcleaner->result.dirs;
+	n_subdirs = g_new0(guint, dirs->len);
+	for (i = 0; i < dirs->len; i++) {
+		GConfCleanerDir *d = &g_array_index(dirs, GConfCleanerDir, i);
+
+		if (d->parent != GCLEANER_NO_PARENT)
+			n_subdirs[d->parent]++;
+	}
+	paths = g_ptr_array_new();
+	path = g_string_new(NULL);
+	/* the subdirectories always come after their parent */
+	for (i = dirs->len; i > 0 && err == NULL; i--) {
+		GConfCleanerDir *d = &g_array_index(dirs, GConfCleanerDir, i - 1);
+
+		if (i - 1 >= gcleaner->current_dir ||
+		    n_subdirs[i - 1] > 0 || d->n_excluded > 0 ||
+		    d->n_pairs > d->n_unknown_pairs)
+			continue;
+		_gconf_cleaner_result_build_path(&gcleaner->result, i - 1, path);
+		if (gcleaner->gconf) {
+			GSList *entries, *l;
+
+			gcleaner->worker.n_calls[GCLEANER_CALL_ALL_ENTRIES]++;
+			entries = gconf_engine_all_entries(gcleaner->gconf, path->str, &err);
+			if (entries != NULL || err != NULL) {
+				/* some keys couldn't be unset, or weren't selected */
+				for (l = entries; l != NULL; l = g_slist_next(l))
+					gconf_entry_free(l->data);
+				g_slist_free(entries);
+				continue;
+			}
+			gcleaner->worker.n_calls[GCLEANER_CALL_UNSET]++;
+			gconf_engine_remove_dir(gcleaner->gconf, path->str, &err);
+			if (err != NULL)
+				continue;
+			retval++;
+		} else {
+			/* the files tell whether it's really empty */
+			g_ptr_array_add(paths, g_strdup(path->str));
+		}
+		if (d->parent != GCLEANER_NO_PARENT)
+			n_subdirs[d->parent]--;
+	}
+	if (err != NULL) {
+		g_set_error(error, 0, 0,
+			    _("Failed to remove `%s': %s"),
+			    path->str, err->message);
+		g_error_free(err);
+	} else if (gcleaner->gconf == NULL && gcleaner->xml != NULL) {
+		gconf_cleaner_xml_source_remove_dirs(gcleaner->xml,
+						     (const gchar * const *)paths->pdata,
+						     paths->len, &retval, error);
+	}
+	for (i = 0; i < paths->len; i++)
+		g_free(g_ptr_array_index(paths, i));
+	g_ptr_array_free(paths, TRUE);
+	g_string_free(path, TRUE);
+	g_free(n_subdirs);
+	_gconf_cleaner_phase_end(gcleaner, GCLEANER_PHASE_CLEAN);
+
+	return retval;
+}
+
+/*
+ * restore the keys from the backup written by the cleaning, in the change
+ * sets of gconf_cleaner_set_unset_batch_size() keys.  the entries which
+ * can't be restored, e.g. schemas or invalid keys, are skipped.  the keys
+ * gconfd refused to set are counted in @n_failed.  when a key is there
+ * more than once, the last value wins and the key is counted once.
+ */
+gboolean
+gconf_cleaner_restore(GConfCleaner  *gcleaner,
+		      const gchar   *filename,
+		      guint         *n_restored,
+		      guint         *n_skipped,
+		      guint         *n_failed,
+		      GError       **error)
+{
+	GConfCleanerRestore restore;
+	gboolean retval;
+
+	g_return_val_if_fail (gcleaner != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (gcleaner->gconf != NULL, FALSE);
+
+	restore.gcleaner = gcleaner;
+	restore.cs = gconf_change_set_new();
+	restore.keys = g_ptr_array_sized_new(gcleaner->unset_batch_size);
+	restore.restored = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	restore.n_restored = 0;
+	restore.n_skipped = 0;
+	restore.n_failed = 0;
+	retval = gconf_cleaner_backup_read(filename, _gconf_cleaner_restore_entry, &restore, error);
+	/* keep what is parsed so far even if the file is broken */
+	_gconf_cleaner_restore_flush(&restore);
+	gconf_change_set_unref(restore.cs);
+	g_ptr_array_free(restore.keys, TRUE);
+	g_hash_table_destroy(restore.restored);
+	if (n_restored)
+		*n_restored = restore.n_restored;
+	if (n_skipped)
+		*n_skipped = restore.n_skipped;
+	if (n_failed)
+		*n_failed = restore.n_failed;
+
+	return retval;
+}
+
+void
+gconf_cleaner_sync(GConfCleaner  *gcleaner,
+		   GError       **error)
+{
+	g_return_if_fail (gcleaner != NULL);
+	g_return_if_fail (gcleaner->gconf != NULL);
+
+	_gconf_cleaner_phase_begin(gcleaner);
+	gconf_engine_suggest_sync(gcleaner->gconf, error);
+	_gconf_cleaner_phase_end(gcleaner, GCLEANER_PHASE_SYNC);
+}
+
+/*
+ * the statistics of the phases since the last gconf_cleaner_update().
+ * the slowest directories are filled in once the analysis is finished.
+ */
+const GConfCleanerStats *
+gconf_cleaner_get_stats(GConfCleaner *gcleaner)
+{
+	GConfCleanerStats *stats;
+	GConfCleanerResult *result;
+	guint i;
+
+	g_return_val_if_fail (gcleaner != NULL, NULL);
+
+	stats = &gcleaner->stats;
+	result = &gcleaner->result;
+	stats->result_size = _gconf_cleaner_array_size(result->dirs, sizeof (GConfCleanerDir)) +
+		_gconf_cleaner_array_size(result->pairs, sizeof (GConfCleanerPair)) +
+		result->names_size + result->values_size;
+	for (i = 0; i < stats->n_slowest_dirs; i++)
+		g_free(stats->slowest_dirs[i]);
+	stats->n_slowest_dirs = gcleaner->worker.n_slowest;
+	for (i = 0; i < stats->n_slowest_dirs; i++) {
+		GString *path = g_string_new(NULL);
+
+		_gconf_cleaner_result_build_path(result, gcleaner->worker.slowest_dirs[i], path);
+		stats->slowest_dirs[i] = g_string_free(path, FALSE);
+		stats->slowest_times[i] = gcleaner->worker.slowest_times[i];
+	}
+
+	return stats;
+}
+
+const gchar *
+gconf_cleaner_phase_get_name(GConfCleanerPhase phase)
+{
+	static const gchar *names[] = {
+		"traversal", "analysis", "clean", "sync"
+	};
+
+	g_return_val_if_fail (phase < GCLEANER_N_PHASES, NULL);
+
+	return names[phase];
+}
+
+const gchar *
+gconf_cleaner_call_get_name(GConfCleanerCall call)
+{
+	static const gchar *names[] = {
+		"all_dirs", "all_entries", "get_schema", "unset"
+	};
+
+	g_return_val_if_fail (call < GCLEANER_N_CALLS, NULL);
+
+	return names[call];
+}
+
+/*
+ * dump @stats as the tab-separated lines:
+ *   phase	<name>	<wall time>	<cpu time>	<calls>...
+ *   result_size	<bytes>
+ *   slowest_dir	<path>	<time>
+ */
+gchar *
+gconf_cleaner_stats_dump(const GConfCleanerStats *stats)
+{
+	GString *retval;
+	guint i, j;
+
+	g_return_val_if_fail (stats != NULL, NULL);
+
+	retval = g_string_new("#phase\tname\twall\tcpu");
+	for (i = 0; i < GCLEANER_N_CALLS; i++)
+		g_string_append_printf(retval, "\t%s", gconf_cleaner_call_get_name(i));
+	g_string_append_c(retval, '\n');
+	for (i = 0; i < GCLEANER_N_PHASES; i++) {
+		const GConfCleanerPhaseStats *phase = &stats->phases[i];
+
+		g_string_append_printf(retval, "phase\t%s\t%.6f\t%.6f",
+				       gconf_cleaner_phase_get_name(i),
+				       phase->wall_time, phase->cpu_time);
+		for (j = 0; j < GCLEANER_N_CALLS; j++)
+			g_string_append_printf(retval, "\t%u", phase->n_calls[j]);
+		g_string_append_c(retval, '\n');
+	}
+	g_string_append_printf(retval, "result_size\t%" G_GSIZE_FORMAT "\n", stats->result_size);
+	for (i = 0; i < stats->n_slowest_dirs; i++)
+		g_string_append_printf(retval, "slowest_dir\t%s\t%.6f\n",
+				       stats->slowest_dirs[i], stats->slowest_times[i]);
+
+	return g_string_free(retval, FALSE);
+}
+
+/*
+ * the footprints of the analyzed directories which have any entries, the
+ * one with the most bytes of the unknown values first.  only the first @n
+ * of them are returned unless @n is 0.  the lists aren't counted for the
+ * directories taken from the scan cache.
+ */
+GConfCleanerFootprint *
+gconf_cleaner_get_footprints(GConfCleaner *gcleaner,
+			     guint         n,
+			     guint        *n_footprints)
+{
+	GConfCleanerFootprint *retval;
+	GArray *dirs, *indexes;
+	GString *path;
+	guint i;
+
+	g_return_val_if_fail (gcleaner != NULL, NULL);
+	g_return_val_if_fail (n_footprints != NULL, NULL);
+
+	dirs = gcleaner->result.dirs;
+	indexes = g_array_new(FALSE, FALSE, sizeof (guint));
+	for (i = 0; i < gcleaner->current_dir; i++) {
+		if (g_array_index(dirs, GConfCleanerDir, i).n_pairs > 0)
+			g_array_append_val(indexes, i);
+	}
+	g_array_sort_with_data(indexes, _gconf_cleaner_footprint_compare, dirs);
+	if (n == 0 || n > indexes->len)
+		n = indexes->len;
+
+	retval = g_new0(GConfCleanerFootprint, MAX (n, 1));
+	path = g_string_new(NULL);
+	for (i = 0; i < n; i++) {
+		guint dir = g_array_index(indexes, guint, i);
+		const GConfCleanerDir *d = &g_array_index(dirs, GConfCleanerDir, dir);
+
+		_gconf_cleaner_result_build_path(&gcleaner->result, dir, path);
+		retval[i].path = g_strdup(path->str);
+		retval[i].n_pairs = d->n_pairs;
+		retval[i].n_unknown_pairs = d->n_unknown_pairs;
+		retval[i].max_list_length = d->max_list_length;
+		retval[i].unknown_size = d->unknown_size;
+	}
+	g_string_free(path, TRUE);
+	g_array_free(indexes, TRUE);
+	*n_footprints = n;
+
+	return retval;
+}
+
+/* the bytes of all of the unknown values found so far */
+gsize
+gconf_cleaner_unknown_size(GConfCleaner *gcleaner)
+{
+	gsize retval = 0;
+	guint i;
+
+	g_return_val_if_fail (gcleaner != NULL, 0);
+
+	for (i = 0; i < gcleaner->current_dir; i++)
+		retval += g_array_index(gcleaner->result.dirs, GConfCleanerDir, i).unknown_size;
+
+	return retval;
+}
+
+void
+gconf_cleaner_footprints_free(GConfCleanerFootprint *footprints,
+			      guint                  n_footprints)
+{
+	guint i;
+
+	if (footprints == NULL)
+		return;
+	for (i = 0; i < n_footprints; i++)
+		g_free(footprints[i].path);
+	g_free(footprints);
+}
+
+/*
+ * dump @footprints as the tab-separated lines:
+ *   dir	<path>	<keys>	<cleanable>	<bytes>	<longest list>
+ */
+gchar *
+gconf_cleaner_footprints_dump(const GConfCleanerFootprint *footprints,
+			      guint                        n_footprints)
+{
+	GString *retval;
+	guint i;
+
+	g_return_val_if_fail (footprints != NULL || n_footprints == 0, NULL);
+
+	retval = g_string_new("#dir\tpath\tkeys\tcleanable\tbytes\tlongest_list\n");
+	for (i = 0; i < n_footprints; i++)
+		g_string_append_printf(retval, "dir\t%s\t%u\t%u\t%" G_GSIZE_FORMAT "\t%u\n",
+				       footprints[i].path,
+				       footprints[i].n_pairs,
+				       footprints[i].n_unknown_pairs,
+				       footprints[i].unknown_size,
+				       footprints[i].max_list_length);
+
+	return g_string_free(retval, FALSE);
 }
@@ -24,28 +24,197 @@
 #define __GCONF_CLEANER_H__
 
 #include <glib.h>
+#include <gconf/gconf-value.h>
 
 G_BEGIN_DECLS
 
 typedef struct _GConfCleaner GConfCleaner;
+typedef struct _GConfCleanerResult GConfCleanerResult;
+typedef struct _GConfCleanerPhaseStats GConfCleanerPhaseStats;
+typedef struct _GConfCleanerStats GConfCleanerStats;
+typedef struct _GConfCleanerFootprint GConfCleanerFootprint;
+typedef struct _GConfCleanerCompaction GConfCleanerCompaction;
+
+typedef enum {
+	GCLEANER_PHASE_TRAVERSAL,
+	GCLEANER_PHASE_ANALYSIS,
+	GCLEANER_PHASE_CLEAN,
+	GCLEANER_PHASE_SYNC,
+	GCLEANER_N_PHASES
+} GConfCleanerPhase;
+
+typedef enum {
+	GCLEANER_CALL_ALL_DIRS,
+	GCLEANER_CALL_ALL_ENTRIES,
+	GCLEANER_CALL_GET_SCHEMA,
+	GCLEANER_CALL_UNSET,
+	GCLEANER_N_CALLS
+} GConfCleanerCall;
+
+#define GCLEANER_STATS_N_SLOWEST_DIRS	5
+
+struct _GConfCleanerPhaseStats {
+	gdouble wall_time;
+	gdouble cpu_time;
+	guint   n_calls[GCLEANER_N_CALLS];
+};
+
+struct _GConfCleanerStats {
+	GConfCleanerPhaseStats phases[GCLEANER_N_PHASES];
+	gsize                  result_size;
+	guint                  n_slowest_dirs;
+	gchar                 *slowest_dirs[GCLEANER_STATS_N_SLOWEST_DIRS];
+	gdouble                slowest_times[GCLEANER_STATS_N_SLOWEST_DIRS];
+};
+
+struct _GConfCleanerFootprint {
+	gchar *path;
+	guint  n_pairs;
+	guint  n_unknown_pairs;
+	guint  max_list_length;	/* the number of the items in the longest list */
+	gsize  unknown_size;	/* the bytes of the unknown values as strings */
+};
+
+struct _GConfCleanerCompaction {
+	guint   n_files;
+	guint64 size_before;
+	guint64 size_after;
+	gdouble parse_time_before;
+	gdouble parse_time_after;
+	guint   n_dropped_dirs;
+	guint   n_dropped_entries;
+};
+
+typedef gboolean (* GConfCleanerForeachFunc) (const gchar *key,
+					      GConfValue  *value,
+					      const gchar *dir,
+					      gpointer     user_data);
+typedef gboolean (* GConfCleanerUnsetFunc)   (const gchar  *key,
+					      const GError *error,
+					      gpointer      user_data);
 
 GConfCleaner *gconf_cleaner_new                             (void);
+GConfCleaner *gconf_cleaner_new_for_address                 (const gchar   *address,
+							     GError       **error);
+GConfCleaner *gconf_cleaner_new_for_addresses               (const gchar * const *addresses,
+							     GError       **error);
+GConfCleaner *gconf_cleaner_new_for_sources                 (const gchar * const *addresses,
+							     GError       **error);
 void          gconf_cleaner_free                            (GConfCleaner  *gcleaner);
+gboolean      gconf_cleaner_set_sources                     (GConfCleaner  *gcleaner,
+							     const gchar * const *addresses,
+							     GError       **error);
 gboolean      gconf_cleaner_is_initialized                  (GConfCleaner  *gcleaner);
 gboolean      gconf_cleaner_update                          (GConfCleaner  *gcleaner,
 							     GError       **error);
+void          gconf_cleaner_traverse_begin                  (GConfCleaner  *gcleaner);
+gboolean      gconf_cleaner_traverse_step                   (GConfCleaner  *gcleaner,
+							     GError       **error);
+void          gconf_cleaner_traverse_cancel                 (GConfCleaner  *gcleaner);
+gboolean      gconf_cleaner_traverse_is_finished            (GConfCleaner  *gcleaner);
+guint         gconf_cleaner_traverse_get_depth              (GConfCleaner  *gcleaner);
+guint         gconf_cleaner_traverse_n_pending              (GConfCleaner  *gcleaner);
+void          gconf_cleaner_set_checkpoint                  (GConfCleaner  *gcleaner,
+							     const gchar   *filename,
+							     guint          interval);
+gboolean      gconf_cleaner_save_checkpoint                 (GConfCleaner  *gcleaner,
+							     GError       **error);
+gboolean      gconf_cleaner_resume                          (GConfCleaner  *gcleaner,
+							     const gchar   *filename,
+							     GError       **error);
 const gchar  *gconf_cleaner_get_current_dir                 (GConfCleaner  *gcleaner);
 guint         gconf_cleaner_n_dirs                          (GConfCleaner  *gcleaner);
+guint         gconf_cleaner_n_analyzed_dirs                 (GConfCleaner  *gcleaner);
 guint         gconf_cleaner_n_pairs                         (GConfCleaner  *gcleaner);
 guint         gconf_cleaner_n_unknown_pairs                 (GConfCleaner  *gcleaner);
+guint         gconf_cleaner_n_schema_lookups                (GConfCleaner  *gcleaner);
+guint         gconf_cleaner_n_schema_cache_hits             (GConfCleaner  *gcleaner);
+void          gconf_cleaner_set_use_schema_index            (GConfCleaner  *gcleaner,
+							     gboolean       flag);
+guint         gconf_cleaner_schema_index_size               (GConfCleaner  *gcleaner);
+gdouble       gconf_cleaner_schema_index_build_time         (GConfCleaner  *gcleaner);
+guint         gconf_cleaner_n_scan_cache_hits               (GConfCleaner  *gcleaner);
+gboolean      gconf_cleaner_set_scan_cache                  (GConfCleaner  *gcleaner,
+							     const gchar   *filename,
+							     GError       **error);
+void          gconf_cleaner_invalidate_scan_cache           (GConfCleaner  *gcleaner);
+gboolean      gconf_cleaner_save_scan_cache                 (GConfCleaner  *gcleaner,
+							     GError       **error);
+gboolean      gconf_cleaner_add_exclude                     (GConfCleaner  *gcleaner,
+							     const gchar   *rule,
+							     GError       **error);
+gboolean      gconf_cleaner_load_excludes                   (GConfCleaner  *gcleaner,
+							     const gchar   *filename,
+							     GError       **error);
+void          gconf_cleaner_clear_excludes                  (GConfCleaner  *gcleaner);
+gboolean      gconf_cleaner_analyze_current_dir             (GConfCleaner  *gcleaner,
+							     GError       **error);
+void          gconf_cleaner_set_n_threads                   (GConfCleaner  *gcleaner,
+							     guint          n_threads);
+gboolean      gconf_cleaner_analyze                         (GConfCleaner  *gcleaner,
+							     GError       **error);
+gboolean      gconf_cleaner_foreach_unknown                 (GConfCleaner  *gcleaner,
+							     GConfCleanerForeachFunc func,
+							     gpointer       user_data,
+							     GError       **error);
 GSList       *gconf_cleaner_get_unknown_pairs_at_current_dir(GConfCleaner  *gcleaner,
 							     GError       **error);
+GSList       *gconf_cleaner_get_unknown_pairs               (GConfCleaner  *gcleaner,
+							     GError       **error);
+const GConfCleanerResult *gconf_cleaner_get_result          (GConfCleaner  *gcleaner);
+guint         gconf_cleaner_result_n_dirs                   (const GConfCleanerResult *result);
+gchar        *gconf_cleaner_result_dup_dir                  (const GConfCleanerResult *result,
+							     guint          index);
+guint         gconf_cleaner_result_n_pairs                  (const GConfCleanerResult *result);
+gchar        *gconf_cleaner_result_dup_key                  (const GConfCleanerResult *result,
+							     guint          index);
+const gchar  *gconf_cleaner_result_get_key_name             (const GConfCleanerResult *result,
+							     guint          index);
+GConfValue   *gconf_cleaner_result_get_value                (const GConfCleanerResult *result,
+							     guint          index);
+guint         gconf_cleaner_result_get_pair_dir             (const GConfCleanerResult *result,
+							     guint          index);
 void          gconf_cleaner_pairs_free                      (GSList        *list);
 void          gconf_cleaner_unset_key                       (GConfCleaner  *gcleaner,
 							     const gchar   *key,
 							     GError       **error);
+void          gconf_cleaner_set_unset_batch_size            (GConfCleaner  *gcleaner,
+							     guint          size);
+guint         gconf_cleaner_get_unset_batch_size            (GConfCleaner  *gcleaner);
+guint         gconf_cleaner_unset_keys                      (GConfCleaner  *gcleaner,
+							     const gchar * const *keys,
+							     guint          n_keys,
+							     GConfCleanerUnsetFunc func,
+							     gpointer       user_data);
+guint         gconf_cleaner_unset_keys_offline              (GConfCleaner  *gcleaner,
+							     const gchar * const *keys,
+							     guint          n_keys,
+							     GError       **error);
+guint         gconf_cleaner_prune_empty_dirs                (GConfCleaner  *gcleaner,
+							     GError       **error);
+gboolean      gconf_cleaner_compact                         (GConfCleaner  *gcleaner,
+							     GConfCleanerCompaction *compaction,
+							     GError       **error);
+gboolean      gconf_cleaner_restore                         (GConfCleaner  *gcleaner,
+							     const gchar   *filename,
+							     guint         *n_restored,
+							     guint         *n_skipped,
+							     guint         *n_failed,
+							     GError       **error);
 void          gconf_cleaner_sync                            (GConfCleaner  *gcleaner,
 							     GError       **error);
+const GConfCleanerStats *gconf_cleaner_get_stats            (GConfCleaner  *gcleaner);
+const gchar  *gconf_cleaner_phase_get_name                  (GConfCleanerPhase phase);
+const gchar  *gconf_cleaner_call_get_name                   (GConfCleanerCall call);
+gchar        *gconf_cleaner_stats_dump                      (const GConfCleanerStats *stats);
+GConfCleanerFootprint *gconf_cleaner_get_footprints         (GConfCleaner  *gcleaner,
+							     guint          n,
+							     guint         *n_footprints);
+gsize         gconf_cleaner_unknown_size                    (GConfCleaner  *gcleaner);
+void          gconf_cleaner_footprints_free                 (GConfCleanerFootprint *footprints,
+							     guint          n_footprints);
+gchar        *gconf_cleaner_footprints_dump                 (const GConfCleanerFootprint *footprints,
+							     guint          n_footprints);
 
 G_END_DECLS
 
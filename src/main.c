@@ -32,15 +32,29 @@
 #include <gtk/gtk.h>
 #include <gconf/gconf.h>
 #include "gconf-cleaner.h"
+#include "gconf-cleaner-backup.h"
+#include "gconf-cleaner-fleet.h"
+#include "gconf-cleaner-model.h"
 
 
 typedef struct _GConfCleanerInstance {
 	GConfCleaner *cleaner;
 	GtkWidget    *window;
 	GPtrArray    *pages;
-	GSList       *pairs;
 	gchar        *name;
 	guint         n_unknown_pairs;
+	/* the worker thread */
+	GThread      *thread;
+	GAsyncQueue  *queue;
+	volatile gint cancelled;
+	GtkWidget    *progress_widget;
+	gchar        *resume;	/* the checkpoint to start from */
+	GPtrArray    *keys;
+	guint         n_processed;
+	guint         n_cleaned;
+	guint         n_pruned;
+	guint         n_failed;
+	gchar        *failure;
 	/* page 2 */
 	GtkWidget    *label_progress;
 	GtkWidget    *progressbar;
@@ -48,23 +62,98 @@ typedef struct _GConfCleanerInstance {
 	GtkWidget    *label_n_dirs;
 	GtkWidget    *label_n_pairs;
 	GtkWidget    *label_n_unknown_pairs;
+	GtkWidget    *label_unknown_size;
 	GtkWidget    *expander;
 	GtkWidget    *treeview;
+	GtkWidget    *expander_footprints;
+	GtkWidget    *treeview_footprints;
 	GtkWidget    *hbox;
 	GtkWidget    *label_message;
 	/* page 4 */
 	GtkWidget    *progressbar2;
 	/* page 5 */
 	GtkWidget    *label_cleaned_pairs;
+	GtkWidget    *label_stats;
 } GConfCleanerInstance;
+typedef struct _GConfCleanerProgress {
+	gint         type;
+	guint        n;
+	guint        total;
+	gchar       *text;
+	const gchar *primary_text;
+} GConfCleanerProgress;
 typedef struct _GConfCleanerPageCallback {
 	GtkWidget *widget;
 	GSourceFunc func;
 } GConfCleanerPageCallback;
-
-
-static gchar *_gconf_cleaner_value_to_string(GConfValue *value,
-					     gint        indent);
+typedef struct _GConfCleanerOptions {
+	gboolean   scan;
+	gboolean   clean;
+	gchar     *backup;
+	gboolean   direct;
+	gchar    **sources;
+	gint       n_threads;
+	gchar     *cache;
+	gboolean   invalidate_cache;
+	gint       batch_size;
+	gboolean   compress;
+	gchar     *restore;
+	gchar    **excludes;
+	gchar     *exclude_from;
+	gboolean   no_default_excludes;
+	gboolean   schema_index;
+	gchar     *stats;
+	gchar     *checkpoint;
+	gint       checkpoint_interval;
+	gchar     *resume;
+	gchar     *fleet;
+	gint       top;
+	gchar     *footprints;
+	gboolean   offline;
+	gboolean   compact;
+} GConfCleanerOptions;
+typedef struct _GConfCleanerBatch {
+	GConfCleaner        *cleaner;
+	GConfCleanerOptions *options;
+	GConfCleanerBackupWriter *writer;
+	GError              *backup_error;
+	GPtrArray           *keys;
+	guint                n_cleaned;
+	guint                n_pruned;
+	gint                 retval;
+} GConfCleanerBatch;
+
+enum {
+	GCLEANER_PROGRESS_STAGE,
+	GCLEANER_PROGRESS_STEP,
+	GCLEANER_PROGRESS_DONE,
+	GCLEANER_PROGRESS_FAILED,
+	GCLEANER_PROGRESS_CANCELLED,
+};
+enum {
+	GCLEANER_FOOTPRINT_COLUMN_PATH,
+	GCLEANER_FOOTPRINT_COLUMN_KEYS,
+	GCLEANER_FOOTPRINT_COLUMN_CLEANABLE,
+	GCLEANER_FOOTPRINT_COLUMN_SIZE,
+	GCLEANER_FOOTPRINT_COLUMN_LIST,
+	GCLEANER_FOOTPRINT_N_COLUMNS
+};
+enum {
+	GCLEANER_EXIT_SUCCESS = 0,
+	GCLEANER_EXIT_FOUND,	/* cleanable keys were found but not cleaned */
+	GCLEANER_EXIT_USAGE,
+	GCLEANER_EXIT_FAILED,
+};
+
+
+/* how many times per second the progress is redrawn at most */
+#define GCLEANER_PROGRESS_FPS	20
+/* how many directories are analyzed between the checkpoints by default */
+#define GCLEANER_CHECKPOINT_INTERVAL	1000
+/* how many of the keys cleanable in the most users are listed by default */
+#define GCLEANER_FLEET_TOP	20
+/* how many of the heaviest directories are shown in the GUI */
+#define GCLEANER_FOOTPRINT_TOP	20
 
 static GQuark quark_question_response = 0;
 
@@ -139,139 +228,6 @@ _gconf_cleaner_question_dialog(GConfCleanerInstance *inst,
 	return retval;
 }
 
-static const gchar *
-_gconf_cleaner_value_type_to_string(GConfValueType type)
-{
-	switch (type) {
-	    case GCONF_VALUE_INT:
-		    return "int";
-	    case GCONF_VALUE_STRING:
-		    return "string";
-	    case GCONF_VALUE_FLOAT:
-		    return "float";
-	    case GCONF_VALUE_BOOL:
-		    return "bool";
-	    case GCONF_VALUE_LIST:
-		    return "list";
-	    case GCONF_VALUE_PAIR:
-		    return "pair";
-	    default:
-		    g_assert_not_reached();
-		    return NULL;
-	}
-}
-
-static gchar *
-_gconf_cleaner_value_list_to_string(GConfValue *value,
-				    gint        indent)
-{
-	gchar *whitespace, *tmp;
-	GConfValueType list_type;
-	GString *retval;
-	GSList *l;
-
-	g_return_val_if_fail (value->type == GCONF_VALUE_LIST, NULL);
-
-	retval = g_string_new(NULL);
-	whitespace = g_strnfill(indent, ' ');
-	list_type = gconf_value_get_list_type(value);
-	g_string_append_printf(retval, "%s<list type=\"%s\">\n",
-			       whitespace, _gconf_cleaner_value_type_to_string(list_type));
-	l = gconf_value_get_list(value);
-	while (l) {
-		tmp = _gconf_cleaner_value_to_string(l->data, indent + 4);
-		g_string_append(retval, tmp);
-		g_free(tmp);
-		l = g_slist_next(l);
-	}
-	g_string_append_printf(retval, "%s</list>\n", whitespace);
-
-	g_free(whitespace);
-
-	return g_string_free(retval, FALSE);
-}
-
-static gchar *
-_gconf_cleaner_value_pair_to_string(GConfValue *value,
-				    gint        indent)
-{
-	gchar *whitespace, *tmp;
-	GString *retval;
-
-	g_return_val_if_fail (value->type == GCONF_VALUE_PAIR, NULL);
-
-	retval = g_string_new(NULL);
-	whitespace = g_strnfill(indent, ' ');
-	g_string_append_printf(retval, "%s<pair>\n", whitespace);
-
-	g_string_append_printf(retval, "%s  <car>\n", whitespace);
-	tmp = _gconf_cleaner_value_to_string(gconf_value_get_car(value), indent + 4);
-	g_string_append(retval, tmp);
-	g_free(tmp);
-	g_string_append_printf(retval, "%s  </car>\n", whitespace);
-
-	g_string_append_printf(retval, "%s  <cdr>\n", whitespace);
-	tmp = _gconf_cleaner_value_to_string(gconf_value_get_cdr(value), indent + 4);
-	g_string_append(retval, tmp);
-	g_free(tmp);
-	g_string_append_printf(retval, "%s  </cdr>\n", whitespace);
-
-	g_string_append_printf(retval, "%s</pair>\n", whitespace);
-
-	g_free(whitespace);
-
-	return g_string_free(retval, FALSE);
-}
-
-static gchar *
-_gconf_cleaner_value_to_string(GConfValue *value,
-			       gint        indent)
-{
-	GString *retval = g_string_new(NULL);
-	gchar *whitespace = g_strnfill(indent, ' '), *tmp;
-
-	g_string_append_printf(retval, "%s<value>\n", whitespace);
-
-	switch (value->type) {
-	    case GCONF_VALUE_INT:
-		    g_string_append_printf(retval, "%s  <int>%d</int>\n",
-					   whitespace, gconf_value_get_int(value));
-		    break;
-	    case GCONF_VALUE_FLOAT:
-		    g_string_append_printf(retval, "%s  <float>%.17g</float>\n",
-					   whitespace, gconf_value_get_float(value));
-		    break;
-	    case GCONF_VALUE_STRING:
-		    tmp = g_markup_escape_text(gconf_value_get_string(value), -1);
-		    g_string_append_printf(retval, "%s  <string>%s</string>\n",
-					   whitespace, (tmp[0] == ' ' && tmp[1] == '\0') ? "" : tmp);
-		    g_free(tmp);
-		    break;
-	    case GCONF_VALUE_BOOL:
-		    g_string_append_printf(retval, "%s  <bool>%s</bool>\n",
-					   whitespace, gconf_value_get_bool(value) ? "true" : "false");
-		    break;
-	    case GCONF_VALUE_LIST:
-		    tmp = _gconf_cleaner_value_list_to_string(value, indent + 2);
-		    g_string_append(retval, tmp);
-		    g_free(tmp);
-		    break;
-	    case GCONF_VALUE_PAIR:
-		    tmp = _gconf_cleaner_value_pair_to_string(value, indent + 2);
-		    g_string_append(retval, tmp);
-		    g_free(tmp);
-		    break;
-	    default:
-		    g_assert_not_reached();
-		    break;
-	}
-	g_string_append_printf(retval, "%s</value>\n", whitespace);
-
-	g_free(whitespace);
-
-	return g_string_free(retval, FALSE);
-}
-
 static void
 _gconf_cleaner_about_url_cb(GtkAboutDialog *about,
 			    const gchar    *link,
@@ -317,6 +273,68 @@ _gconf_cleaner_button_about_on_clicked(GtkButton *button,
 			      NULL);
 }
 
+static void
+_gconf_cleaner_restore_on_response(GtkDialog *dialog,
+				   gint       response_id,
+				   gpointer   data)
+{
+	if (response_id == GTK_RESPONSE_OK) {
+		GConfCleanerInstance *inst = data;
+		GError *error = NULL;
+		GtkWidget *info;
+		gchar *filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER (dialog));
+		guint n_restored, n_skipped, n_failed;
+
+		gtk_widget_hide(GTK_WIDGET (dialog));
+		if (!gconf_cleaner_restore(inst->cleaner, filename,
+					   &n_restored, &n_skipped, &n_failed, &error)) {
+			_gconf_cleaner_error_dialog(inst,
+						    _("Failed during restoring GConf keys"),
+						    error->message,
+						    FALSE);
+			g_error_free(error);
+		} else {
+			gconf_cleaner_sync(inst->cleaner, NULL);
+			info = gtk_message_dialog_new(GTK_WINDOW (inst->window),
+						      GTK_DIALOG_MODAL,
+						      n_failed > 0 ? GTK_MESSAGE_WARNING : GTK_MESSAGE_INFO,
+						      GTK_BUTTONS_OK,
+						      _("%d GConf keys has been restored, %d skipped, %d failed."),
+						      n_restored, n_skipped, n_failed);
+			gtk_dialog_run(GTK_DIALOG (info));
+			gtk_widget_destroy(info);
+		}
+		g_free(filename);
+	}
+	gtk_widget_destroy(GTK_WIDGET (dialog));
+}
+
+static void
+_gconf_cleaner_button_restore_on_clicked(GtkButton *button,
+					 gpointer   data)
+{
+	GConfCleanerInstance *inst = data;
+	GtkWidget *dialog;
+
+	/* the worker thread owns the cleaner */
+	if (inst->thread != NULL)
+		return;
+
+	dialog = gtk_file_chooser_dialog_new(_("Restore GConf keys from..."),
+					     GTK_WINDOW (inst->window),
+					     GTK_FILE_CHOOSER_ACTION_OPEN,
+					     GTK_STOCK_CANCEL,
+					     GTK_RESPONSE_CANCEL,
+					     GTK_STOCK_OPEN,
+					     GTK_RESPONSE_OK,
+					     NULL);
+	g_signal_connect(dialog, "response",
+			 G_CALLBACK (_gconf_cleaner_restore_on_response),
+			 inst);
+
+	gtk_dialog_run(GTK_DIALOG (dialog));
+}
+
 static void
 _gconf_cleaner_on_assistant_cancel(GtkWidget *widget,
 				   gpointer   data)
@@ -326,6 +344,8 @@ _gconf_cleaner_on_assistant_cancel(GtkWidget *widget,
 	if (_gconf_cleaner_question_dialog(inst,
 					   _("<span weight=\"bold\" size=\"larger\">Do you want to leave GConf Cleaner?</span>"),
 					   _("If you leave here, any GConf keys will not be cleaned up."))) {
+		/* the worker thread stops at the next directory or key */
+		g_atomic_int_set(&inst->cancelled, TRUE);
 		gtk_main_quit();
 	}
 }
@@ -359,24 +379,41 @@ _gconf_cleaner_cell_renderer_on_toggled(GtkCellRendererToggle *cell,
 					gpointer               data)
 {
 	GConfCleanerInstance *inst = data;
-	GtkTreeModel *model;
-	GtkTreeIter iter;
+	GConfCleanerModel *model;
 	GtkTreePath *path = gtk_tree_path_new_from_string(path_str);
-	gboolean flag;
 
-	model = gtk_tree_view_get_model(GTK_TREE_VIEW (inst->treeview));
-	gtk_tree_model_get_iter(model, &iter, path);
-	gtk_tree_model_get(model, &iter, 0, &flag, -1);
+	model = GCLEANER_MODEL (gtk_tree_view_get_model(GTK_TREE_VIEW (inst->treeview)));
+	gconf_cleaner_model_toggle(model, path);
+	inst->n_unknown_pairs = gconf_cleaner_model_n_active(model);
 
-	flag ^= 1;
-	if (flag)
-		inst->n_unknown_pairs++;
-	else
-		inst->n_unknown_pairs--;
+	gtk_tree_path_free(path);
+}
 
-	gtk_list_store_set(GTK_LIST_STORE (model), &iter, 0, flag, -1);
+static gboolean
+_gconf_cleaner_save_result(const GConfCleanerResult  *result,
+			   const gchar               *filename,
+			   gboolean                   compress,
+			   GError                   **error)
+{
+	GConfCleanerBackupWriter *writer;
+	guint i, n_pairs = gconf_cleaner_result_n_pairs(result);
 
-	gtk_tree_path_free(path);
+	if ((writer = gconf_cleaner_backup_writer_new(filename, compress, error)) == NULL)
+		return FALSE;
+	for (i = 0; i < n_pairs; i++) {
+		gchar *key = gconf_cleaner_result_dup_key(result, i);
+
+		if (!gconf_cleaner_backup_writer_add(writer, key,
+						     gconf_cleaner_result_get_value(result, i),
+						     error)) {
+			g_free(key);
+			gconf_cleaner_backup_writer_close(writer, NULL);
+			return FALSE;
+		}
+		g_free(key);
+	}
+
+	return gconf_cleaner_backup_writer_close(writer, error);
 }
 
 static void
@@ -386,36 +423,19 @@ _gconf_cleaner_save_on_response(GtkDialog *dialog,
 {
 	if (response_id == GTK_RESPONSE_OK) {
 		GConfCleanerInstance *inst = data;
-		GString *dump = g_string_new(NULL);
-		GSList *l;
-		FILE *fp;
+		GError *error = NULL;
 		struct stat st;
 		gchar *filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER (dialog));
+		GtkWidget *check = gtk_file_chooser_get_extra_widget(GTK_FILE_CHOOSER (dialog));
+		gboolean compress = g_str_has_suffix(filename, ".gz");
 
-		g_string_append_printf(dump,
-				       "<gconfentryfile>\n"
-				       "  <entrylist base=\"/\">\n");
-				       
-		for (l = inst->pairs; l != NULL; l = g_slist_next(l)) {
-			gchar *key;
-			GConfValue *val;
-			gchar *tmp;
-
-			key = l->data;
-			l = g_slist_next(l);
-			val = l->data;
-			tmp = _gconf_cleaner_value_to_string(val, 6);
-			g_string_append_printf(dump,
-					       "    <entry>\n"
-					       "      <key>%s</key>\n"
-					       "%s"
-					       "    </entry>\n", key, tmp);
-			g_free(tmp);
-		}
+		if (check && gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON (check)) && !compress) {
+			gchar *tmp = g_strconcat(filename, ".gz", NULL);
 
-		g_string_append_printf(dump,
-				       "  </entrylist>\n"
-				       "</gconfentryfile>\n");
+			g_free(filename);
+			filename = tmp;
+			compress = TRUE;
+		}
 
 		if (stat(filename, &st) == 0) {
 			gchar *msg = g_strdup_printf(_("If you save the data as %s, original data will be lost."), filename);
@@ -428,27 +448,15 @@ _gconf_cleaner_save_on_response(GtkDialog *dialog,
 			if (!retval)
 				return;
 		}
-		if ((fp = fopen(filename, "wb")) == NULL) {
-			gchar *msg = g_strdup_printf(_("Failed during opening %s"),
-						     filename);
+		if (!_gconf_cleaner_save_result(gconf_cleaner_get_result(inst->cleaner),
+						filename, compress, &error)) {
 			_gconf_cleaner_error_dialog(inst,
-						    msg,
-						    strerror(errno),
+						    _("Failed during saving GConf keys"),
+						    error->message,
 						    FALSE);
-			g_free(msg);
-		} else {
-			size_t retval = fwrite(dump->str, sizeof (gchar), dump->len, fp);
-
-			if (retval != dump->len) {
-				_gconf_cleaner_error_dialog(inst,
-							    _("Failed during saving GConf keys"),
-							    strerror(errno),
-							    FALSE);
-			}
-			fclose(fp);
+			g_error_free(error);
 		}
-
-		g_string_free(dump, TRUE);
+		g_free(filename);
 	}
 	gtk_widget_destroy(GTK_WIDGET (dialog));
 }
@@ -479,6 +487,11 @@ _gconf_cleaner_save_on_clicked(GtkButton *button,
 					     GTK_RESPONSE_OK,
 					     NULL);
 	gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER (dialog), inst->name);
+	if (gconf_cleaner_backup_is_compression_supported()) {
+		GtkWidget *check = gtk_check_button_new_with_mnemonic(_("_Compress with gzip"));
+
+		gtk_file_chooser_set_extra_widget(GTK_FILE_CHOOSER (dialog), check);
+	}
 	g_signal_connect(dialog, "response",
 			 G_CALLBACK (_gconf_cleaner_save_on_response),
 			 inst);
@@ -486,77 +499,247 @@ _gconf_cleaner_save_on_clicked(GtkButton *button,
 	gtk_dialog_run(GTK_DIALOG (dialog));
 }
 
+/* called from the worker thread */
+static void
+_gconf_cleaner_progress_push(GConfCleanerInstance *inst,
+			     gint                  type,
+			     guint                 n,
+			     guint                 total,
+			     const gchar          *text,
+			     const gchar          *primary_text)
+{
+	GConfCleanerProgress *progress = g_new0(GConfCleanerProgress, 1);
+
+	progress->type = type;
+	progress->n = n;
+	progress->total = total;
+	progress->text = g_strdup(text);
+	progress->primary_text = primary_text;
+	g_async_queue_push(inst->queue, progress);
+}
+
+static void
+_gconf_cleaner_progress_free(GConfCleanerProgress *progress)
+{
+	g_free(progress->text);
+	g_free(progress);
+}
+
+static void
+_gconf_cleaner_page_complete(GConfCleanerInstance *inst)
+{
+	GtkWidget *page;
+
+	page = gtk_assistant_get_nth_page(GTK_ASSISTANT (inst->window),
+					  gtk_assistant_get_current_page(GTK_ASSISTANT (inst->window)));
+	gtk_assistant_set_page_complete(GTK_ASSISTANT (inst->window),
+					page, TRUE);
+	gtk_widget_set_sensitive(GTK_ASSISTANT (inst->window)->back, FALSE);
+	g_signal_emit_by_name(GTK_ASSISTANT (inst->window)->forward, "clicked");
+}
+
+/*
+ * pick up the messages from the worker thread.  only the latest step
+ * is drawn, so that the worker never waits for the redraws.
+ */
 static gboolean
-_gconf_cleaner_run_analysis_cb(gpointer data)
+_gconf_cleaner_progress_cb(gpointer data)
 {
 	GConfCleanerInstance *inst = data;
+	GConfCleanerProgress *progress, *step = NULL, *result = NULL;
+
+	while (result == NULL &&
+	       (progress = g_async_queue_try_pop(inst->queue)) != NULL) {
+		switch (progress->type) {
+		    case GCLEANER_PROGRESS_STAGE:
+			    gtk_label_set_text(GTK_LABEL (inst->label_progress),
+					       progress->text);
+			    _gconf_cleaner_progress_free(progress);
+			    break;
+		    case GCLEANER_PROGRESS_STEP:
+			    if (step)
+				    _gconf_cleaner_progress_free(step);
+			    step = progress;
+			    break;
+		    default:
+			    result = progress;
+			    break;
+		}
+	}
+	if (step) {
+		gtk_progress_bar_set_text(GTK_PROGRESS_BAR (inst->progress_widget), step->text);
+		gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR (inst->progress_widget),
+					      (gdouble)step->n / (gdouble)step->total);
+		_gconf_cleaner_progress_free(step);
+	}
+	if (result == NULL)
+		return TRUE;
+
+	g_thread_join(inst->thread);
+	inst->thread = NULL;
+	switch (result->type) {
+	    case GCLEANER_PROGRESS_DONE:
+		    /* some of the steps failed, but it could go on */
+		    if (result->text)
+			    _gconf_cleaner_error_dialog(inst,
+							result->primary_text,
+							result->text,
+							FALSE);
+		    _gconf_cleaner_page_complete(inst);
+		    break;
+	    case GCLEANER_PROGRESS_FAILED:
+		    _gconf_cleaner_error_dialog(inst,
+						result->primary_text,
+						result->text,
+						TRUE);
+		    break;
+	    default:
+		    break;
+	}
+	_gconf_cleaner_progress_free(result);
+
+	return FALSE;
+}
+
+static void
+_gconf_cleaner_run_thread(GConfCleanerInstance *inst,
+			  GThreadFunc           func,
+			  GtkWidget            *progressbar)
+{
 	GError *error = NULL;
-	guint n_dirs, i;
-	const gchar *text;
-	GSList *l;
-	GtkWidget *page;
 
-	if (inst->pairs) {
-		gconf_cleaner_pairs_free(inst->pairs);
-		inst->pairs = NULL;
-	}
-	gtk_label_set_text(GTK_LABEL (inst->label_progress),
-			   _("Retrieving the GConf directories..."));
-	while (g_main_context_pending(NULL))
-		g_main_context_iteration(NULL, TRUE);
+	gtk_progress_bar_set_orientation(GTK_PROGRESS_BAR (progressbar),
+					 GTK_PROGRESS_LEFT_TO_RIGHT);
+	gtk_progress_bar_set_ellipsize(GTK_PROGRESS_BAR (progressbar),
+				       PANGO_ELLIPSIZE_MIDDLE);
+	gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR (progressbar), 0.0);
 
-	gconf_cleaner_update(inst->cleaner, &error);
-	if (G_UNLIKELY (error != NULL)) {
+	inst->progress_widget = progressbar;
+	inst->thread = g_thread_create(func, inst, TRUE, &error);
+	if (G_UNLIKELY (inst->thread == NULL)) {
 		_gconf_cleaner_error_dialog(inst,
 					    _("<span weight=\"bold\" size=\"larger\">Failed during the initialization</span>"),
 					    error->message,
 					    TRUE);
-		return FALSE;
+		g_error_free(error);
+		return;
 	}
+	g_timeout_add(1000 / GCLEANER_PROGRESS_FPS, _gconf_cleaner_progress_cb, inst);
+}
 
-	gtk_label_set_text(GTK_LABEL (inst->label_progress),
-			   _("Analyzing the GConf directories..."));
-
-	while (g_main_context_pending(NULL))
-		g_main_context_iteration(NULL, TRUE);
+/*
+ * GConf isn't thread-safe.  nothing else touches inst->cleaner while
+ * the worker thread is running.
+ */
+static gpointer
+_gconf_cleaner_analysis_thread(gpointer data)
+{
+	GConfCleanerInstance *inst = data;
+	GError *error = NULL;
+	guint i;
+
+	_gconf_cleaner_progress_push(inst, GCLEANER_PROGRESS_STAGE, 0, 0,
+				     _("Analyzing the GConf directories..."), NULL);
+	/* analyze the directories while the rest of the tree is still traversed */
+	if (inst->resume) {
+		gchar *filename = inst->resume;
+
+		/* only the first scan is resumed */
+		inst->resume = NULL;
+		if (!gconf_cleaner_resume(inst->cleaner, filename, &error)) {
+			g_warning(_("Starting over the scan: %s"), error->message);
+			g_clear_error(&error);
+			gconf_cleaner_traverse_begin(inst->cleaner);
+		}
+		g_free(filename);
+	} else {
+		gconf_cleaner_traverse_begin(inst->cleaner);
+	}
+	for (i = gconf_cleaner_n_analyzed_dirs(inst->cleaner); ; i++) {
+		if (g_atomic_int_get(&inst->cancelled)) {
+			/* the scan can be continued next time */
+			if (!gconf_cleaner_save_checkpoint(inst->cleaner, &error)) {
+				g_warning(_("Failed to save the checkpoint: %s"), error->message);
+				g_clear_error(&error);
+			}
+			gconf_cleaner_traverse_cancel(inst->cleaner);
+			_gconf_cleaner_progress_push(inst, GCLEANER_PROGRESS_CANCELLED, 0, 0, NULL, NULL);
+			return NULL;
+		}
+		while (i >= gconf_cleaner_n_dirs(inst->cleaner) &&
+		       gconf_cleaner_traverse_step(inst->cleaner, &error));
+		if (G_UNLIKELY (error != NULL)) {
+			_gconf_cleaner_progress_push(inst, GCLEANER_PROGRESS_FAILED, 0, 0,
+						     error->message,
+						     _("<span weight=\"bold\" size=\"larger\">Failed during the initialization</span>"));
+			g_error_free(error);
+			return NULL;
+		}
+		if (i >= gconf_cleaner_n_dirs(inst->cleaner))
+			break;
+		/* the pending directories are the estimate of the rest */
+		_gconf_cleaner_progress_push(inst, GCLEANER_PROGRESS_STEP, i,
+					     gconf_cleaner_n_dirs(inst->cleaner) +
+					     gconf_cleaner_traverse_n_pending(inst->cleaner),
+					     gconf_cleaner_get_current_dir(inst->cleaner), NULL);
+		if (!gconf_cleaner_analyze_current_dir(inst->cleaner, &error)) {
+			_gconf_cleaner_progress_push(inst, GCLEANER_PROGRESS_FAILED, 0, 0,
+						     error->message,
+						     _("<span weight=\"bold\" size=\"larger\">Failed during analyzing the GConf key</span>"));
+			g_error_free(error);
+			return NULL;
+		}
+	}
+	if (!gconf_cleaner_save_scan_cache(inst->cleaner, &error)) {
+		g_warning(_("Failed during saving the scan cache: %s"), error->message);
+		g_clear_error(&error);
+	}
+	_gconf_cleaner_progress_push(inst, GCLEANER_PROGRESS_DONE, 0, 0, NULL, NULL);
 
-	n_dirs = gconf_cleaner_n_dirs(inst->cleaner);
+	return NULL;
+}
 
-	gtk_progress_bar_set_orientation(GTK_PROGRESS_BAR (inst->progressbar),
-					 GTK_PROGRESS_LEFT_TO_RIGHT);
-	gtk_progress_bar_set_ellipsize(GTK_PROGRESS_BAR (inst->progressbar),
-				       PANGO_ELLIPSIZE_MIDDLE);
-	gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR (inst->progressbar), 0.0);
+static gboolean
+_gconf_cleaner_run_analysis_cb(gpointer data)
+{
+	GConfCleanerInstance *inst = data;
 
-	while (g_main_context_pending(NULL))
-		g_main_context_iteration(NULL, TRUE);
+	/* the model refers to the result which is about to be rebuilt */
+	gtk_tree_view_set_model(GTK_TREE_VIEW (inst->treeview), NULL);
+	_gconf_cleaner_run_thread(inst, _gconf_cleaner_analysis_thread, inst->progressbar);
 
-	for (i = 0; i < n_dirs; i++) {
-		text = gconf_cleaner_get_current_dir(inst->cleaner);
-		gtk_progress_bar_set_text(GTK_PROGRESS_BAR (inst->progressbar), text);
-		gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR (inst->progressbar), (gdouble)i / (gdouble)n_dirs);
-		while (g_main_context_pending(NULL))
-			g_main_context_iteration(NULL, TRUE);
+	return FALSE;
+}
 
-		l = gconf_cleaner_get_unknown_pairs_at_current_dir(inst->cleaner, &error);
-		if (G_UNLIKELY (error != NULL)) {
-			_gconf_cleaner_error_dialog(inst,
-						    _("<span weight=\"bold\" size=\"larger\">Failed during analyzing the GConf key</span>"),
-						    error->message,
-						    TRUE);
-			return FALSE;
-		} else {
-			inst->pairs = g_slist_concat(inst->pairs, l);
-		}
+static void
+_gconf_cleaner_update_footprints(GConfCleanerInstance *inst)
+{
+	GConfCleanerFootprint *footprints;
+	GtkListStore *store;
+	GtkTreeIter iter;
+	guint i, n;
+
+	store = gtk_list_store_new(GCLEANER_FOOTPRINT_N_COLUMNS,
+				   G_TYPE_STRING, G_TYPE_UINT, G_TYPE_UINT,
+				   G_TYPE_ULONG, G_TYPE_UINT);
+	footprints = gconf_cleaner_get_footprints(inst->cleaner, GCLEANER_FOOTPRINT_TOP, &n);
+	for (i = 0; i < n; i++) {
+		gtk_list_store_append(store, &iter);
+		gtk_list_store_set(store, &iter,
+				   GCLEANER_FOOTPRINT_COLUMN_PATH, footprints[i].path,
+				   GCLEANER_FOOTPRINT_COLUMN_KEYS, footprints[i].n_pairs,
+				   GCLEANER_FOOTPRINT_COLUMN_CLEANABLE, footprints[i].n_unknown_pairs,
+				   GCLEANER_FOOTPRINT_COLUMN_SIZE, (gulong)footprints[i].unknown_size,
+				   GCLEANER_FOOTPRINT_COLUMN_LIST, footprints[i].max_list_length,
+				   -1);
 	}
-	page = gtk_assistant_get_nth_page(GTK_ASSISTANT (inst->window),
-					  gtk_assistant_get_current_page(GTK_ASSISTANT (inst->window)));
-	gtk_assistant_set_page_complete(GTK_ASSISTANT (inst->window),
-					page, TRUE);
-	gtk_widget_set_sensitive(GTK_ASSISTANT (inst->window)->back, FALSE);
-	g_signal_emit_by_name(GTK_ASSISTANT (inst->window)->forward, "clicked");
-
-	return FALSE;
+	gconf_cleaner_footprints_free(footprints, n);
+	gtk_tree_view_set_model(GTK_TREE_VIEW (inst->treeview_footprints), GTK_TREE_MODEL (store));
+	g_object_unref(store);
+	if (n > 0)
+		gtk_widget_show(inst->expander_footprints);
+	else
+		gtk_widget_hide(inst->expander_footprints);
 }
 
 static gboolean
@@ -564,9 +747,7 @@ _gconf_cleaner_run_analyzing_result_cb(gpointer data)
 {
 	GConfCleanerInstance *inst = data;
 	gchar *text;
-	GtkListStore *list;
-	GtkTreeIter iter;
-	GSList *l;
+	GtkTreeModel *model;
 
 	text = g_strdup_printf("%d", gconf_cleaner_n_dirs(inst->cleaner));
 	gtk_label_set_text(GTK_LABEL (inst->label_n_dirs), text);
@@ -578,22 +759,15 @@ _gconf_cleaner_run_analyzing_result_cb(gpointer data)
 	text = g_strdup_printf("%d", inst->n_unknown_pairs);
 	gtk_label_set_text(GTK_LABEL (inst->label_n_unknown_pairs), text);
 	g_free(text);
+	text = g_strdup_printf(_("%lu bytes"), (gulong)gconf_cleaner_unknown_size(inst->cleaner));
+	gtk_label_set_text(GTK_LABEL (inst->label_unknown_size), text);
+	g_free(text);
+	_gconf_cleaner_update_footprints(inst);
 
 	if (inst->n_unknown_pairs > 0) {
-		list = gtk_list_store_new(3, G_TYPE_BOOLEAN, G_TYPE_STRING, G_TYPE_STRING);
-		for (l = inst->pairs; l != NULL; l = g_slist_next(l)) {
-			gchar *str;
-
-			gtk_list_store_append(list, &iter);
-			gtk_list_store_set(list, &iter, 0, TRUE, -1);
-			gtk_list_store_set(list, &iter, 1, l->data, -1);
-			l = g_slist_next(l);
-			str = gconf_value_to_string(l->data);
-			gtk_list_store_set(list, &iter, 2, str, -1);
-			g_free(str);
-		}
-		gtk_tree_view_set_model(GTK_TREE_VIEW (inst->treeview), GTK_TREE_MODEL (list));
-		g_object_unref(list);
+		model = gconf_cleaner_model_new(gconf_cleaner_get_result(inst->cleaner));
+		gtk_tree_view_set_model(GTK_TREE_VIEW (inst->treeview), model);
+		g_object_unref(model);
 		gtk_widget_show(inst->expander);
 		gtk_widget_show(inst->hbox);
 		gtk_label_set_text(GTK_LABEL (inst->label_message),
@@ -609,75 +783,130 @@ _gconf_cleaner_run_analyzing_result_cb(gpointer data)
 }
 
 static gboolean
-_gconf_cleaner_run_cleaning_cb(gpointer data)
+_gconf_cleaner_cleaning_on_unset(const gchar  *key,
+				 const GError *error,
+				 gpointer      data)
+{
+	GConfCleanerInstance *inst = data;
+
+	inst->n_processed++;
+	if (G_UNLIKELY (error != NULL)) {
+		/* keep going and tell the first one later */
+		if (inst->n_failed++ == 0)
+			inst->failure = g_strdup_printf("%s: %s", key, error->message);
+	}
+	_gconf_cleaner_progress_push(inst, GCLEANER_PROGRESS_STEP,
+				     inst->n_processed, inst->keys->len,
+				     key, NULL);
+
+	return !g_atomic_int_get(&inst->cancelled);
+}
+
+static gpointer
+_gconf_cleaner_cleaning_thread(gpointer data)
 {
 	GConfCleanerInstance *inst = data;
-	GtkTreeModel *model;
-	GtkTreeIter iter;
-	gboolean flag;
-	gchar *key;
-	guint i = 0;
-	GtkWidget *page;
 	GError *error = NULL;
 
-	if (inst->n_unknown_pairs == 0)
-		goto next;
-	gtk_progress_bar_set_orientation(GTK_PROGRESS_BAR (inst->progressbar2),
-					 GTK_PROGRESS_LEFT_TO_RIGHT);
-	gtk_progress_bar_set_ellipsize(GTK_PROGRESS_BAR (inst->progressbar2),
-				       PANGO_ELLIPSIZE_MIDDLE);
-	gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR (inst->progressbar2), 0.0);
+	inst->n_cleaned = gconf_cleaner_unset_keys(inst->cleaner,
+						   (const gchar * const *)inst->keys->pdata,
+						   inst->keys->len,
+						   _gconf_cleaner_cleaning_on_unset,
+						   inst);
+	if (g_atomic_int_get(&inst->cancelled)) {
+		_gconf_cleaner_progress_push(inst, GCLEANER_PROGRESS_CANCELLED, 0, 0, NULL, NULL);
+		return NULL;
+	}
+	inst->n_pruned = gconf_cleaner_prune_empty_dirs(inst->cleaner, &error);
+	if (error)
+		g_clear_error(&error);
+	gconf_cleaner_sync(inst->cleaner, &error);
+	if (error)
+		g_error_free(error);
+	if (inst->n_failed > 0) {
+		_gconf_cleaner_progress_push(inst, GCLEANER_PROGRESS_DONE, 0, 0,
+					     inst->failure,
+					     _("<span weight=\"bold\" size=\"larger\">Failed during cleaning GConf key up.</span>"));
+	} else {
+		_gconf_cleaner_progress_push(inst, GCLEANER_PROGRESS_DONE, 0, 0, NULL, NULL);
+	}
 
-	while (g_main_context_pending(NULL))
-		g_main_context_iteration(NULL, TRUE);
+	return NULL;
+}
 
-	model = gtk_tree_view_get_model(GTK_TREE_VIEW (inst->treeview));
-	if (G_LIKELY (gtk_tree_model_get_iter_first(model, &iter))) {
-		do {
-			gtk_tree_model_get(model, &iter, 0, &flag, 1, &key, -1);
-			if (flag) {
-				i++;
-				gtk_progress_bar_set_text(GTK_PROGRESS_BAR (inst->progressbar2), key);
-				gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR (inst->progressbar2),
-							      (gdouble)i / (gdouble)inst->n_unknown_pairs);
-
-				while (g_main_context_pending(NULL))
-					g_main_context_iteration(NULL, TRUE);
-
-				gconf_cleaner_unset_key(inst->cleaner, key, &error);
-				if (G_UNLIKELY (error)) {
-					_gconf_cleaner_error_dialog(inst,
-								    _("<span weight=\"bold\" size=\"larger\">Failed during cleaning GConf key up.</span>"),
-								    error->message,
-								    TRUE);
-					return FALSE;
-				}
-			}
-			g_free(key);
-		} while (gtk_tree_model_iter_next(model, &iter));
-		gconf_cleaner_sync(inst->cleaner, &error);
+static gboolean
+_gconf_cleaner_run_cleaning_cb(gpointer data)
+{
+	GConfCleanerInstance *inst = data;
+	GConfCleanerModel *model;
+	const GConfCleanerResult *result;
+	guint i;
+
+	if (inst->n_unknown_pairs == 0) {
+		_gconf_cleaner_page_complete(inst);
+		return FALSE;
 	}
-  next:
-	page = gtk_assistant_get_nth_page(GTK_ASSISTANT (inst->window),
-					  gtk_assistant_get_current_page(GTK_ASSISTANT (inst->window)));
-	gtk_assistant_set_page_complete(GTK_ASSISTANT (inst->window),
-					page, TRUE);
-	gtk_widget_set_sensitive(GTK_ASSISTANT (inst->window)->back, FALSE);
-	g_signal_emit_by_name(GTK_ASSISTANT (inst->window)->forward, "clicked");
+
+	/* the model belongs to GTK+. pass the keys to the worker instead */
+	model = GCLEANER_MODEL (gtk_tree_view_get_model(GTK_TREE_VIEW (inst->treeview)));
+	result = gconf_cleaner_get_result(inst->cleaner);
+	for (i = 0; i < gconf_cleaner_model_n_rows(model); i++) {
+		if (gconf_cleaner_model_get_active(model, i))
+			g_ptr_array_add(inst->keys, gconf_cleaner_result_dup_key(result, i));
+	}
+	_gconf_cleaner_run_thread(inst, _gconf_cleaner_cleaning_thread, inst->progressbar2);
 
 	return FALSE;
 }
 
+static gchar *
+_gconf_cleaner_stats_to_text(const GConfCleanerStats *stats)
+{
+	GString *text = g_string_new(NULL);
+	guint i, j;
+
+	for (i = 0; i < GCLEANER_N_PHASES; i++) {
+		const GConfCleanerPhaseStats *phase = &stats->phases[i];
+
+		g_string_append_printf(text, _("%s: %.3f seconds (CPU %.3f seconds)"),
+				       gconf_cleaner_phase_get_name(i),
+				       phase->wall_time, phase->cpu_time);
+		for (j = 0; j < GCLEANER_N_CALLS; j++) {
+			if (phase->n_calls[j] > 0)
+				g_string_append_printf(text, ", %s %u",
+						       gconf_cleaner_call_get_name(j),
+						       phase->n_calls[j]);
+		}
+		g_string_append_c(text, '\n');
+	}
+	g_string_append_printf(text, _("Result: %lu bytes\n"), (gulong)stats->result_size);
+	if (stats->n_slowest_dirs > 0)
+		g_string_append(text, _("Slowest directories:\n"));
+	for (i = 0; i < stats->n_slowest_dirs; i++)
+		g_string_append_printf(text, "  %s (%.3f)\n",
+				       stats->slowest_dirs[i], stats->slowest_times[i]);
+
+	return g_string_free(text, FALSE);
+}
+
 static gboolean
 _gconf_cleaner_run_finish_cb(gpointer data)
 {
 	GConfCleanerInstance *inst = data;
-	gchar *text;
-
-	text = g_strdup_printf(_("%d of %d GConf keys has been cleaned up successfully."),
-			       inst->n_unknown_pairs,
-			       gconf_cleaner_n_unknown_pairs(inst->cleaner));
+	gchar *cleaned, *pruned, *text;
+
+	cleaned = g_strdup_printf(_("%d of %d GConf keys has been cleaned up successfully."),
+				  inst->n_cleaned,
+				  gconf_cleaner_n_unknown_pairs(inst->cleaner));
+	pruned = g_strdup_printf(_("%d empty GConf directories has been removed."),
+				 inst->n_pruned);
+	text = g_strconcat(cleaned, "\n", pruned, NULL);
 	gtk_label_set_text(GTK_LABEL (inst->label_cleaned_pairs), text);
+	g_free(cleaned);
+	g_free(pruned);
+	g_free(text);
+	text = _gconf_cleaner_stats_to_text(gconf_cleaner_get_stats(inst->cleaner));
+	gtk_label_set_text(GTK_LABEL (inst->label_stats), text);
 	g_free(text);
 
 	return FALSE;
@@ -735,11 +964,21 @@ _gconf_cleaner_create_page(GConfCleanerInstance *inst)
 	} G_STMT_END;
 	/* page 3 */
 	G_STMT_START {
-		GtkWidget *table, *vbox, *label_dirs, *label_keys, *label_pairs;
-		GtkWidget *scrolled, *label_save, *button_save;
+		GtkWidget *table, *vbox, *label_dirs, *label_keys, *label_pairs, *label_size;
+		GtkWidget *scrolled, *scrolled2, *label_save, *button_save;
 		GtkCellRenderer *renderer;
 		GtkTreeViewColumn *column;
-		gint i, rows = 3;
+		gint i, rows = 4;
+		static const struct {
+			const gchar *title;
+			gint         column;
+		} footprint_columns[] = {
+			{N_("Directory"), GCLEANER_FOOTPRINT_COLUMN_PATH},
+			{N_("Keys"), GCLEANER_FOOTPRINT_COLUMN_KEYS},
+			{N_("Cleanable"), GCLEANER_FOOTPRINT_COLUMN_CLEANABLE},
+			{N_("Bytes"), GCLEANER_FOOTPRINT_COLUMN_SIZE},
+			{N_("Longest list"), GCLEANER_FOOTPRINT_COLUMN_LIST},
+		};
 
 		scrolled = gtk_scrolled_window_new(NULL, NULL);
 		gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW (scrolled),
@@ -750,18 +989,30 @@ _gconf_cleaner_create_page(GConfCleanerInstance *inst)
 		label_dirs = gtk_label_new(_("<b>GConf directories:</b>"));
 		label_keys = gtk_label_new(_("<b>Total GConf keys:</b>"));
 		label_pairs = gtk_label_new(_("<b>Cleanable GConf keys:</b>"));
+		label_size = gtk_label_new(_("<b>Cleanable values:</b>"));
 		inst->label_n_dirs = gtk_label_new("?");
 		inst->label_n_pairs = gtk_label_new("?");
 		inst->label_n_unknown_pairs = gtk_label_new("?");
+		inst->label_unknown_size = gtk_label_new("?");
 		gtk_label_set_use_markup(GTK_LABEL (label_dirs), TRUE);
 		gtk_label_set_use_markup(GTK_LABEL (label_keys), TRUE);
 		gtk_label_set_use_markup(GTK_LABEL (label_pairs), TRUE);
+		gtk_label_set_use_markup(GTK_LABEL (label_size), TRUE);
 		gtk_misc_set_alignment(GTK_MISC (label_dirs), 0, 0);
 		gtk_misc_set_alignment(GTK_MISC (label_keys), 0, 0);
 		gtk_misc_set_alignment(GTK_MISC (label_pairs), 0, 0);
+		gtk_misc_set_alignment(GTK_MISC (label_size), 0, 0);
 
 		inst->expander = gtk_expander_new_with_mnemonic(_("_Details"));
 		gtk_expander_set_expanded(GTK_EXPANDER (inst->expander), FALSE);
+		inst->expander_footprints = gtk_expander_new_with_mnemonic(_("_Heaviest directories"));
+		gtk_expander_set_expanded(GTK_EXPANDER (inst->expander_footprints), FALSE);
+		scrolled2 = gtk_scrolled_window_new(NULL, NULL);
+		gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW (scrolled2),
+					       GTK_POLICY_AUTOMATIC,
+					       GTK_POLICY_AUTOMATIC);
+		inst->treeview_footprints = gtk_tree_view_new();
+		gtk_tree_view_set_rules_hint(GTK_TREE_VIEW (inst->treeview_footprints), TRUE);
 
 		inst->hbox = gtk_hbox_new(FALSE, 0);
 		label_save = gtk_label_new(_("<small><i>Note: This cleanup may affects to your applications working. Please save here to not lose your data.</i></small>"));
@@ -775,6 +1026,8 @@ _gconf_cleaner_create_page(GConfCleanerInstance *inst)
 		inst->label_message = gtk_label_new(NULL);
 		inst->treeview = gtk_tree_view_new();
 		gtk_tree_view_set_rules_hint(GTK_TREE_VIEW (inst->treeview), TRUE);
+		/* don't let GTK+ render all of the rows to measure them */
+		gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW (inst->treeview), TRUE);
 
 #define TABLE_X_PADDING 10
 #define TABLE_Y_PADDING 0
@@ -801,35 +1054,62 @@ _gconf_cleaner_create_page(GConfCleanerInstance *inst)
 				 1, 2, i - rows, i - rows + 1,
 				 GTK_FILL | GTK_SHRINK, GTK_FILL | GTK_SHRINK, TABLE_X_PADDING, TABLE_Y_PADDING);
 		i++;
+		gtk_table_attach(GTK_TABLE (table), label_size,
+				 0, 1, i - rows, i - rows + 1,
+				 GTK_FILL, GTK_FILL, TABLE_X_PADDING, TABLE_Y_PADDING);
+		gtk_table_attach(GTK_TABLE (table), inst->label_unknown_size,
+				 1, 2, i - rows, i - rows + 1,
+				 GTK_FILL | GTK_SHRINK, GTK_FILL | GTK_SHRINK, TABLE_X_PADDING, TABLE_Y_PADDING);
+		i++;
 		gtk_box_pack_start(GTK_BOX (inst->hbox), label_save, TRUE, TRUE, 10);
 		gtk_box_pack_start(GTK_BOX (inst->hbox), button_save, TRUE, TRUE, 0);
 		gtk_box_pack_start(GTK_BOX (vbox), table, FALSE, TRUE, 10);
+		gtk_box_pack_start(GTK_BOX (vbox), inst->expander_footprints, FALSE, TRUE, 0);
 		gtk_box_pack_start(GTK_BOX (vbox), inst->expander, TRUE, TRUE, 0);
 		gtk_box_pack_start(GTK_BOX (vbox), inst->hbox, FALSE, TRUE, 10);
 		gtk_box_pack_start(GTK_BOX (vbox), inst->label_message, FALSE, TRUE, 10);
 		gtk_container_add(GTK_CONTAINER (inst->expander), scrolled);
 		gtk_container_add(GTK_CONTAINER (scrolled), inst->treeview);
+		gtk_container_add(GTK_CONTAINER (inst->expander_footprints), scrolled2);
+		gtk_container_add(GTK_CONTAINER (scrolled2), inst->treeview_footprints);
+		gtk_widget_set_size_request(scrolled2, -1, 150);
+
+		for (i = 0; i < (gint)G_N_ELEMENTS (footprint_columns); i++) {
+			renderer = gtk_cell_renderer_text_new();
+			column = gtk_tree_view_column_new_with_attributes(_(footprint_columns[i].title),
+									  renderer,
+									  "text", footprint_columns[i].column,
+									  NULL);
+			gtk_tree_view_column_set_resizable(column, TRUE);
+			gtk_tree_view_append_column(GTK_TREE_VIEW (inst->treeview_footprints), column);
+		}
 
 		renderer = gtk_cell_renderer_toggle_new();
 		g_signal_connect(renderer, "toggled",
 				 G_CALLBACK (_gconf_cleaner_cell_renderer_on_toggled), inst);
 		column = gtk_tree_view_column_new_with_attributes("",
 								  renderer,
-								  "active", 0,
+								  "active", GCLEANER_MODEL_COLUMN_ACTIVE,
 								  NULL);
+		gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+		gtk_tree_view_column_set_fixed_width(column, 30);
 		gtk_tree_view_append_column(GTK_TREE_VIEW (inst->treeview), column);
 		renderer = gtk_cell_renderer_text_new();
 		column = gtk_tree_view_column_new_with_attributes(_("Key"),
 								  renderer,
-								  "text", 1,
+								  "text", GCLEANER_MODEL_COLUMN_KEY,
 								  NULL);
+		gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+		gtk_tree_view_column_set_fixed_width(column, 300);
 		gtk_tree_view_column_set_resizable(column, TRUE);
 		gtk_tree_view_append_column(GTK_TREE_VIEW (inst->treeview), column);
 		renderer = gtk_cell_renderer_text_new();
 		column = gtk_tree_view_column_new_with_attributes(_("Value"),
 								  renderer,
-								  "text", 2,
+								  "text", GCLEANER_MODEL_COLUMN_VALUE,
 								  NULL);
+		gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+		gtk_tree_view_column_set_fixed_width(column, 200);
 		gtk_tree_view_column_set_resizable(column, TRUE);
 		gtk_tree_view_append_column(GTK_TREE_VIEW (inst->treeview), column);
 
@@ -870,23 +1150,506 @@ _gconf_cleaner_create_page(GConfCleanerInstance *inst)
 	} G_STMT_END;
 	/* page 5 */
 	G_STMT_START {
+		GtkWidget *vbox, *expander;
+
+		vbox = gtk_vbox_new(FALSE, 10);
 		inst->label_cleaned_pairs = gtk_label_new("?");
 		gtk_label_set_line_wrap(GTK_LABEL (inst->label_cleaned_pairs), TRUE);
+		expander = gtk_expander_new_with_mnemonic(_("_Statistics"));
+		inst->label_stats = gtk_label_new(NULL);
+		gtk_label_set_selectable(GTK_LABEL (inst->label_stats), TRUE);
+		gtk_misc_set_alignment(GTK_MISC (inst->label_stats), 0, 0);
+
+		gtk_container_add(GTK_CONTAINER (expander), inst->label_stats);
+		gtk_box_pack_start(GTK_BOX (vbox), inst->label_cleaned_pairs, TRUE, FALSE, 0);
+		gtk_box_pack_start(GTK_BOX (vbox), expander, FALSE, TRUE, 0);
 
 		gtk_assistant_append_page(GTK_ASSISTANT (inst->window),
-					  inst->label_cleaned_pairs);
+					  vbox);
 		gtk_assistant_set_page_title(GTK_ASSISTANT (inst->window),
-					     inst->label_cleaned_pairs, _("Congratulation"));
+					     vbox, _("Congratulation"));
 		gtk_assistant_set_page_type(GTK_ASSISTANT (inst->window),
-					    inst->label_cleaned_pairs, GTK_ASSISTANT_PAGE_SUMMARY);
+					    vbox, GTK_ASSISTANT_PAGE_SUMMARY);
 
 		cb = g_new0(GConfCleanerPageCallback, 1);
-		cb->widget = inst->label_cleaned_pairs;
+		cb->widget = vbox;
 		cb->func = _gconf_cleaner_run_finish_cb;
 		g_ptr_array_add(inst->pages, cb);
 	} G_STMT_END;
 }
 
+static gboolean
+_gconf_cleaner_apply_excludes(GConfCleaner         *cleaner,
+			      GConfCleanerOptions  *options,
+			      GError              **error)
+{
+	gchar *filename;
+	gint i;
+
+	if (options->no_default_excludes)
+		gconf_cleaner_clear_excludes(cleaner);
+	if (options->exclude_from) {
+		filename = g_strdup(options->exclude_from);
+	} else {
+		filename = g_build_filename(g_get_user_config_dir(), "gconf-cleaner", "exclude", NULL);
+		if (!g_file_test(filename, G_FILE_TEST_EXISTS)) {
+			g_free(filename);
+			filename = NULL;
+		}
+	}
+	if (filename && !gconf_cleaner_load_excludes(cleaner, filename, error)) {
+		g_free(filename);
+		return FALSE;
+	}
+	g_free(filename);
+	for (i = 0; options->excludes && options->excludes[i] != NULL; i++) {
+		if (!gconf_cleaner_add_exclude(cleaner, options->excludes[i], error))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static GConfCleaner *
+_gconf_cleaner_new_with_options(GConfCleanerOptions  *options,
+				GError              **error)
+{
+	GConfCleaner *retval;
+	GError *err = NULL;
+
+	/* never start gconfd when the files are rewritten behind it */
+	if (options->offline)
+		retval = gconf_cleaner_new_for_sources((const gchar * const *)options->sources, error);
+	else
+		retval = gconf_cleaner_new();
+	if (G_UNLIKELY (retval == NULL))
+		return NULL;
+	/* the wrong rules could make the wanted keys cleanable. never go ahead then */
+	if (!_gconf_cleaner_apply_excludes(retval, options, error)) {
+		gconf_cleaner_free(retval);
+		return NULL;
+	}
+	if (!options->offline && (options->direct || options->sources)) {
+		if (!gconf_cleaner_set_sources(retval,
+					       (const gchar * const *)options->sources,
+					       &err)) {
+			g_warning(_("Falling back to gconfd: %s"), err->message);
+			g_error_free(err);
+		}
+	}
+	if (options->schema_index)
+		gconf_cleaner_set_use_schema_index(retval, TRUE);
+	if (options->n_threads > 0)
+		gconf_cleaner_set_n_threads(retval, options->n_threads);
+	if (options->batch_size > 0)
+		gconf_cleaner_set_unset_batch_size(retval, options->batch_size);
+	if (options->cache) {
+		if (!gconf_cleaner_set_scan_cache(retval, options->cache, &err)) {
+			g_warning(_("Not using the scan cache: %s"), err->message);
+			g_error_free(err);
+		} else if (options->invalidate_cache) {
+			gconf_cleaner_invalidate_scan_cache(retval);
+		}
+	}
+	/* keep checkpointing to the file resumed from unless told otherwise */
+	if (options->checkpoint || options->resume)
+		gconf_cleaner_set_checkpoint(retval,
+					     options->checkpoint ? options->checkpoint : options->resume,
+					     options->checkpoint_interval > 0 ? options->checkpoint_interval : GCLEANER_CHECKPOINT_INTERVAL);
+
+	return retval;
+}
+
+static gboolean
+_gconf_cleaner_batch_on_unset(const gchar  *key,
+			      const GError *error,
+			      gpointer      data)
+{
+	GConfCleanerBatch *batch = data;
+
+	if (G_UNLIKELY (error != NULL)) {
+		g_printerr(_("Failed during cleaning `%s' up: %s\n"),
+			   key, error->message);
+		batch->retval = GCLEANER_EXIT_FAILED;
+	}
+
+	return TRUE;
+}
+
+static void
+_gconf_cleaner_batch_flush(GConfCleanerBatch *batch)
+{
+	guint i;
+
+	batch->n_cleaned += gconf_cleaner_unset_keys(batch->cleaner,
+						     (const gchar * const *)batch->keys->pdata,
+						     batch->keys->len,
+						     _gconf_cleaner_batch_on_unset,
+						     batch);
+	for (i = 0; i < batch->keys->len; i++)
+		g_free(g_ptr_array_index(batch->keys, i));
+	g_ptr_array_set_size(batch->keys, 0);
+}
+
+static gboolean
+_gconf_cleaner_batch_prune(GConfCleanerBatch *batch)
+{
+	GError *error = NULL;
+
+	batch->n_pruned = gconf_cleaner_prune_empty_dirs(batch->cleaner, &error);
+	if (G_UNLIKELY (error != NULL)) {
+		g_printerr(_("Failed during removing the empty GConf directories: %s\n"), error->message);
+		g_error_free(error);
+		batch->retval = GCLEANER_EXIT_FAILED;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+_gconf_cleaner_batch_visit(const gchar *key,
+			   GConfValue  *value,
+			   const gchar *dir,
+			   gpointer     data)
+{
+	GConfCleanerBatch *batch = data;
+
+	if (batch->options->scan)
+		g_print("%s\n", key);
+	if (batch->writer &&
+	    !gconf_cleaner_backup_writer_add(batch->writer, key, value, &batch->backup_error))
+		return FALSE;
+	if (batch->options->clean) {
+		g_ptr_array_add(batch->keys, g_strdup(key));
+		/*
+		 * the keys are collected only while the backup is written,
+		 * never to clean up any of them until it's completed, or for
+		 * rewriting the files once offline.  otherwise they're unset
+		 * every batch size to keep the memory constant.
+		 */
+		if (batch->writer == NULL && !batch->options->offline &&
+		    batch->keys->len >= gconf_cleaner_get_unset_batch_size(batch->cleaner))
+			_gconf_cleaner_batch_flush(batch);
+	}
+
+	return TRUE;
+}
+
+static gint
+_gconf_cleaner_run_batch(GConfCleanerOptions *options)
+{
+	GConfCleanerBatch batch;
+	GConfCleanerCompaction compaction;
+	GError *error = NULL;
+	gboolean compacted = FALSE;
+	guint n_dirs, n_unknown_pairs, i;
+	gchar *text;
+
+	memset(&batch, 0, sizeof (GConfCleanerBatch));
+	batch.options = options;
+	batch.retval = GCLEANER_EXIT_SUCCESS;
+	batch.cleaner = _gconf_cleaner_new_with_options(options, &error);
+	if (G_UNLIKELY (batch.cleaner == NULL)) {
+		if (error) {
+			g_printerr("%s\n", error->message);
+			g_error_free(error);
+			return GCLEANER_EXIT_USAGE;
+		}
+		g_printerr(_("Failed to connect to the GConf database.\n"));
+		return GCLEANER_EXIT_FAILED;
+	}
+
+	if (options->resume) {
+		if (gconf_cleaner_resume(batch.cleaner, options->resume, &error))
+			while (gconf_cleaner_traverse_step(batch.cleaner, &error));
+	} else {
+		gconf_cleaner_update(batch.cleaner, &error);
+	}
+	if (G_UNLIKELY (error != NULL)) {
+		g_printerr(_("Failed during the initialization: %s\n"), error->message);
+		batch.retval = GCLEANER_EXIT_FAILED;
+		goto finalize;
+	}
+	n_dirs = gconf_cleaner_n_dirs(batch.cleaner);
+	if (options->clean)
+		batch.keys = g_ptr_array_new();
+
+	if (options->backup) {
+		batch.writer = gconf_cleaner_backup_writer_new(options->backup,
+							       options->compress ||
+							       g_str_has_suffix(options->backup, ".gz"),
+							       &error);
+		if (G_UNLIKELY (batch.writer == NULL)) {
+			g_printerr(_("Failed during saving GConf keys: %s\n"), error->message);
+			batch.retval = GCLEANER_EXIT_FAILED;
+			goto finalize;
+		}
+	}
+	if (options->checkpoint || options->resume) {
+		/* the pairs found before the checkpoint have to be kept */
+		if (gconf_cleaner_analyze(batch.cleaner, &error)) {
+			const GConfCleanerResult *result = gconf_cleaner_get_result(batch.cleaner);
+
+			gboolean cont = TRUE;
+
+			for (i = 0; cont && i < gconf_cleaner_result_n_pairs(result); i++) {
+				gchar *key = gconf_cleaner_result_dup_key(result, i);
+				gchar *dir = gconf_cleaner_result_dup_dir(result, gconf_cleaner_result_get_pair_dir(result, i));
+
+				cont = _gconf_cleaner_batch_visit(key, gconf_cleaner_result_get_value(result, i),
+								  dir, &batch);
+				g_free(dir);
+				g_free(key);
+			}
+		}
+	} else {
+		/* the pairs are dealt with as they are found, not kept in memory */
+		gconf_cleaner_foreach_unknown(batch.cleaner,
+					      _gconf_cleaner_batch_visit,
+					      &batch,
+					      &error);
+	}
+	if (G_UNLIKELY (error != NULL)) {
+		g_printerr(_("Failed during analyzing the GConf key: %s\n"), error->message);
+		batch.retval = GCLEANER_EXIT_FAILED;
+		goto finalize;
+	}
+	n_unknown_pairs = gconf_cleaner_n_unknown_pairs(batch.cleaner);
+	if (!gconf_cleaner_save_scan_cache(batch.cleaner, &error)) {
+		g_printerr(_("Failed during saving the scan cache: %s\n"), error->message);
+		g_clear_error(&error);
+	}
+
+	if (batch.writer) {
+		GConfCleanerBackupWriter *writer = batch.writer;
+
+		batch.writer = NULL;
+		if (!gconf_cleaner_backup_writer_close(writer, &error) ||
+		    batch.backup_error) {
+			/* never clean up the keys that couldn't be saved */
+			g_printerr(_("Failed during saving GConf keys: %s\n"),
+				   batch.backup_error ? batch.backup_error->message : error->message);
+			batch.retval = GCLEANER_EXIT_FAILED;
+			goto finalize;
+		}
+	}
+	if (options->clean && options->offline) {
+		/* every file is rewritten once for all of the keys */
+		batch.n_cleaned = gconf_cleaner_unset_keys_offline(batch.cleaner,
+								   (const gchar * const *)batch.keys->pdata,
+								   batch.keys->len,
+								   &error);
+		if (G_UNLIKELY (error != NULL)) {
+			g_printerr(_("Failed during cleaning GConf keys up: %s\n"), error->message);
+			g_clear_error(&error);
+			batch.retval = GCLEANER_EXIT_FAILED;
+		} else if (_gconf_cleaner_batch_prune(&batch) && options->compact) {
+			compacted = gconf_cleaner_compact(batch.cleaner, &compaction, &error);
+			if (!compacted) {
+				g_printerr(_("Failed during compacting %%gconf-tree.xml: %s\n"), error->message);
+				g_clear_error(&error);
+				batch.retval = GCLEANER_EXIT_FAILED;
+			}
+		}
+	} else if (options->clean) {
+		_gconf_cleaner_batch_flush(&batch);
+		_gconf_cleaner_batch_prune(&batch);
+		gconf_cleaner_sync(batch.cleaner, &error);
+		if (G_UNLIKELY (error != NULL)) {
+			g_printerr(_("Failed during syncing the GConf database: %s\n"), error->message);
+			batch.retval = GCLEANER_EXIT_FAILED;
+		}
+	} else if (n_unknown_pairs > 0) {
+		batch.retval = GCLEANER_EXIT_FOUND;
+	}
+
+	g_print(_("GConf directories: %d, Total GConf keys: %d, Cleanable GConf keys: %d\n"),
+		n_dirs, gconf_cleaner_n_pairs(batch.cleaner), n_unknown_pairs);
+	if (n_unknown_pairs > 0)
+		g_print(_("Cleanable values: %lu bytes\n"),
+			(gulong)gconf_cleaner_unknown_size(batch.cleaner));
+	if (options->schema_index)
+		g_print(_("Schema index: %d schemas read in %.3f seconds\n"),
+			gconf_cleaner_schema_index_size(batch.cleaner),
+			gconf_cleaner_schema_index_build_time(batch.cleaner));
+	if (gconf_cleaner_n_schema_lookups(batch.cleaner) > 0) {
+		guint n_lookups = gconf_cleaner_n_schema_lookups(batch.cleaner);
+		guint n_hits = gconf_cleaner_n_schema_cache_hits(batch.cleaner);
+
+		g_print(_("Schema cache: %d hits of %d lookups (%.1f%%)\n"),
+			n_hits, n_lookups, 100.0 * n_hits / n_lookups);
+	}
+	if (options->cache)
+		g_print(_("Scan cache: %d of %d directories unchanged\n"),
+			gconf_cleaner_n_scan_cache_hits(batch.cleaner), n_dirs);
+	if (options->clean) {
+		text = g_strdup_printf(_("%d of %d GConf keys has been cleaned up successfully."),
+				       batch.n_cleaned, n_unknown_pairs);
+		g_print("%s\n", text);
+		g_free(text);
+		text = g_strdup_printf(_("%d empty GConf directories has been removed."),
+				       batch.n_pruned);
+		g_print("%s\n", text);
+		g_free(text);
+	}
+	if (compacted)
+		g_print(_("Compacted %d %%gconf-tree.xml: %lu -> %lu bytes, parsed in %.3f -> %.3f seconds, %d empty directories and %d stale entries dropped\n"),
+			compaction.n_files,
+			(gulong)compaction.size_before, (gulong)compaction.size_after,
+			compaction.parse_time_before, compaction.parse_time_after,
+			compaction.n_dropped_dirs, compaction.n_dropped_entries);
+	if (options->footprints) {
+		GConfCleanerFootprint *footprints;
+		guint n;
+
+		footprints = gconf_cleaner_get_footprints(batch.cleaner, 0, &n);
+		text = gconf_cleaner_footprints_dump(footprints, n);
+		gconf_cleaner_footprints_free(footprints, n);
+		if (strcmp(options->footprints, "-") == 0) {
+			g_print("%s", text);
+		} else if (!g_file_set_contents(options->footprints, text, -1, &error)) {
+			g_printerr(_("Failed during saving the footprints: %s\n"), error->message);
+			g_clear_error(&error);
+		}
+		g_free(text);
+	}
+	if (options->stats) {
+		text = gconf_cleaner_stats_dump(gconf_cleaner_get_stats(batch.cleaner));
+		if (strcmp(options->stats, "-") == 0) {
+			g_print("%s", text);
+		} else if (!g_file_set_contents(options->stats, text, -1, &error)) {
+			g_printerr(_("Failed during saving the statistics: %s\n"), error->message);
+			g_clear_error(&error);
+		}
+		g_free(text);
+	}
+
+  finalize:
+	if (error)
+		g_error_free(error);
+	if (batch.writer)
+		gconf_cleaner_backup_writer_close(batch.writer, NULL);
+	if (batch.backup_error)
+		g_error_free(batch.backup_error);
+	if (batch.keys) {
+		for (i = 0; i < batch.keys->len; i++)
+			g_free(g_ptr_array_index(batch.keys, i));
+		g_ptr_array_free(batch.keys, TRUE);
+	}
+	gconf_cleaner_free(batch.cleaner);
+
+	return batch.retval;
+}
+
+static gboolean
+_gconf_cleaner_fleet_setup(GConfCleaner  *cleaner,
+			   gpointer       data,
+			   GError       **error)
+{
+	GConfCleanerOptions *options = data;
+
+	if (!_gconf_cleaner_apply_excludes(cleaner, options, error))
+		return FALSE;
+	if (options->schema_index)
+		gconf_cleaner_set_use_schema_index(cleaner, TRUE);
+
+	return TRUE;
+}
+
+static gint
+_gconf_cleaner_run_fleet(GConfCleanerOptions *options)
+{
+	GConfCleanerFleet *fleet = gconf_cleaner_fleet_new();
+	GError *error = NULL;
+	gchar *text;
+	guint i, n_failed, n_unknown_pairs = 0;
+	gint retval = GCLEANER_EXIT_SUCCESS;
+
+	if (!gconf_cleaner_fleet_load_sources(fleet, options->fleet, &error)) {
+		g_printerr(_("Failed to read the list of the configuration sources: %s\n"), error->message);
+		g_error_free(error);
+		gconf_cleaner_fleet_free(fleet);
+		return GCLEANER_EXIT_USAGE;
+	}
+	if (options->sources)
+		gconf_cleaner_fleet_set_shared_sources(fleet, NULL, (const gchar * const *)options->sources);
+	gconf_cleaner_fleet_set_direct(fleet, options->direct);
+	if (options->n_threads > 0)
+		gconf_cleaner_fleet_set_n_jobs(fleet, options->n_threads);
+	gconf_cleaner_fleet_set_setup_func(fleet, _gconf_cleaner_fleet_setup, options);
+
+	n_failed = gconf_cleaner_fleet_run(fleet);
+	text = gconf_cleaner_fleet_dump(fleet, options->top >= 0 ? options->top : GCLEANER_FLEET_TOP);
+	g_print("%s", text);
+	g_free(text);
+	for (i = 0; i < gconf_cleaner_fleet_n_sources(fleet); i++)
+		n_unknown_pairs += gconf_cleaner_fleet_get_source(fleet, i)->n_unknown_pairs;
+	if (n_failed > 0) {
+		g_printerr(_("Failed to scan %d of %d configuration sources.\n"),
+			   n_failed, gconf_cleaner_fleet_n_sources(fleet));
+		retval = GCLEANER_EXIT_FAILED;
+	} else if (n_unknown_pairs > 0) {
+		retval = GCLEANER_EXIT_FOUND;
+	}
+	gconf_cleaner_fleet_free(fleet);
+
+	return retval;
+}
+
+static gint
+_gconf_cleaner_run_restore(GConfCleanerOptions *options)
+{
+	GConfCleaner *cleaner;
+	GError *error = NULL;
+	guint n_restored, n_skipped, n_failed;
+	gint retval = GCLEANER_EXIT_SUCCESS;
+
+	/* the keys are always written through gconfd. no need to read the sources */
+	cleaner = gconf_cleaner_new();
+	if (G_UNLIKELY (cleaner == NULL)) {
+		g_printerr(_("Failed to connect to the GConf database.\n"));
+		return GCLEANER_EXIT_FAILED;
+	}
+	if (options->batch_size > 0)
+		gconf_cleaner_set_unset_batch_size(cleaner, options->batch_size);
+	if (!gconf_cleaner_restore(cleaner, options->restore,
+				   &n_restored, &n_skipped, &n_failed, &error)) {
+		g_printerr(_("Failed during restoring GConf keys: %s\n"), error->message);
+		g_clear_error(&error);
+		retval = GCLEANER_EXIT_FAILED;
+	}
+	gconf_cleaner_sync(cleaner, &error);
+	if (G_UNLIKELY (error != NULL)) {
+		g_printerr(_("Failed during syncing the GConf database: %s\n"), error->message);
+		g_error_free(error);
+		retval = GCLEANER_EXIT_FAILED;
+	}
+	if (n_failed > 0)
+		retval = GCLEANER_EXIT_FAILED;
+	g_print(_("%d GConf keys has been restored, %d skipped, %d failed.\n"),
+		n_restored, n_skipped, n_failed);
+	gconf_cleaner_free(cleaner);
+
+	return retval;
+}
+
+static void
+_gconf_cleaner_options_free(GConfCleanerOptions *options)
+{
+	g_free(options->backup);
+	g_strfreev(options->sources);
+	g_free(options->cache);
+	g_free(options->restore);
+	g_strfreev(options->excludes);
+	g_free(options->exclude_from);
+	g_free(options->stats);
+	g_free(options->checkpoint);
+	g_free(options->resume);
+	g_free(options->fleet);
+	g_free(options->footprints);
+}
+
 /*
  * Public Functions
  */
@@ -896,6 +1659,60 @@ main(int    argc,
 {
 	GConfCleanerInstance *inst;
 	GtkWidget *button;
+	GConfCleanerOptions options;
+	GOptionContext *context;
+	GError *error = NULL;
+	GOptionEntry entries[] = {
+		{"scan", 's', 0, G_OPTION_ARG_NONE, &options.scan,
+		 N_("Analyze the GConf database and list the cleanable keys without the GUI"), NULL},
+		{"clean", 'c', 0, G_OPTION_ARG_NONE, &options.clean,
+		 N_("Clean up the cleanable keys without the GUI"), NULL},
+		{"backup", 'b', 0, G_OPTION_ARG_FILENAME, &options.backup,
+		 N_("Save the cleanable keys to FILE before cleaning up"), N_("FILE")},
+		{"restore", 'r', 0, G_OPTION_ARG_FILENAME, &options.restore,
+		 N_("Restore the keys saved in FILE and exit"), N_("FILE")},
+		{"compress", 'z', 0, G_OPTION_ARG_NONE, &options.compress,
+		 N_("Compress the backup with gzip. this is the default when FILE ends with .gz"), NULL},
+		{"direct", 'd', 0, G_OPTION_ARG_NONE, &options.direct,
+		 N_("Read the xml: configuration sources from the disk instead of asking gconfd"), NULL},
+		{"source", 0, 0, G_OPTION_ARG_STRING_ARRAY, &options.sources,
+		 N_("Read ADDRESS directly, in order of priority. may be specified more than once"), N_("ADDRESS")},
+		{"threads", 'j', 0, G_OPTION_ARG_INT, &options.n_threads,
+		 N_("Analyze the directories with N threads when reading the sources directly"), N_("N")},
+		{"schema-index", 0, 0, G_OPTION_ARG_NONE, &options.schema_index,
+		 N_("Read all of the schemas at once before analyzing instead of looking them up one by one"), NULL},
+		{"stats", 0, 0, G_OPTION_ARG_FILENAME, &options.stats,
+		 N_("Write the time and the GConf calls spent in each phase to FILE, or - for the standard output"), N_("FILE")},
+		{"footprints", 0, 0, G_OPTION_ARG_FILENAME, &options.footprints,
+		 N_("Write the keys, the cleanable keys and bytes and the longest list of each directory, the heaviest first, to FILE, or - for the standard output"), N_("FILE")},
+		{"offline", 0, 0, G_OPTION_ARG_NONE, &options.offline,
+		 N_("Clean up by rewriting the files of the xml: sources directly while gconfd isn't running"), NULL},
+		{"compact", 0, 0, G_OPTION_ARG_NONE, &options.compact,
+		 N_("Rewrite %gconf-tree.xml in the minimal form after cleaning up offline"), NULL},
+		{"batch-size", 0, 0, G_OPTION_ARG_INT, &options.batch_size,
+		 N_("Unset N keys at once when cleaning up"), N_("N")},
+		{"exclude", 'x', 0, G_OPTION_ARG_STRING_ARRAY, &options.excludes,
+		 N_("Don't analyze the directories matching RULE. may be specified more than once"), N_("RULE")},
+		{"exclude-from", 0, 0, G_OPTION_ARG_FILENAME, &options.exclude_from,
+		 N_("Read the exclusion rules from FILE instead of ~/.config/gconf-cleaner/exclude"), N_("FILE")},
+		{"no-default-excludes", 0, 0, G_OPTION_ARG_NONE, &options.no_default_excludes,
+		 N_("Analyze the directories like schemas and prefs as well"), NULL},
+		{"checkpoint", 0, 0, G_OPTION_ARG_FILENAME, &options.checkpoint,
+		 N_("Save the progress of the scan to FILE from time to time"), N_("FILE")},
+		{"checkpoint-interval", 0, 0, G_OPTION_ARG_INT, &options.checkpoint_interval,
+		 N_("Save the progress every N directories analyzed"), N_("N")},
+		{"resume", 0, 0, G_OPTION_ARG_FILENAME, &options.resume,
+		 N_("Continue the scan saved in FILE by --checkpoint"), N_("FILE")},
+		{"fleet", 0, 0, G_OPTION_ARG_FILENAME, &options.fleet,
+		 N_("Scan every configuration source or home directory listed in FILE and report the totals. -j is the number of the sources scanned at once with --direct"), N_("FILE")},
+		{"top", 0, 0, G_OPTION_ARG_INT, &options.top,
+		 N_("List N keys cleanable in the most sources with --fleet, or all of them for 0"), N_("N")},
+		{"cache", 0, 0, G_OPTION_ARG_FILENAME, &options.cache,
+		 N_("Reuse the results of the unchanged directories stored in FILE when reading the sources directly"), N_("FILE")},
+		{"invalidate-cache", 0, 0, G_OPTION_ARG_NONE, &options.invalidate_cache,
+		 N_("Discard the results in the cache, e.g. after installing or removing schemas"), NULL},
+		{NULL}
+	};
 
 #ifdef ENABLE_NLS
 	bindtextdomain (GETTEXT_PACKAGE, GCLEANER_LOCALEDIR);
@@ -905,24 +1722,91 @@ main(int    argc,
 	textdomain (GETTEXT_PACKAGE);
 #endif /* ENABLE_NLS */
 
+	if (!g_thread_supported())
+		g_thread_init(NULL);
+
+	memset(&options, 0, sizeof (GConfCleanerOptions));
+	options.top = -1;
+	context = g_option_context_new(NULL);
+	g_option_context_set_summary(context, _("A Cleaning tool for GConf"));
+	g_option_context_add_main_entries(context, entries, GETTEXT_PACKAGE);
+	/* leave GTK+ options to gtk_init() */
+	g_option_context_set_ignore_unknown_options(context, TRUE);
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		_gconf_cleaner_options_free(&options);
+		return GCLEANER_EXIT_USAGE;
+	}
+	g_option_context_free(context);
+
+	if (options.restore) {
+		gint retval = _gconf_cleaner_run_restore(&options);
+
+		_gconf_cleaner_options_free(&options);
+
+		return retval;
+	}
+	if ((options.offline && !options.clean) ||
+	    (options.compact && !options.offline)) {
+		g_printerr(_("--offline can be used only with --clean, and --compact only with --offline.\n"));
+		_gconf_cleaner_options_free(&options);
+
+		return GCLEANER_EXIT_USAGE;
+	}
+	if (options.fleet) {
+		gint retval = _gconf_cleaner_run_fleet(&options);
+
+		_gconf_cleaner_options_free(&options);
+
+		return retval;
+	}
+	if (options.scan || options.clean || options.backup) {
+		gint retval = _gconf_cleaner_run_batch(&options);
+
+		_gconf_cleaner_options_free(&options);
+
+		return retval;
+	}
+
 	gtk_init(&argc, &argv);
 
 	inst = g_new0(GConfCleanerInstance, 1);
-	inst->cleaner = gconf_cleaner_new();
+	inst->cleaner = _gconf_cleaner_new_with_options(&options, &error);
+	/* the first page picks up the checkpoint to resume */
+	inst->resume = options.resume;
+	options.resume = NULL;
+	_gconf_cleaner_options_free(&options);
+	if (G_UNLIKELY (error != NULL)) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		g_free(inst->resume);
+		g_free(inst);
+		return GCLEANER_EXIT_USAGE;
+	}
 	inst->window = gtk_assistant_new();
 	inst->pages = g_ptr_array_new();
 	inst->name = NULL;
+	inst->queue = g_async_queue_new();
+	inst->keys = g_ptr_array_new();
 
 	gtk_window_set_title(GTK_WINDOW (inst->window), _("GConf Cleaner"));
 	button = gtk_button_new_from_stock(GTK_STOCK_ABOUT);
 	gtk_assistant_add_action_widget(GTK_ASSISTANT (inst->window), button);
 	gtk_widget_show(button);
-
-	_gconf_cleaner_create_page(inst);
-
 	g_signal_connect(button, "clicked",
 			 G_CALLBACK (_gconf_cleaner_button_about_on_clicked),
 			 inst);
+	button = gtk_button_new_with_mnemonic(_("_Restore..."));
+	gtk_assistant_add_action_widget(GTK_ASSISTANT (inst->window), button);
+	gtk_widget_show(button);
+	g_signal_connect(button, "clicked",
+			 G_CALLBACK (_gconf_cleaner_button_restore_on_clicked),
+			 inst);
+
+	_gconf_cleaner_create_page(inst);
+
 	g_signal_connect(inst->window, "cancel",
 			 G_CALLBACK (_gconf_cleaner_on_assistant_cancel),
 			 inst);
@@ -940,10 +1824,26 @@ main(int    argc,
 
 	gtk_main();
 
+	if (inst->thread) {
+		g_atomic_int_set(&inst->cancelled, TRUE);
+		g_thread_join(inst->thread);
+	}
+	if (G_LIKELY (inst->queue)) {
+		GConfCleanerProgress *progress;
+
+		while ((progress = g_async_queue_try_pop(inst->queue)) != NULL)
+			_gconf_cleaner_progress_free(progress);
+		g_async_queue_unref(inst->queue);
+	}
+	if (G_LIKELY (inst->keys)) {
+		gint i;
+
+		for (i = 0; i < inst->keys->len; i++)
+			g_free(g_ptr_array_index(inst->keys, i));
+		g_ptr_array_free(inst->keys, TRUE);
+	}
 	if (G_LIKELY (inst->cleaner))
 		gconf_cleaner_free(inst->cleaner);
-	if (G_LIKELY (inst->pairs))
-		gconf_cleaner_pairs_free(inst->pairs);
 	if (G_LIKELY (inst->pages)) {
 		gint i;
 
@@ -953,6 +1853,8 @@ main(int    argc,
 	}
 	if (G_LIKELY (inst->name))
 		g_free(inst->name);
+	g_free(inst->failure);
+	g_free(inst->resume);
 	g_free(inst);
 
 	return 0;